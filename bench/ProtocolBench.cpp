@@ -0,0 +1,189 @@
+/*
+	SparkMaker BLE protocol decoder benchmark
+
+	pio run -e native_bench && .pio/build/native_bench/program
+*/
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SparkMakerProtocol.h"
+
+const static struct
+{
+	uint32_t iterations = 200000; // decode passes over the sample traffic
+	uint8_t runs = 5;			  // best of
+} benchConfig;
+
+/**
+ * sample traffic: connect, file list, print progress and heartbeats
+ */
+static const char *sampleLines[] = {
+	"P-SparkMaker",
+	"OK",
+	"nocard_sts",
+	"standby_sts",
+	"f-ValidationMatrix_10.fhd.0",
+	"f-Elegoo_Nova_Stan.fhd.1",
+	"f-calibration_test_part.fhd.2",
+	"f-Raft_Holder_Nova_Stan.fhd.3",
+	"scan-finish",
+	"pf_ValidationMatrix_10.fhd",
+	"printing_sts",
+	"F/S=1/480",
+	"online",
+	"F/S=2/480",
+	"online",
+	"F/S=3/480",
+	"pause_sts",
+	"pause-over",
+	"F/S=480/480",
+	"printo_sts",
+	"stop_sts",
+	"update_sts",
+	"G1 Z10",
+	"online"
+};
+static const size_t SAMPLE_COUNT = sizeof(sampleLines) / sizeof(sampleLines[0]);
+static size_t sampleLengths[SAMPLE_COUNT];
+
+/**
+ * reference: strcmp chain as used by notifyCallback before the table driven decoder
+ */
+static MESSAGETYPE legacyDecode(char *buffer, SparkMakerMessage &msg)
+{
+	char *ptr;
+	msg.value = msg.total = 0;
+	if (strcmp(buffer, "online") == 0)
+		return msg.type = MSG_HEARTBEAT;
+	if (strncmp(buffer, "P-", 2) == 0)
+		return msg.type = MSG_HANDSHAKE;
+	if (strncmp(buffer, "pf_", 3) == 0)
+	{
+		msg.text = buffer + 3;
+		return msg.type = MSG_SELECTED_FILE;
+	}
+	if (strncmp(buffer, "f-", 2) == 0)
+	{
+		msg.text = buffer + 2;
+		ptr = strrchr(buffer + 2, '.');
+		if (ptr)
+			msg.value = atoi(ptr + 1);
+		return msg.type = MSG_FILE_ENTRY;
+	}
+	if (strncmp(buffer, "F/S=", 4) == 0)
+	{
+		ptr = buffer + 4;
+		msg.value = atoi(ptr);
+		ptr = strchr(ptr, '/');
+		if (ptr)
+			msg.total = atoi(++ptr);
+		return msg.type = MSG_LAYER;
+	}
+	if (strcmp(buffer, "standby_sts") == 0)
+		return msg.type = MSG_STANDBY;
+	if (strcmp(buffer, "printing_sts") == 0)
+		return msg.type = MSG_PRINTING;
+	if (strcmp(buffer, "pause_sts") == 0)
+		return msg.type = MSG_PAUSE;
+	if (strcmp(buffer, "pause-over") == 0)
+		return msg.type = MSG_RESUME;
+	if (strcmp(buffer, "stop_sts") == 0)
+		return msg.type = MSG_STOP;
+	if (strcmp(buffer, "printo_sts") == 0)
+		return msg.type = MSG_FINISHED;
+	if (strcmp(buffer, "nocard_sts") == 0)
+		return msg.type = MSG_NO_CARD;
+	if (strcmp(buffer, "scan-finish") == 0)
+		return msg.type = MSG_SCAN_FINISH;
+	if (strcmp(buffer, "update_sts") == 0)
+		return msg.type = MSG_UPDATING;
+	if (strcmp(buffer, "OK") == 0)
+		return msg.type = MSG_OK;
+	return msg.type = MSG_UNKNOWN;
+}
+
+/**
+ * run one benchmark and print messages per second (best of runs)
+ * @return checksum over decoded messages, keeps the optimizer from dropping the work
+ */
+static uint32_t bench(const char *name, bool legacy)
+{
+	static char buffer[256];
+	SparkMakerMessage msg;
+	uint32_t checksum = 0;
+	unsigned long best = 0xFFFFFFFF;
+
+	for (uint8_t run = 0; run < benchConfig.runs; run++)
+	{
+		unsigned long start = micros();
+		for (uint32_t i = 0; i < benchConfig.iterations; i++)
+		{
+			for (size_t n = 0; n < SAMPLE_COUNT; n++)
+			{
+				// the line buffer is refilled for every message, as in notifyCallback
+				memcpy(buffer, sampleLines[n], sampleLengths[n] + 1);
+				if (legacy)
+					legacyDecode(buffer, msg);
+				else
+					SparkMakerProtocol::decode(buffer, sampleLengths[n], msg);
+				checksum += msg.type + msg.value + msg.total;
+			}
+		}
+		unsigned long duration = micros() - start;
+		if (duration < best)
+			best = duration;
+	}
+
+	double messages = (double)benchConfig.iterations * SAMPLE_COUNT;
+	Serial.print(name);
+	Serial.print(": ");
+	Serial.print(messages / best, 2);
+	Serial.print(" M messages/s, ");
+	Serial.print(best * 1000.0 / messages, 2);
+	Serial.println(" ns/message");
+	return checksum;
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println();
+	Serial.println("SparkMaker protocol decoder benchmark");
+
+	for (size_t n = 0; n < SAMPLE_COUNT; n++)
+		sampleLengths[n] = strlen(sampleLines[n]);
+
+	// both decoders must agree on the sample traffic
+	static char buffer[256];
+	for (size_t n = 0; n < SAMPLE_COUNT; n++)
+	{
+		SparkMakerMessage a, b;
+		strcpy(buffer, sampleLines[n]);
+		legacyDecode(buffer, a);
+		SparkMakerProtocol::decode(sampleLines[n], sampleLengths[n], b);
+		if (a.type != b.type || a.value != b.value)
+		{
+			Serial.print("MISMATCH: ");
+			Serial.print(sampleLines[n]);
+			Serial.print(" legacy ");
+			Serial.print(SparkMakerProtocol::messageName(a.type));
+			Serial.print(" decoder ");
+			Serial.println(SparkMakerProtocol::messageName(b.type));
+		}
+	}
+
+	uint32_t checksum = bench("strcmp chain", true);
+	checksum += bench("SparkMakerProtocol", false);
+	Serial.print("checksum ");
+	Serial.println(checksum);
+
+#ifdef NATIVE
+	exit(0);
+#endif
+}
+
+void loop()
+{
+	delay(1000);
+}
@@ -0,0 +1,132 @@
+/*
+	Native HAL: Arduino core for Linux hosts
+*/
+#include "Arduino.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <malloc.h>
+#include <unistd.h>
+
+static const auto bootTime = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+	return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long micros()
+{
+	return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void delay(uint32_t ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield()
+{
+	std::this_thread::yield();
+}
+
+/*******************************************************************************************************************************
+ * FreeRTOS tasks
+ */
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameter, UBaseType_t priority, TaskHandle_t *handle)
+{
+	std::thread(task, parameter).detach();
+	if (handle)
+		*handle = NULL;
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	return new std::timed_mutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+	std::timed_mutex *m = (std::timed_mutex *)mutex;
+	if (ticks == portMAX_DELAY)
+	{
+		m->lock();
+		return pdTRUE;
+	}
+	return m->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+	((std::timed_mutex *)mutex)->unlock();
+	return pdTRUE;
+}
+
+/*******************************************************************************************************************************
+ * ESP system functions
+ */
+EspClass ESP;
+
+static size_t heapBaseline()
+{
+	static const size_t baseline = mallinfo2().uordblks;
+	return baseline;
+}
+
+uint64_t EspClass::getEfuseMac()
+{
+	return (uint64_t)gethostid() & 0xFFFFFFFFFFFFULL;
+}
+
+uint32_t EspClass::getHeapSize()
+{
+	static uint32_t size = 0;
+	if (!size)
+	{
+		const char *env = getenv("SPARKMAKER_HEAP");
+		size = env ? atol(env) : 320 * 1024;
+	}
+	return size;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+	size_t base = heapBaseline();
+	size_t used = mallinfo2().uordblks;
+	size_t delta = used > base ? used - base : 0;
+	return delta < getHeapSize() ? getHeapSize() - delta : 0;
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+	static uint32_t minFree = UINT32_MAX;
+	uint32_t free = getFreeHeap();
+	if (free < minFree)
+		minFree = free;
+	return minFree;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+	// emulate the CPU cycle counter at getCpuFreqMHz()
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - bootTime).count();
+	return (uint32_t)(ns * getCpuFreqMHz() / 1000);
+}
+
+void EspClass::restart()
+{
+	Serial.println("ESP.restart()");
+	Serial.flush();
+	exit(0);
+}
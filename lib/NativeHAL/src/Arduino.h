@@ -0,0 +1,64 @@
+/*
+	Native HAL: Arduino core for Linux hosts
+*/
+#ifndef _NATIVE_ARDUINO_h
+#define _NATIVE_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F(string_literal) (string_literal)
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+using std::max;
+using std::min;
+
+// clock
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// FreeRTOS tasks, included by the ESP32 Arduino core
+// tasks run as detached threads, vTaskDelete(NULL) returns and the thread ends with the task function
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#define pdPASS 1
+#define pdFAIL 0
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameter, UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+
+// FreeRTOS mutexes, one tick is 1 ms
+typedef void *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdTRUE 1
+#define pdFALSE 0
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+// sketch entry points
+void setup();
+void loop();
+
+#endif // _NATIVE_ARDUINO_h
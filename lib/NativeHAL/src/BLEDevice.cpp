@@ -0,0 +1,189 @@
+/*
+	Native HAL: BLE client API of the ESP32 BLE library, backed by BLESimulator
+*/
+#include "BLEDevice.h"
+#include "BLESimulator.h"
+#include "Arduino.h"
+
+#include <algorithm>
+#include <cctype>
+
+BLEUUID::BLEUUID(const std::string &uuid) : _uuid(uuid)
+{
+	std::transform(_uuid.begin(), _uuid.end(), _uuid.begin(), [](unsigned char c) { return tolower(c); });
+}
+
+bool BLEAdvertisedDevice::isAdvertisingService(const BLEUUID &uuid) const
+{
+	return std::find(_services.begin(), _services.end(), uuid) != _services.end();
+}
+
+std::string BLEAdvertisedDevice::toString() const
+{
+	std::string str = "Name: " + _name + ", Address: " + _address.toString();
+	if (haveServiceUUID())
+		str += ", serviceUUID: " + getServiceUUID().toString();
+	return str;
+}
+
+/*******************************************************************************************************************************
+ * scanner
+ */
+BLEScanResults BLEScan::start(uint32_t duration, bool is_continue)
+{
+	if (!is_continue)
+		clearResults();
+	_scanCompleteCB = nullptr;
+	BLESimulator::instance().startScan(this, duration * 1000);
+
+	// blocking scan, returns when the scan time is over or the scan was stopped
+	while (_running)
+		delay(1);
+	return _results;
+}
+
+bool BLEScan::start(uint32_t duration, void (*scanCompleteCB)(BLEScanResults), bool is_continue)
+{
+	if (!is_continue)
+		clearResults();
+	_scanCompleteCB = scanCompleteCB;
+	BLESimulator::instance().startScan(this, duration * 1000);
+	return true;
+}
+
+void BLEScan::stop()
+{
+	BLESimulator::instance().stopScan(this);
+}
+
+void BLEScan::onResult(const BLEAdvertisedDevice &device)
+{
+	_results._devices.push_back(device);
+	if (_callbacks)
+		_callbacks->onResult(device);
+}
+
+void BLEScan::onComplete()
+{
+	_running = false;
+	if (_scanCompleteCB)
+		_scanCompleteCB(_results);
+}
+
+/*******************************************************************************************************************************
+ * GATT client
+ */
+void BLERemoteCharacteristic::registerForNotify(notify_callback callback, bool notifications, bool descriptorRequiresRegistration)
+{
+	_notifyCallback = callback;
+	BLESimulator::instance().subscribe(this);
+}
+
+void BLERemoteCharacteristic::writeValue(uint8_t *data, size_t length, bool response)
+{
+	BLESimulator::instance().write(this, data, length, response);
+}
+
+BLERemoteService::~BLERemoteService()
+{
+	for (auto &kv : _characteristics)
+		delete kv.second;
+}
+
+BLERemoteCharacteristic *BLERemoteService::getCharacteristic(const BLEUUID &uuid)
+{
+	auto it = _characteristics.find(uuid);
+	if (it != _characteristics.end())
+		return it->second;
+	BLERemoteCharacteristic *characteristic = new BLERemoteCharacteristic(this, uuid);
+	_characteristics[uuid] = characteristic;
+	return characteristic;
+}
+
+BLEClient::~BLEClient()
+{
+	disconnect();
+	for (auto &kv : _services)
+		delete kv.second;
+}
+
+bool BLEClient::connect(BLEAdvertisedDevice *device)
+{
+	return device && connect(device->getAddress());
+}
+
+bool BLEClient::connect(BLEAddress address)
+{
+	static uint16_t connId = 0;
+	_peer = address;
+	_connected = BLESimulator::instance().connect(this, address);
+	if (_connected)
+	{
+		_connId = connId++;
+		if (_callbacks)
+			_callbacks->onConnect(this);
+	}
+	return _connected;
+}
+
+void BLEClient::disconnect()
+{
+	if (!_connected)
+		return;
+	BLESimulator::instance().disconnect(this);
+	onDisconnect();
+}
+
+void BLEClient::onDisconnect()
+{
+	_connected = false;
+	if (_callbacks)
+		_callbacks->onDisconnect(this);
+}
+
+BLERemoteService *BLEClient::getService(const BLEUUID &uuid)
+{
+	if (!_connected || !BLESimulator::instance().hasService(uuid))
+		return nullptr;
+	auto it = _services.find(uuid);
+	if (it != _services.end())
+		return it->second;
+	BLERemoteService *service = new BLERemoteService(this, uuid);
+	_services[uuid] = service;
+	return service;
+}
+
+int BLEClient::getRssi() const
+{
+	return BLESimulator::instance().rssi(_peer);
+}
+
+/*******************************************************************************************************************************
+ * BLE stack
+ */
+bool BLEDevice::_initialized = false;
+uint16_t BLEDevice::_mtu = 23;
+
+void BLEDevice::init(std::string deviceName)
+{
+	if (_initialized)
+		return;
+	_initialized = true;
+	Serial.print("BLE: simulated stack for "); Serial.println(deviceName.c_str());
+}
+
+void BLEDevice::deinit(bool release_memory)
+{
+	_initialized = false;
+}
+
+BLEScan *BLEDevice::getScan()
+{
+	static BLEScan scan;
+	return &scan;
+}
+
+BLEClient *BLEDevice::createClient()
+{
+	return new BLEClient();
+}
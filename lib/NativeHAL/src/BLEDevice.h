@@ -0,0 +1,220 @@
+/*
+	Native HAL: BLE client API of the ESP32 BLE library, backed by BLESimulator
+*/
+#ifndef _NATIVE_BLEDEVICE_h
+#define _NATIVE_BLEDEVICE_h
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class BLEClient;
+class BLERemoteService;
+class BLERemoteCharacteristic;
+
+/**
+ * BLE UUID, stored as lower case string
+ */
+class BLEUUID
+{
+  public:
+	BLEUUID() {}
+	BLEUUID(const std::string &uuid);
+	BLEUUID(const char *uuid) : BLEUUID(std::string(uuid)) {}
+	bool equals(const BLEUUID &uuid) const { return _uuid == uuid._uuid; }
+	bool operator==(const BLEUUID &uuid) const { return equals(uuid); }
+	bool operator<(const BLEUUID &uuid) const { return _uuid < uuid._uuid; }
+	std::string toString() const { return _uuid; }
+
+  private:
+	std::string _uuid;
+};
+
+/**
+ * BLE device address
+ */
+class BLEAddress
+{
+  public:
+	BLEAddress(const std::string &address = "00:00:00:00:00:00") : _address(address) {}
+	bool equals(const BLEAddress &address) const { return _address == address._address; }
+	std::string toString() const { return _address; }
+
+  private:
+	std::string _address;
+};
+
+/**
+ * result of a BLE scan
+ */
+class BLEAdvertisedDevice
+{
+  public:
+	BLEAddress getAddress() const { return _address; }
+	std::string getName() const { return _name; }
+	int getRSSI() const { return _rssi; }
+	bool haveName() const { return !_name.empty(); }
+	bool haveRSSI() const { return true; }
+	bool haveServiceUUID() const { return !_services.empty(); }
+	BLEUUID getServiceUUID() const { return _services.empty() ? BLEUUID() : _services[0]; }
+	bool isAdvertisingService(const BLEUUID &uuid) const;
+	std::string toString() const;
+
+  private:
+	friend class BLESimulator;
+	BLEAddress _address;
+	std::string _name;
+	int _rssi = 0;
+	std::vector<BLEUUID> _services;
+};
+
+class BLEAdvertisedDeviceCallbacks
+{
+  public:
+	virtual ~BLEAdvertisedDeviceCallbacks() {}
+	virtual void onResult(BLEAdvertisedDevice advertisedDevice) = 0;
+};
+
+class BLEScanResults
+{
+  public:
+	int getCount() const { return _devices.size(); }
+	BLEAdvertisedDevice getDevice(uint32_t i) const { return _devices[i]; }
+
+  private:
+	friend class BLEScan;
+	std::vector<BLEAdvertisedDevice> _devices;
+};
+
+/**
+ * BLE scanner
+ * results are reported from the simulator thread, like from the Bluetooth task on the ESP32
+ */
+class BLEScan
+{
+  public:
+	void setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks *callbacks, bool wantDuplicates = false) { _callbacks = callbacks; }
+	void setActiveScan(bool active) {}
+	void setInterval(uint16_t intervalMSecs) {}
+	void setWindow(uint16_t windowMSecs) {}
+	BLEScanResults start(uint32_t duration, bool is_continue = false);
+	bool start(uint32_t duration, void (*scanCompleteCB)(BLEScanResults), bool is_continue = false);
+	void stop();
+	void clearResults() { _results = BLEScanResults(); }
+	BLEScanResults getResults() const { return _results; }
+
+  private:
+	friend class BLESimulator;
+	void onResult(const BLEAdvertisedDevice &device);
+	void onComplete();
+
+	BLEAdvertisedDeviceCallbacks *_callbacks = nullptr;
+	void (*_scanCompleteCB)(BLEScanResults) = nullptr;
+	BLEScanResults _results;
+	volatile bool _running = false;
+};
+
+class BLEClientCallbacks
+{
+  public:
+	virtual ~BLEClientCallbacks() {}
+	virtual void onConnect(BLEClient *client) = 0;
+	virtual void onDisconnect(BLEClient *client) = 0;
+};
+
+typedef std::function<void(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify)> notify_callback;
+
+/**
+ * characteristic of a connected peripheral
+ */
+class BLERemoteCharacteristic
+{
+  public:
+	BLERemoteCharacteristic(BLERemoteService *service, const BLEUUID &uuid) : _service(service), _uuid(uuid) {}
+
+	BLEUUID getUUID() const { return _uuid; }
+	BLERemoteService *getRemoteService() const { return _service; }
+	bool canNotify() const { return true; }
+	bool canRead() const { return false; }
+	bool canWrite() const { return true; }
+	bool canWriteNoResponse() const { return true; }
+
+	void registerForNotify(notify_callback callback, bool notifications = true, bool descriptorRequiresRegistration = true);
+	void writeValue(uint8_t *data, size_t length, bool response = false);
+	void writeValue(std::string newValue, bool response = false) { writeValue((uint8_t *)newValue.data(), newValue.length(), response); }
+	void writeValue(uint8_t newValue, bool response = false) { writeValue(&newValue, 1, response); }
+
+  private:
+	friend class BLESimulator;
+	BLERemoteService *_service;
+	BLEUUID _uuid;
+	notify_callback _notifyCallback;
+};
+
+class BLERemoteService
+{
+  public:
+	BLERemoteService(BLEClient *client, const BLEUUID &uuid) : _client(client), _uuid(uuid) {}
+	~BLERemoteService();
+
+	BLEUUID getUUID() const { return _uuid; }
+	BLEClient *getClient() const { return _client; }
+	BLERemoteCharacteristic *getCharacteristic(const BLEUUID &uuid);
+
+  private:
+	BLEClient *_client;
+	BLEUUID _uuid;
+	std::map<BLEUUID, BLERemoteCharacteristic *> _characteristics;
+};
+
+/**
+ * GATT client connection
+ */
+class BLEClient
+{
+  public:
+	~BLEClient();
+
+	bool connect(BLEAdvertisedDevice *device);
+	bool connect(BLEAddress address);
+	void disconnect();
+	bool isConnected() const { return _connected; }
+	void setClientCallbacks(BLEClientCallbacks *callbacks) { _callbacks = callbacks; }
+	BLERemoteService *getService(const BLEUUID &uuid);
+	BLEAddress getPeerAddress() const { return _peer; }
+	int getRssi() const;
+	uint16_t getConnId() const { return _connId; }
+
+  private:
+	friend class BLESimulator;
+	void onDisconnect();
+
+	BLEClientCallbacks *_callbacks = nullptr;
+	BLEAddress _peer;
+	volatile bool _connected = false;
+	uint16_t _connId = 0;
+	std::map<BLEUUID, BLERemoteService *> _services;
+};
+
+/**
+ * BLE stack entry point
+ */
+class BLEDevice
+{
+  public:
+	static void init(std::string deviceName);
+	static void deinit(bool release_memory = false);
+	static bool getInitialized() { return _initialized; }
+	static BLEScan *getScan();
+	static BLEClient *createClient();
+	static void setMTU(uint16_t mtu) { _mtu = mtu; }
+	static uint16_t getMTU() { return _mtu; }
+
+  private:
+	static bool _initialized;
+	static uint16_t _mtu;
+};
+
+#endif // _NATIVE_BLEDEVICE_h
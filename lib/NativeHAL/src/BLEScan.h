@@ -0,0 +1,4 @@
+/*
+	Native HAL: BLE library headers all map to BLEDevice.h
+*/
+#include "BLEDevice.h"
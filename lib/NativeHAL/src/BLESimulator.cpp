@@ -0,0 +1,392 @@
+/*
+	Native HAL: simulated SparkMaker printers behind the BLE client API
+*/
+#include "BLESimulator.h"
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+// UUIDs of the SparkMaker GATT profile
+static const BLEUUID SimServiceUUID("0000fff0-0000-1000-8000-00805f9b34fb");
+static const BLEUUID SimServiceRxUUID("0000ffe0-0000-1000-8000-00805f9b34fb");
+static const BLEUUID SimServiceTxUUID("0000ffe5-0000-1000-8000-00805f9b34fb");
+
+// notification payload with the default MTU of 23
+static const size_t NOTIFY_PAYLOAD = 20;
+// notifications per connection interval
+static const size_t NOTIFY_PER_INTERVAL = 6;
+// layers with long bottom exposure
+static const int32_t BOTTOM_LAYERS = 5;
+
+static unsigned long envValue(const char *name, unsigned long defaultValue)
+{
+	const char *env = getenv(name);
+	return env ? strtoul(env, NULL, 10) : defaultValue;
+}
+
+BLESimulator &BLESimulator::instance()
+{
+	static BLESimulator simulator;
+	return simulator;
+}
+
+BLESimulator::BLESimulator()
+{
+	_interval = envValue("SPARKMAKER_BLE_INTERVAL_MS", 15);
+	_layerTime = envValue("SPARKMAKER_SIM_LAYER_MS", 2000);
+
+	// SD card content
+	static const char *names[] = {
+		"ValidationMatrix_10.fhd",
+		"cube_XYZ_Nova_Stan.fhd",
+		"print.fhd",
+		"rook_tower_Nova_Stan.fhd",
+		"steps Nova Stan.fhd"};
+	std::vector<std::string> files;
+	unsigned long fileCount = envValue("SPARKMAKER_SIM_FILES", 8);
+	for (unsigned long i = 0; i < fileCount; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "part_%03lu.fhd", i);
+		files.push_back(i < sizeof(names) / sizeof(names[0]) ? names[i] : name);
+	}
+
+	// printers
+	unsigned long count = envValue("SPARKMAKER_SIM_PRINTERS", 1);
+	for (unsigned long i = 0; i < count; i++)
+	{
+		Printer printer;
+		char address[18];
+		snprintf(address, sizeof(address), "00:00:5a:00:00:%02x", (unsigned)((i + 1) & 0xFF));
+		printer.device._address = BLEAddress(address);
+		printer.device._name = "SparkMaker";
+		printer.device._rssi = -50 - 5 * (int)i;
+		printer.device._services.push_back(SimServiceUUID);
+		printer.files = files;
+		_printers.push_back(printer);
+	}
+
+	// some unrelated devices
+	BLEAdvertisedDevice phone;
+	phone._address = BLEAddress("4c:00:00:00:00:01");
+	phone._name = "Phone";
+	phone._rssi = -70;
+	_others.push_back(phone);
+
+	_thread = std::thread(&BLESimulator::run, this);
+	_thread.detach();
+}
+
+/*******************************************************************************************************************************
+ * BLE client API
+ */
+void BLESimulator::startScan(BLEScan *scan, uint32_t durationMs)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_scan = scan;
+	_scanEnd = millis() + durationMs;
+	scan->_running = true;
+	_wakeup.notify_all();
+}
+
+void BLESimulator::stopScan(BLEScan *scan)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_scan == scan)
+		_scanEnd = millis();
+	_wakeup.notify_all();
+}
+
+bool BLESimulator::connect(BLEClient *client, const BLEAddress &address)
+{
+	// connection setup takes a few connection intervals
+	delay(std::max(50UL, 4 * _interval));
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto &printer : _printers)
+	{
+		if (printer.device.getAddress().equals(address) && !printer.client)
+		{
+			printer.client = client;
+			printer.rx = nullptr;
+			printer.inbox.clear();
+			printer.outbox.clear();
+			printer.nextHeartbeat = millis() + 1000;
+			printer.handshake = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+void BLESimulator::disconnect(BLEClient *client)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Printer *printer = findPrinter(client);
+	if (printer)
+	{
+		printer->client = nullptr;
+		printer->rx = nullptr;
+	}
+	_wakeup.notify_all();
+}
+
+bool BLESimulator::hasService(const BLEUUID &uuid) const
+{
+	return uuid.equals(SimServiceRxUUID) || uuid.equals(SimServiceTxUUID);
+}
+
+void BLESimulator::subscribe(BLERemoteCharacteristic *characteristic)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Printer *printer = findPrinter(characteristic->getRemoteService()->getClient());
+	if (!printer)
+		return;
+	printer->rx = characteristic;
+
+	const char *replay = getenv("SPARKMAKER_BLE_REPLAY");
+	if (replay)
+	{
+		std::ifstream file(replay, std::ios::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+		printer->outbox += content.str();
+		printer->handshake = true;
+		return;
+	}
+
+	// printer announces itself until acknowledged
+	printer->handshake = false;
+	printer->nextHandshake = millis() + 200;
+}
+
+void BLESimulator::write(BLERemoteCharacteristic *characteristic, const uint8_t *data, size_t length, bool response)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Printer *printer = findPrinter(characteristic->getRemoteService()->getClient());
+		if (!printer)
+			return;
+		printer->inbox.push_back(std::string((const char *)data, length));
+		_wakeup.notify_all();
+	}
+
+	// write with response waits for the ATT confirmation
+	if (response)
+		delay(2 * _interval);
+}
+
+int BLESimulator::rssi(const BLEAddress &address)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const auto &printer : _printers)
+	{
+		if (printer.device.getAddress().equals(address))
+			return printer.device.getRSSI();
+	}
+	return 0;
+}
+
+BLESimulator::Printer *BLESimulator::findPrinter(const BLEClient *client)
+{
+	for (auto &printer : _printers)
+	{
+		if (printer.client && printer.client == client)
+			return &printer;
+	}
+	return nullptr;
+}
+
+/*******************************************************************************************************************************
+ * printer model
+ */
+void BLESimulator::handleCommand(Printer &printer, std::string cmd)
+{
+	while (!cmd.empty() && (cmd.back() == '\n' || cmd.back() == '\r'))
+		cmd.pop_back();
+	unsigned long now = millis();
+
+	if (cmd == "PWD-OK")
+	{
+		printer.handshake = true;
+		static const char *statusMessages[] = {"standby_sts", "printing_sts", "pause_sts", "printo_sts", "stop_sts", "nocard_sts"};
+		printer.outbox += std::string(statusMessages[printer.status]) + "\n";
+		if (printer.status == SIM_PRINTING || printer.status == SIM_PAUSE)
+			printer.outbox += "F/S=" + std::to_string(printer.currentLayer) + "/" + std::to_string(printer.totalLayers) + "\n";
+		return;
+	}
+
+	if (cmd == "scan-file")
+	{
+		for (size_t i = 0; i < printer.files.size(); i++)
+			printer.outbox += "f-" + printer.files[i] + "." + std::to_string(i) + "\n";
+		printer.outbox += "scan-finish\n";
+		return;
+	}
+
+	if (cmd.compare(0, 5, "file-") == 0)
+	{
+		int id = atoi(cmd.c_str() + 5);
+		if (id >= 0 && id < (int)printer.files.size())
+		{
+			printer.selectedFile = id;
+			printer.outbox += "pf_" + printer.files[id] + "\n";
+		}
+		printer.outbox += "OK\n";
+		return;
+	}
+
+	if (cmd == "Start Printing;")
+	{
+		if (printer.status == SIM_STANDBY || printer.status == SIM_FINISHED)
+		{
+			printer.status = SIM_PRINTING;
+			printer.currentLayer = 0;
+			printer.totalLayers = 120 + 37 * std::max(printer.selectedFile, 0);
+			printer.nextLayer = now + 3 * _layerTime;
+			printer.outbox += "printing_sts\n";
+		}
+		printer.outbox += "OK\n";
+		return;
+	}
+
+	if (cmd == "Pause Printing;")
+	{
+		if (printer.status == SIM_PRINTING)
+		{
+			printer.status = SIM_PAUSE;
+			printer.outbox += "pause_sts\n";
+		}
+		return;
+	}
+
+	if (cmd == "Keep Printing;")
+	{
+		if (printer.status == SIM_PAUSE)
+		{
+			printer.status = SIM_PRINTING;
+			printer.nextLayer = now + _layerTime;
+			printer.outbox += "pause-over\n";
+		}
+		return;
+	}
+
+	if (cmd == "Stop Printing;" || cmd == "Emergency;")
+	{
+		printer.status = SIM_STOPPING;
+		printer.statusDelay = now + (cmd == "Emergency;" ? 1000 : 3000);
+		printer.outbox += "stop_sts\n";
+		return;
+	}
+
+	if (cmd.compare(0, 2, "G1") == 0 || cmd.compare(0, 3, "G28") == 0)
+	{
+		printer.outbox += "OK\n";
+		return;
+	}
+
+	printer.outbox += "ERROR\n";
+}
+
+void BLESimulator::advance(Printer &printer, unsigned long now)
+{
+	if (!printer.handshake && printer.rx && (long)(now - printer.nextHandshake) >= 0)
+	{
+		printer.outbox += "P-Ready\n";
+		printer.nextHandshake = now + 1000;
+	}
+
+	if ((long)(now - printer.nextHeartbeat) >= 0)
+	{
+		printer.outbox += "online\n";
+		printer.nextHeartbeat = now + 1000;
+	}
+
+	if (printer.status == SIM_PRINTING && (long)(now - printer.nextLayer) >= 0)
+	{
+		printer.currentLayer++;
+		printer.outbox += "F/S=" + std::to_string(printer.currentLayer) + "/" + std::to_string(printer.totalLayers) + "\n";
+		printer.nextLayer = now + (printer.currentLayer < BOTTOM_LAYERS ? 3 : 1) * _layerTime;
+		if (printer.currentLayer >= printer.totalLayers)
+		{
+			printer.status = SIM_FINISHED;
+			printer.outbox += "printo_sts\n";
+		}
+	}
+
+	if (printer.status == SIM_STOPPING && (long)(now - printer.statusDelay) >= 0)
+	{
+		printer.status = SIM_STANDBY;
+		printer.outbox += "standby_sts\n";
+	}
+}
+
+void BLESimulator::run()
+{
+	std::vector<std::function<void()>> actions;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeup.wait_for(lock, std::chrono::milliseconds(std::max(1UL, _interval)));
+			unsigned long now = millis();
+
+			// scanning
+			if (_scan)
+			{
+				BLEScan *scan = _scan;
+				if (scan->_results.getCount() == 0)
+				{
+					for (const auto &printer : _printers)
+					{
+						if (!printer.client)
+							actions.push_back([scan, printer]() { if (scan->_running) scan->onResult(printer.device); });
+					}
+					for (const auto &device : _others)
+						actions.push_back([scan, device]() { if (scan->_running) scan->onResult(device); });
+				}
+				if ((long)(now - _scanEnd) >= 0)
+				{
+					_scan = nullptr;
+					actions.push_back([scan]() { scan->onComplete(); });
+				}
+			}
+
+			// connected printers
+			for (auto &printer : _printers)
+			{
+				if (!printer.client)
+					continue;
+				for (auto &cmd : printer.inbox)
+					handleCommand(printer, cmd);
+				printer.inbox.clear();
+				advance(printer, now);
+				if (!printer.rx || printer.outbox.empty())
+					continue;
+
+				// split into notifications
+				size_t budget = _interval ? NOTIFY_PER_INTERVAL * NOTIFY_PAYLOAD : printer.outbox.size();
+				size_t length = std::min(budget, printer.outbox.size());
+				std::string data = printer.outbox.substr(0, length);
+				printer.outbox.erase(0, length);
+				BLERemoteCharacteristic *rx = printer.rx;
+				actions.push_back([rx, data]() {
+					for (size_t pos = 0; pos < data.size(); pos += NOTIFY_PAYLOAD)
+					{
+						std::string chunk = data.substr(pos, NOTIFY_PAYLOAD);
+						if (rx->_notifyCallback)
+							rx->_notifyCallback(rx, (uint8_t *)chunk.data(), chunk.size(), true);
+					}
+				});
+			}
+		}
+
+		// callbacks run without the lock, they may call back into the BLE API
+		for (auto &action : actions)
+			action();
+		actions.clear();
+	}
+}
@@ -0,0 +1,91 @@
+/*
+	Native HAL: simulated SparkMaker printers behind the BLE client API
+*/
+#ifndef _NATIVE_BLESIMULATOR_h
+#define _NATIVE_BLESIMULATOR_h
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BLEDevice.h"
+
+/**
+ * simulated radio environment with one or more SparkMaker printers
+ *
+ * the simulator thread plays the role of the ESP32 Bluetooth task: scan results, notifications and
+ * disconnects are reported from there, concurrently to the Arduino loop
+ *
+ * environment:
+ *   SPARKMAKER_SIM_PRINTERS   number of advertised printers (default 1)
+ *   SPARKMAKER_SIM_FILES      number of files on the SD card (default 8)
+ *   SPARKMAKER_SIM_LAYER_MS   exposure time of a normal layer (default 2000)
+ *   SPARKMAKER_BLE_INTERVAL_MS  connection interval (default 15), 0 delivers notifications without pacing
+ *   SPARKMAKER_BLE_REPLAY     file with raw printer output, sent instead of the simulated handshake
+ */
+class BLESimulator
+{
+  public:
+	static BLESimulator &instance();
+
+	// used by the BLE client API
+	void startScan(BLEScan *scan, uint32_t durationMs);
+	void stopScan(BLEScan *scan);
+	bool connect(BLEClient *client, const BLEAddress &address);
+	void disconnect(BLEClient *client);
+	bool hasService(const BLEUUID &uuid) const;
+	void subscribe(BLERemoteCharacteristic *characteristic);
+	void write(BLERemoteCharacteristic *characteristic, const uint8_t *data, size_t length, bool response);
+	int rssi(const BLEAddress &address);
+
+  private:
+	typedef enum
+	{
+		SIM_STANDBY,
+		SIM_PRINTING,
+		SIM_PAUSE,
+		SIM_FINISHED,
+		SIM_STOPPING,
+		SIM_NO_CARD
+	} SimStatus;
+
+	struct Printer
+	{
+		BLEAdvertisedDevice device;
+		BLEClient *client = nullptr;
+		BLERemoteCharacteristic *rx = nullptr;
+		std::vector<std::string> inbox;
+		std::string outbox;
+		SimStatus status = SIM_STANDBY;
+		std::vector<std::string> files;
+		int selectedFile = -1;
+		int32_t currentLayer = 0;
+		int32_t totalLayers = 0;
+		unsigned long nextLayer = 0;
+		unsigned long nextHeartbeat = 0;
+		unsigned long nextHandshake = 0;
+		bool handshake = false;
+		unsigned long statusDelay = 0;
+	};
+
+	BLESimulator();
+	void run();
+	Printer *findPrinter(const BLEClient *client);
+	void handleCommand(Printer &printer, std::string cmd);
+	void advance(Printer &printer, unsigned long now);
+
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	std::thread _thread;
+	std::vector<Printer> _printers;
+	std::vector<BLEAdvertisedDevice> _others;
+	BLEScan *_scan = nullptr;
+	unsigned long _scanEnd = 0;
+	unsigned long _interval;
+	unsigned long _layerTime;
+};
+
+#endif // _NATIVE_BLESIMULATOR_h
@@ -0,0 +1,32 @@
+/*
+	Native HAL: captive portal DNS server (no-op on the host)
+*/
+#ifndef _NATIVE_DNSSERVER_h
+#define _NATIVE_DNSSERVER_h
+
+#include "Arduino.h"
+
+enum class DNSReplyCode
+{
+	NoError = 0,
+	FormError = 1,
+	ServerFailure = 2,
+	NonExistentDomain = 3,
+	NotImplemented = 4,
+	Refused = 5
+};
+
+/**
+ * the host resolver is not redirected, requests simply never arrive
+ */
+class DNSServer
+{
+  public:
+	void setErrorReplyCode(const DNSReplyCode &replyCode) {}
+	void setTTL(const uint32_t &ttl) {}
+	bool start(const uint16_t &port, const String &domainName, const IPAddress &resolvedIP) { return true; }
+	void stop() {}
+	void processNextRequest() {}
+};
+
+#endif // _NATIVE_DNSSERVER_h
@@ -0,0 +1,6 @@
+/*
+	Native HAL: mDNS responder (no-op on the host)
+*/
+#include "ESPmDNS.h"
+
+MDNSResponder MDNS;
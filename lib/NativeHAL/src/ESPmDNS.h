@@ -0,0 +1,20 @@
+/*
+	Native HAL: mDNS responder (no-op on the host)
+*/
+#ifndef _NATIVE_ESPMDNS_h
+#define _NATIVE_ESPMDNS_h
+
+#include "Arduino.h"
+
+class MDNSResponder
+{
+  public:
+	bool begin(const char *hostName) { return hostName && *hostName; }
+	void end() {}
+	void addService(const char *service, const char *proto, uint16_t port) {}
+	void addService(const String &service, const String &proto, uint16_t port) {}
+};
+
+extern MDNSResponder MDNS;
+
+#endif // _NATIVE_ESPMDNS_h
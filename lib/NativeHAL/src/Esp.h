@@ -0,0 +1,30 @@
+/*
+	Native HAL: ESP system functions
+*/
+#ifndef _NATIVE_ESP_h
+#define _NATIVE_ESP_h
+
+#include <stdint.h>
+
+/**
+ * heap and chip information
+ * the heap is emulated as a fixed size pool (SPARKMAKER_HEAP, default 320 kB)
+ * from which all allocations of the process since boot are taken
+ */
+class EspClass
+{
+  public:
+	uint64_t getEfuseMac();
+	uint32_t getChipId() { return (uint32_t)getEfuseMac(); }
+	uint32_t getHeapSize();
+	uint32_t getFreeHeap();
+	uint32_t getMinFreeHeap();
+	uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+	uint32_t getCycleCount();
+	uint32_t getCpuFreqMHz() { return 240; }
+	void restart();
+};
+
+extern EspClass ESP;
+
+#endif // _NATIVE_ESP_h
@@ -0,0 +1,283 @@
+/*
+	Native HAL: file system API on a local directory
+*/
+#include "FS.h"
+#include "SPIFFS.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+using namespace fs;
+
+/**
+ * file handle state shared between copies
+ */
+struct File::Impl
+{
+	FILE *file = nullptr;
+	String path;
+	bool directory = false;
+	std::vector<String> entries;
+	size_t nextEntry = 0;
+
+	~Impl()
+	{
+		if (file)
+			fclose(file);
+	}
+};
+
+File::File(FILE *file, const String &path)
+{
+	_impl = std::make_shared<Impl>();
+	_impl->file = file;
+	_impl->path = path;
+}
+
+File::File(const std::vector<String> &entries, const String &path)
+{
+	_impl = std::make_shared<Impl>();
+	_impl->directory = true;
+	_impl->entries = entries;
+	_impl->path = path;
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+	if (!_impl || !_impl->file)
+		return 0;
+	return fwrite(buf, 1, size, _impl->file);
+}
+
+int File::available()
+{
+	if (!_impl || !_impl->file)
+		return 0;
+	return size() - position();
+}
+
+int File::read()
+{
+	uint8_t c;
+	return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+	if (!_impl || !_impl->file)
+		return 0;
+	return fread(buf, 1, size, _impl->file);
+}
+
+int File::peek()
+{
+	if (!_impl || !_impl->file)
+		return -1;
+	int c = fgetc(_impl->file);
+	if (c != EOF)
+		ungetc(c, _impl->file);
+	return c == EOF ? -1 : c;
+}
+
+void File::flush()
+{
+	if (_impl && _impl->file)
+		fflush(_impl->file);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+	if (!_impl || !_impl->file)
+		return false;
+	int whence = mode == SeekCur ? SEEK_CUR : (mode == SeekEnd ? SEEK_END : SEEK_SET);
+	return fseek(_impl->file, pos, whence) == 0;
+}
+
+size_t File::position() const
+{
+	if (!_impl || !_impl->file)
+		return 0;
+	long pos = ftell(_impl->file);
+	return pos < 0 ? 0 : pos;
+}
+
+size_t File::size() const
+{
+	if (!_impl || !_impl->file)
+		return 0;
+	fflush(_impl->file);
+	struct stat st;
+	return fstat(fileno(_impl->file), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close()
+{
+	_impl.reset();
+}
+
+time_t File::getLastWrite()
+{
+	if (!_impl || !_impl->file)
+		return 0;
+	struct stat st;
+	return fstat(fileno(_impl->file), &st) == 0 ? st.st_mtime : 0;
+}
+
+const char *File::name() const
+{
+	return _impl ? _impl->path.c_str() : nullptr;
+}
+
+bool File::isDirectory() const
+{
+	return _impl && _impl->directory;
+}
+
+File File::openNextFile(const char *mode)
+{
+	if (!isDirectory() || _impl->nextEntry >= _impl->entries.size())
+		return File();
+	return SPIFFS.open(_impl->entries[_impl->nextEntry++], mode);
+}
+
+void File::rewindDirectory()
+{
+	if (_impl)
+		_impl->nextEntry = 0;
+}
+
+/*******************************************************************************************************************************
+ * file system
+ */
+
+/**
+ * list all files below a host directory, SPIFFS has a flat name space
+ */
+static void listFiles(const String &hostDir, const String &path, std::vector<String> &entries)
+{
+	DIR *dir = opendir(hostDir.c_str());
+	if (!dir)
+		return;
+	while (struct dirent *entry = readdir(dir))
+	{
+		String name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		String hostEntry = hostDir + "/" + name;
+		String pathEntry = (path.endsWith("/") ? path : path + "/") + name;
+		struct stat st;
+		if (stat(hostEntry.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			listFiles(hostEntry, pathEntry, entries);
+		else
+			entries.push_back(pathEntry);
+	}
+	closedir(dir);
+}
+
+/**
+ * create missing parent directories of a host path
+ */
+static void createParents(const String &hostPath)
+{
+	for (int pos = hostPath.indexOf('/', 1); pos > 0; pos = hostPath.indexOf('/', pos + 1))
+		mkdir(hostPath.substring(0, pos).c_str(), 0755);
+}
+
+String FS::hostPath(const char *path)
+{
+	const char *root = getenv(_env);
+	String hostPath = root ? root : _defaultRoot;
+	if (path && *path != '/')
+		hostPath += "/";
+	return hostPath + path;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+	String host = hostPath(path);
+	struct stat st;
+	if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+	{
+		std::vector<String> entries;
+		listFiles(host, path, entries);
+		std::sort(entries.begin(), entries.end());
+		return File(entries, path);
+	}
+
+	if (mode[0] != 'r')
+		createParents(host);
+	String hostMode = String(mode) + "b";
+	FILE *file = fopen(host.c_str(), hostMode.c_str());
+	if (!file)
+		return File();
+	if (mode[0] != 'r')
+		setvbuf(file, NULL, _IONBF, 0); // a full partition shows up as a short write like on SPIFFS, not only at close
+	return File(file, path);
+}
+
+bool FS::exists(const char *path)
+{
+	struct stat st;
+	return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+	return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *pathFrom, const char *pathTo)
+{
+	// SPIFFS refuses to rename onto an existing file
+	if (exists(pathTo))
+		return false;
+	String to = hostPath(pathTo);
+	createParents(to);
+	return ::rename(hostPath(pathFrom).c_str(), to.c_str()) == 0;
+}
+
+/*******************************************************************************************************************************
+ * SPIFFS
+ */
+SPIFFSFS SPIFFS;
+
+bool SPIFFSFS::begin(bool formatOnFail, const char *basePath, uint8_t maxOpenFiles)
+{
+	String root = hostPath("");
+	if (mkdir(root.c_str(), 0755) != 0 && errno != EEXIST)
+		return false;
+	Serial.print("SPIFFS: mounted "); Serial.println(root);
+	return true;
+}
+
+bool SPIFFSFS::format()
+{
+	Serial.println("SPIFFS: format() is not supported on the host, keeping directory");
+	return true;
+}
+
+size_t SPIFFSFS::totalBytes()
+{
+	// size of the spiffs partition
+	return 0x0F0000;
+}
+
+size_t SPIFFSFS::usedBytes()
+{
+	std::vector<String> entries;
+	listFiles(hostPath(""), "/", entries);
+	size_t used = 0;
+	for (const auto &entry : entries)
+	{
+		struct stat st;
+		if (stat(hostPath(entry.c_str()).c_str(), &st) == 0)
+			used += st.st_size;
+	}
+	return used;
+}
@@ -0,0 +1,97 @@
+/*
+	Native HAL: file system API
+*/
+#ifndef _NATIVE_FS_h
+#define _NATIVE_FS_h
+
+#include <memory>
+#include <vector>
+#include <time.h>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+
+enum SeekMode
+{
+	SeekSet = 0,
+	SeekCur = 1,
+	SeekEnd = 2
+};
+
+/**
+ * file or directory handle
+ */
+class File : public Stream
+{
+  public:
+	File() {}
+	File(FILE *file, const String &path);
+	File(const std::vector<String> &entries, const String &path);
+
+	using Print::write;
+	size_t write(uint8_t c) override { return write(&c, 1); }
+	size_t write(const uint8_t *buf, size_t size) override;
+	int available() override;
+	int read() override;
+	size_t read(uint8_t *buf, size_t size);
+	size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *)buffer, length); }
+	int peek() override;
+	void flush() override;
+	bool seek(uint32_t pos, SeekMode mode = SeekSet);
+	size_t position() const;
+	size_t size() const;
+	void close();
+	explicit operator bool() const { return (bool)_impl; }
+	time_t getLastWrite();
+	const char *name() const;
+	const char *path() const { return name(); }
+
+	bool isDirectory() const;
+	File openNextFile(const char *mode = FILE_READ);
+	void rewindDirectory();
+
+  private:
+	struct Impl;
+	std::shared_ptr<Impl> _impl;
+};
+
+/**
+ * file system rooted in a local directory
+ */
+class FS
+{
+  public:
+	explicit FS(const char *env, const char *defaultRoot) : _env(env), _defaultRoot(defaultRoot) {}
+
+	File open(const char *path, const char *mode = FILE_READ);
+	File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+	bool exists(const char *path);
+	bool exists(const String &path) { return exists(path.c_str()); }
+	bool remove(const char *path);
+	bool remove(const String &path) { return remove(path.c_str()); }
+	bool rename(const char *pathFrom, const char *pathTo);
+	bool rename(const String &pathFrom, const String &pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+
+	String hostPath(const char *path);
+
+  protected:
+	const char *_env;
+	const char *_defaultRoot;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
+
+#endif // _NATIVE_FS_h
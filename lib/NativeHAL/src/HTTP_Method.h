@@ -0,0 +1,19 @@
+/*
+	Native HAL: HTTP methods
+*/
+#ifndef _NATIVE_HTTP_METHOD_h
+#define _NATIVE_HTTP_METHOD_h
+
+typedef enum
+{
+	HTTP_DELETE = 0,
+	HTTP_GET = 1,
+	HTTP_HEAD = 2,
+	HTTP_POST = 3,
+	HTTP_PUT = 4,
+	HTTP_OPTIONS = 6,
+	HTTP_PATCH = 28,
+	HTTP_ANY = 127
+} HTTPMethod;
+
+#endif // _NATIVE_HTTP_METHOD_h
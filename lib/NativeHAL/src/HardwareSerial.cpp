@@ -0,0 +1,36 @@
+/*
+	Native HAL: serial console on stdout
+*/
+#include "HardwareSerial.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	const char *quiet = getenv("SPARKMAKER_QUIET");
+	_quiet = quiet && *quiet && *quiet != '0';
+	// line buffered like a terminal, also when redirected to a file
+	setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	if (!_quiet)
+		fputc(c, stdout);
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+	if (!_quiet)
+		fwrite(buffer, 1, size, stdout);
+	return size;
+}
+
+void HardwareSerial::flush()
+{
+	fflush(stdout);
+}
@@ -0,0 +1,40 @@
+/*
+	Native HAL: serial console on stdout
+*/
+#ifndef _NATIVE_HARDWARESERIAL_h
+#define _NATIVE_HARDWARESERIAL_h
+
+#include "Stream.h"
+
+/**
+ * serial port mapped to stdin / stdout
+ * set SPARKMAKER_QUIET=1 to discard output while benchmarking
+ */
+class HardwareSerial : public Stream
+{
+  public:
+	void begin(unsigned long baud);
+	void end() {}
+	explicit operator bool() const { return true; }
+
+	int available() override { return 0; }
+	int read() override { return -1; }
+	int peek() override { return -1; }
+
+	using Print::write;
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	void flush() override;
+
+	/**
+	 * enable / disable console output
+	 */
+	void setQuiet(bool quiet) { _quiet = quiet; }
+
+  private:
+	bool _quiet = false;
+};
+
+extern HardwareSerial Serial;
+
+#endif // _NATIVE_HARDWARESERIAL_h
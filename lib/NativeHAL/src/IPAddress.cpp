@@ -0,0 +1,48 @@
+/*
+	Native HAL: Arduino IPAddress
+*/
+#include "IPAddress.h"
+#include "Print.h"
+
+#include <stdio.h>
+
+IPAddress::IPAddress(uint32_t address)
+{
+	// network byte order, like lwIP
+	_address[0] = address & 0xFF;
+	_address[1] = (address >> 8) & 0xFF;
+	_address[2] = (address >> 16) & 0xFF;
+	_address[3] = (address >> 24) & 0xFF;
+}
+
+IPAddress::operator uint32_t() const
+{
+	return _address[0] | (_address[1] << 8) | (_address[2] << 16) | ((uint32_t)_address[3] << 24);
+}
+
+bool IPAddress::fromString(const char *address)
+{
+	unsigned a, b, c, d;
+	char tail;
+	if (!address || sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4)
+		return false;
+	if (a > 255 || b > 255 || c > 255 || d > 255)
+		return false;
+	_address[0] = a;
+	_address[1] = b;
+	_address[2] = c;
+	_address[3] = d;
+	return true;
+}
+
+String IPAddress::toString() const
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _address[0], _address[1], _address[2], _address[3]);
+	return String(buf);
+}
+
+size_t IPAddress::printTo(Print &p) const
+{
+	return p.print(toString());
+}
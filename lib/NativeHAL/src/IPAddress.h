@@ -0,0 +1,39 @@
+/*
+	Native HAL: Arduino IPAddress
+*/
+#ifndef _NATIVE_IPADDRESS_h
+#define _NATIVE_IPADDRESS_h
+
+#include <stdint.h>
+
+#include "Printable.h"
+#include "WString.h"
+
+/**
+ * IPv4 address
+ */
+class IPAddress : public Printable
+{
+  public:
+	IPAddress() {}
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address{a, b, c, d} {}
+	IPAddress(const uint8_t *address) : _address{address[0], address[1], address[2], address[3]} {}
+	explicit IPAddress(uint32_t address);
+
+	bool fromString(const char *address);
+	bool fromString(const String &address) { return fromString(address.c_str()); }
+	String toString() const;
+
+	operator uint32_t() const;
+	uint8_t operator[](int index) const { return _address[index]; }
+	uint8_t &operator[](int index) { return _address[index]; }
+	bool operator==(const IPAddress &rhs) const { return (uint32_t)*this == (uint32_t)rhs; }
+	bool operator!=(const IPAddress &rhs) const { return !(*this == rhs); }
+
+	size_t printTo(Print &p) const override;
+
+  private:
+	uint8_t _address[4] = {0, 0, 0, 0};
+};
+
+#endif // _NATIVE_IPADDRESS_h
@@ -0,0 +1,16 @@
+/*
+	Native HAL: program entry point
+	kept in its own translation unit, so programs with their own main() can link the HAL
+*/
+#include "Arduino.h"
+
+int main()
+{
+	setup();
+	for (;;)
+	{
+		loop();
+		// give other threads a chance, like the idle task on the ESP32
+		yield();
+	}
+}
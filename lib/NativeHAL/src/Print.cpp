@@ -0,0 +1,39 @@
+/*
+	Native HAL: Arduino Print
+*/
+#include "Print.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+	{
+		if (!write(*buffer++))
+			break;
+		n++;
+	}
+	return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+	char buf[128];
+	va_list arg;
+	va_start(arg, format);
+	int len = vsnprintf(buf, sizeof(buf), format, arg);
+	va_end(arg);
+	if (len < 0)
+		return 0;
+	if ((size_t)len < sizeof(buf))
+		return write(buf, len);
+
+	std::vector<char> big(len + 1);
+	va_start(arg, format);
+	vsnprintf(big.data(), big.size(), format, arg);
+	va_end(arg);
+	return write(big.data(), len);
+}
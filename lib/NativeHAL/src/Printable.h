@@ -0,0 +1,21 @@
+/*
+	Native HAL: Arduino Printable
+*/
+#ifndef _NATIVE_PRINTABLE_h
+#define _NATIVE_PRINTABLE_h
+
+#include <stddef.h>
+
+class Print;
+
+/**
+ * interface for objects that know how to print themselves
+ */
+class Printable
+{
+  public:
+	virtual ~Printable() {}
+	virtual size_t printTo(Print &p) const = 0;
+};
+
+#endif // _NATIVE_PRINTABLE_h
@@ -0,0 +1,30 @@
+/*
+	Native HAL: SPIFFS on a local directory
+*/
+#ifndef _NATIVE_SPIFFS_h
+#define _NATIVE_SPIFFS_h
+
+#include "FS.h"
+
+namespace fs
+{
+
+/**
+ * SPIFFS partition mapped to the directory SPARKMAKER_FS (default "data", the file system image source)
+ */
+class SPIFFSFS : public FS
+{
+  public:
+	SPIFFSFS() : FS("SPARKMAKER_FS", "data") {}
+	bool begin(bool formatOnFail = false, const char *basePath = "/spiffs", uint8_t maxOpenFiles = 10);
+	bool format();
+	size_t totalBytes();
+	size_t usedBytes();
+	void end() {}
+};
+
+} // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif // _NATIVE_SPIFFS_h
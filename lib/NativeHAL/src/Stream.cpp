@@ -0,0 +1,50 @@
+/*
+	Native HAL: Arduino Stream
+*/
+#include "Stream.h"
+#include "Arduino.h"
+
+int Stream::timedRead()
+{
+	unsigned long start = millis();
+	do
+	{
+		int c = read();
+		if (c >= 0)
+			return c;
+		yield();
+	} while (millis() - start < _timeout);
+	return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+	size_t count = 0;
+	while (count < length)
+	{
+		int c = timedRead();
+		if (c < 0)
+			break;
+		*buffer++ = (char)c;
+		count++;
+	}
+	return count;
+}
+
+String Stream::readString()
+{
+	String ret;
+	int c;
+	while ((c = timedRead()) >= 0)
+		ret += (char)c;
+	return ret;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+	String ret;
+	int c;
+	while ((c = timedRead()) >= 0 && c != terminator)
+		ret += (char)c;
+	return ret;
+}
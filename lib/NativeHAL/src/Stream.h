@@ -0,0 +1,32 @@
+/*
+	Native HAL: Arduino Stream
+*/
+#ifndef _NATIVE_STREAM_h
+#define _NATIVE_STREAM_h
+
+#include "Print.h"
+
+/**
+ * Arduino compatible Stream base class
+ */
+class Stream : public Print
+{
+  public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	void setTimeout(unsigned long timeout) { _timeout = timeout; }
+	unsigned long getTimeout() const { return _timeout; }
+
+	virtual size_t readBytes(char *buffer, size_t length);
+	size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+	String readString();
+	String readStringUntil(char terminator);
+
+  protected:
+	int timedRead();
+	unsigned long _timeout = 1000;
+};
+
+#endif // _NATIVE_STREAM_h
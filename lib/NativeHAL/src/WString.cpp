@@ -0,0 +1,150 @@
+/*
+	Native HAL: Arduino String
+*/
+#include "WString.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * format integer in given base
+ */
+template <typename T>
+static std::string formatInteger(T value, unsigned char base)
+{
+	if (base == 10)
+		return std::to_string(value);
+
+	bool negative = value < 0;
+	unsigned long long v = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+	std::string str;
+	do
+	{
+		unsigned d = v % base;
+		str += (char)(d < 10 ? '0' + d : 'a' + d - 10);
+		v /= base;
+	} while (v);
+	if (negative)
+		str += '-';
+	std::reverse(str.begin(), str.end());
+	return str;
+}
+
+String::String(unsigned char value, unsigned char base) : _str(formatInteger((unsigned)value, base)) {}
+String::String(int value, unsigned char base) : _str(formatInteger(value, base)) {}
+String::String(unsigned int value, unsigned char base) : _str(formatInteger(value, base)) {}
+String::String(long value, unsigned char base) : _str(formatInteger(value, base)) {}
+String::String(unsigned long value, unsigned char base) : _str(formatInteger(value, base)) {}
+String::String(long long value, unsigned char base) : _str(formatInteger(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : _str(formatInteger(value, base)) {}
+
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+String::String(double value, unsigned char decimalPlaces)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+	_str = buf;
+}
+
+bool String::equalsIgnoreCase(const String &s) const
+{
+	if (length() != s.length())
+		return false;
+	for (size_t i = 0; i < length(); i++)
+	{
+		if (tolower((unsigned char)_str[i]) != tolower((unsigned char)s._str[i]))
+			return false;
+	}
+	return true;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+	if (suffix.length() > length())
+		return false;
+	return _str.compare(length() - suffix.length(), suffix.length(), suffix._str) == 0;
+}
+
+void String::getBytes(unsigned char *buf, size_t bufsize, size_t index) const
+{
+	if (!bufsize || !buf)
+		return;
+	if (index >= length())
+	{
+		buf[0] = 0;
+		return;
+	}
+	size_t n = std::min(bufsize - 1, length() - index);
+	memcpy(buf, _str.data() + index, n);
+	buf[n] = 0;
+}
+
+String String::substring(size_t beginIndex, size_t endIndex) const
+{
+	if (beginIndex > endIndex)
+		std::swap(beginIndex, endIndex);
+	if (beginIndex >= length())
+		return String();
+	if (endIndex > length())
+		endIndex = length();
+	return String(_str.data() + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace)
+{
+	std::replace(_str.begin(), _str.end(), find, replace);
+}
+
+void String::replace(const String &find, const String &replace)
+{
+	if (find.isEmpty())
+		return;
+	size_t pos = 0;
+	while ((pos = _str.find(find._str, pos)) != std::string::npos)
+	{
+		_str.replace(pos, find.length(), replace._str);
+		pos += replace.length();
+	}
+}
+
+void String::toLowerCase()
+{
+	for (auto &c : _str)
+		c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase()
+{
+	for (auto &c : _str)
+		c = toupper((unsigned char)c);
+}
+
+void String::trim()
+{
+	size_t begin = _str.find_first_not_of(" \t\r\n\f\v");
+	if (begin == std::string::npos)
+	{
+		_str.clear();
+		return;
+	}
+	size_t end = _str.find_last_not_of(" \t\r\n\f\v");
+	_str = _str.substr(begin, end - begin + 1);
+}
+
+long String::toInt() const
+{
+	return atol(_str.c_str());
+}
+
+float String::toFloat() const
+{
+	return (float)atof(_str.c_str());
+}
+
+double String::toDouble() const
+{
+	return atof(_str.c_str());
+}
@@ -0,0 +1,119 @@
+/*
+	Native HAL: Arduino String
+*/
+#ifndef _NATIVE_WSTRING_h
+#define _NATIVE_WSTRING_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/**
+ * Arduino compatible String backed by std::string
+ */
+class String
+{
+  public:
+	String() {}
+	String(const char *cstr) : _str(cstr ? cstr : "") {}
+	String(const char *cstr, size_t length) : _str(cstr ? std::string(cstr, length) : std::string()) {}
+	String(const String &str) = default;
+	String(String &&str) = default;
+	explicit String(char c) : _str(1, c) {}
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(long long value, unsigned char base = 10);
+	explicit String(unsigned long long value, unsigned char base = 10);
+	explicit String(float value, unsigned char decimalPlaces = 2);
+	explicit String(double value, unsigned char decimalPlaces = 2);
+
+	String &operator=(const String &rhs) = default;
+	String &operator=(String &&rhs) = default;
+	String &operator=(const char *cstr) { _str = cstr ? cstr : ""; return *this; }
+
+	// memory
+	bool reserve(size_t size) { _str.reserve(size); return true; }
+	size_t length() const { return _str.length(); }
+	bool isEmpty() const { return _str.empty(); }
+	const char *c_str() const { return _str.c_str(); }
+	explicit operator bool() const { return true; }
+
+	// concatenation
+	bool concat(const String &str) { _str += str._str; return true; }
+	bool concat(const char *cstr) { if (cstr) _str += cstr; return cstr != nullptr; }
+	bool concat(const char *cstr, size_t length) { if (cstr) _str.append(cstr, length); return cstr != nullptr; }
+	bool concat(char c) { _str += c; return true; }
+	bool concat(int value) { return concat(String(value)); }
+	bool concat(unsigned int value) { return concat(String(value)); }
+	bool concat(long value) { return concat(String(value)); }
+	bool concat(unsigned long value) { return concat(String(value)); }
+	bool concat(double value) { return concat(String(value)); }
+	template <typename T>
+	String &operator+=(const T &rhs) { concat(rhs); return *this; }
+
+	// comparison
+	int compareTo(const String &s) const { return _str.compare(s._str); }
+	bool equals(const String &s) const { return _str == s._str; }
+	bool equals(const char *cstr) const { return _str == (cstr ? cstr : ""); }
+	bool equalsIgnoreCase(const String &s) const;
+	bool operator==(const String &rhs) const { return equals(rhs); }
+	bool operator==(const char *cstr) const { return equals(cstr); }
+	bool operator!=(const String &rhs) const { return !equals(rhs); }
+	bool operator!=(const char *cstr) const { return !equals(cstr); }
+	bool operator<(const String &rhs) const { return _str < rhs._str; }
+	bool operator>(const String &rhs) const { return _str > rhs._str; }
+	bool startsWith(const String &prefix) const { return _str.compare(0, prefix.length(), prefix._str) == 0; }
+	bool startsWith(const String &prefix, size_t offset) const { return offset <= length() && _str.compare(offset, prefix.length(), prefix._str) == 0; }
+	bool endsWith(const String &suffix) const;
+
+	// character access
+	char charAt(size_t index) const { return index < _str.length() ? _str[index] : 0; }
+	void setCharAt(size_t index, char c) { if (index < _str.length()) _str[index] = c; }
+	char operator[](size_t index) const { return charAt(index); }
+	char &operator[](size_t index) { return _str[index]; }
+	void getBytes(unsigned char *buf, size_t bufsize, size_t index = 0) const;
+	void toCharArray(char *buf, size_t bufsize, size_t index = 0) const { getBytes((unsigned char *)buf, bufsize, index); }
+
+	// search
+	int indexOf(char ch, size_t fromIndex = 0) const { return npos(_str.find(ch, fromIndex)); }
+	int indexOf(const String &str, size_t fromIndex = 0) const { return npos(_str.find(str._str, fromIndex)); }
+	int lastIndexOf(char ch) const { return npos(_str.rfind(ch)); }
+	int lastIndexOf(char ch, size_t fromIndex) const { return npos(_str.rfind(ch, fromIndex)); }
+	int lastIndexOf(const String &str) const { return npos(_str.rfind(str._str)); }
+	String substring(size_t beginIndex) const { return beginIndex < length() ? String(_str.substr(beginIndex).c_str()) : String(); }
+	String substring(size_t beginIndex, size_t endIndex) const;
+
+	// modification
+	void replace(char find, char replace);
+	void replace(const String &find, const String &replace);
+	void remove(size_t index) { if (index < length()) _str.erase(index); }
+	void remove(size_t index, size_t count) { if (index < length()) _str.erase(index, count); }
+	void toLowerCase();
+	void toUpperCase();
+	void trim();
+
+	// parsing
+	long toInt() const;
+	float toFloat() const;
+	double toDouble() const;
+
+  private:
+	static int npos(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+	std::string _str;
+};
+
+inline String operator+(const String &lhs, const String &rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const String &lhs, const char *rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const char *lhs, const String &rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const String &lhs, char rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const String &lhs, int rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const String &lhs, unsigned int rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const String &lhs, long rhs) { String s(lhs); s.concat(rhs); return s; }
+inline String operator+(const String &lhs, unsigned long rhs) { String s(lhs); s.concat(rhs); return s; }
+inline bool operator==(const char *lhs, const String &rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char *lhs, const String &rhs) { return !rhs.equals(lhs); }
+
+#endif // _NATIVE_WSTRING_h
@@ -0,0 +1,369 @@
+/*
+	Native HAL: synchronous HTTP server, API of the ESP32 WebServer library
+*/
+#include "WebServer.h"
+
+#include <stdio.h>
+
+void WebServer::on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn)
+{
+	_handlers.push_back({uri, method, fn, ufn});
+}
+
+void WebServer::handleClient()
+{
+	WiFiClient client = _server.available();
+	if (!client)
+		return;
+
+	_currentClient = client;
+	if (parseRequest(_currentClient))
+	{
+		_contentLength = CONTENT_LENGTH_NOT_SET;
+		handleRequest();
+	}
+
+	// release the connection, handlers may keep their own copy of the client open
+	_currentClient = WiFiClient();
+	_responseHeaders = "";
+	_chunked = false;
+}
+
+/*******************************************************************************************************************************
+ * request parsing
+ */
+bool WebServer::parseRequest(WiFiClient &client)
+{
+	_args.clear();
+	_headers.clear();
+	_hostHeader = "";
+
+	// read header block
+	String request;
+	unsigned long start = millis();
+	while (!request.endsWith("\r\n\r\n"))
+	{
+		int c = client.read();
+		if (c < 0)
+		{
+			if (!client.connected() || millis() - start > HTTP_MAX_DATA_WAIT)
+				return false;
+			delay(1);
+			continue;
+		}
+		request += (char)c;
+	}
+	int headerEnd = request.length() - 4;
+
+	// request line
+	int lineEnd = request.indexOf("\r\n");
+	String line = request.substring(0, lineEnd);
+	int sp1 = line.indexOf(' ');
+	int sp2 = line.indexOf(' ', sp1 + 1);
+	if (sp1 < 0 || sp2 < 0)
+		return false;
+	String methodStr = line.substring(0, sp1);
+	String url = line.substring(sp1 + 1, sp2);
+	_currentVersion = line.endsWith("1.0") ? 0 : 1;
+	_currentMethod = HTTP_GET;
+	if (methodStr == "POST")
+		_currentMethod = HTTP_POST;
+	else if (methodStr == "DELETE")
+		_currentMethod = HTTP_DELETE;
+	else if (methodStr == "OPTIONS")
+		_currentMethod = HTTP_OPTIONS;
+	else if (methodStr == "PUT")
+		_currentMethod = HTTP_PUT;
+	else if (methodStr == "PATCH")
+		_currentMethod = HTTP_PATCH;
+	else if (methodStr == "HEAD")
+		_currentMethod = HTTP_HEAD;
+
+	int query = url.indexOf('?');
+	_currentUri = query >= 0 ? url.substring(0, query) : url;
+	if (query >= 0)
+		parseArguments(url.substring(query + 1));
+
+	// headers
+	size_t contentLength = 0;
+	String contentType;
+	int pos = lineEnd + 2;
+	while (pos < headerEnd)
+	{
+		int end = request.indexOf("\r\n", pos);
+		String header = request.substring(pos, end);
+		pos = end + 2;
+		int colon = header.indexOf(':');
+		if (colon < 0)
+			continue;
+		String name = header.substring(0, colon);
+		String value = header.substring(colon + 1);
+		value.trim();
+
+		if (name.equalsIgnoreCase("Host"))
+		{
+			// report the host as seen on the device port, not the remapped host port
+			int portSep = value.lastIndexOf(':');
+			if (portSep > 0 && value.substring(portSep + 1).toInt() == WiFiServer::hostPort(_server.port()))
+				value = value.substring(0, portSep);
+			_hostHeader = value;
+		}
+		else if (name.equalsIgnoreCase("Content-Length"))
+			contentLength = value.toInt();
+		else if (name.equalsIgnoreCase("Content-Type"))
+			contentType = value;
+
+		for (const auto &key : _collectHeaders)
+		{
+			if (name.equalsIgnoreCase(key))
+				_headers.push_back({key, value});
+		}
+	}
+
+	// body
+	String body;
+	start = millis();
+	while (body.length() < contentLength)
+	{
+		int c = client.read();
+		if (c < 0)
+		{
+			if (!client.connected() || millis() - start > HTTP_MAX_DATA_WAIT)
+				return false;
+			delay(1);
+			continue;
+		}
+		body += (char)c;
+	}
+	if (!body.isEmpty())
+	{
+		if (contentType.startsWith("application/x-www-form-urlencoded"))
+			parseArguments(body);
+		else if (contentType.startsWith("multipart/form-data"))
+			parseMultipart(body, contentType.substring(contentType.indexOf("boundary=") + 9));
+		else
+			_args.push_back({"plain", body});
+	}
+	return true;
+}
+
+void WebServer::parseArguments(const String &data)
+{
+	int pos = 0;
+	while (pos < (int)data.length())
+	{
+		int end = data.indexOf('&', pos);
+		if (end < 0)
+			end = data.length();
+		String pair = data.substring(pos, end);
+		pos = end + 1;
+		if (pair.isEmpty())
+			continue;
+		int eq = pair.indexOf('=');
+		if (eq < 0)
+			_args.push_back({urlDecode(pair), String()});
+		else
+			_args.push_back({urlDecode(pair.substring(0, eq)), urlDecode(pair.substring(eq + 1))});
+	}
+}
+
+void WebServer::parseMultipart(const String &body, const String &boundary)
+{
+	String delimiter = "--" + boundary;
+	int pos = body.indexOf(delimiter);
+	while (pos >= 0)
+	{
+		int partStart = pos + delimiter.length();
+		if (body.substring(partStart, partStart + 2) == "--")
+			break;
+		int next = body.indexOf(delimiter, partStart);
+		if (next < 0)
+			break;
+		String part = body.substring(partStart + 2, next - 2);
+		pos = next;
+
+		int headerEnd = part.indexOf("\r\n\r\n");
+		if (headerEnd < 0)
+			continue;
+		String headers = part.substring(0, headerEnd);
+		int nameStart = headers.indexOf("name=\"");
+		if (nameStart < 0)
+			continue;
+		nameStart += 6;
+		String name = headers.substring(nameStart, headers.indexOf('"', nameStart));
+		_args.push_back({name, part.substring(headerEnd + 4)});
+	}
+}
+
+String WebServer::urlDecode(const String &text)
+{
+	String decoded;
+	for (size_t i = 0; i < text.length(); i++)
+	{
+		char c = text[i];
+		if (c == '+')
+			decoded += ' ';
+		else if (c == '%' && i + 2 < text.length())
+		{
+			char hex[3] = {text[i + 1], text[i + 2], 0};
+			decoded += (char)strtol(hex, NULL, 16);
+			i += 2;
+		}
+		else
+			decoded += c;
+	}
+	return decoded;
+}
+
+String WebServer::arg(const String &name) const
+{
+	for (const auto &arg : _args)
+	{
+		if (arg.key == name)
+			return arg.value;
+	}
+	return String();
+}
+
+bool WebServer::hasArg(const String &name) const
+{
+	for (const auto &arg : _args)
+	{
+		if (arg.key == name)
+			return true;
+	}
+	return false;
+}
+
+void WebServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+	_collectHeaders.clear();
+	for (size_t i = 0; i < headerKeysCount; i++)
+		_collectHeaders.push_back(headerKeys[i]);
+}
+
+String WebServer::header(const String &name) const
+{
+	for (const auto &header : _headers)
+	{
+		if (header.key.equalsIgnoreCase(name))
+			return header.value;
+	}
+	return String();
+}
+
+bool WebServer::hasHeader(const String &name) const
+{
+	for (const auto &header : _headers)
+	{
+		if (header.key.equalsIgnoreCase(name))
+			return true;
+	}
+	return false;
+}
+
+void WebServer::handleRequest()
+{
+	for (const auto &handler : _handlers)
+	{
+		if ((handler.method == HTTP_ANY || handler.method == _currentMethod) && handler.uri == _currentUri)
+		{
+			handler.fn();
+			return;
+		}
+	}
+	if (_notFoundHandler)
+		_notFoundHandler();
+	else
+		send(404, "text/plain", String("Not found: ") + _currentUri);
+}
+
+/*******************************************************************************************************************************
+ * response
+ */
+const char *WebServer::responseCodeToString(int code)
+{
+	switch (code)
+	{
+	case 101: return "Switching Protocols";
+	case 200: return "OK";
+	case 204: return "No Content";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 500: return "Internal Server Error";
+	case 503: return "Service Unavailable";
+	default: return "";
+	}
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+	String line = name + ": " + value + "\r\n";
+	if (first)
+		_responseHeaders = line + _responseHeaders;
+	else
+		_responseHeaders += line;
+}
+
+void WebServer::send(int code, const char *content_type, const String &content)
+{
+	String response = String("HTTP/1.") + String(_currentVersion) + " " + String(code) + " " + responseCodeToString(code) + "\r\n";
+	sendHeader("Content-Type", content_type ? content_type : "text/html", true);
+	if (_contentLength == CONTENT_LENGTH_NOT_SET)
+		sendHeader("Content-Length", String(content.length()));
+	else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
+		sendHeader("Content-Length", String(_contentLength));
+	else if (_currentVersion)
+	{
+		_chunked = true;
+		sendHeader("Accept-Ranges", "none");
+		sendHeader("Transfer-Encoding", "chunked");
+	}
+	sendHeader("Connection", "close");
+	response += _responseHeaders;
+	response += "\r\n";
+	_responseHeaders = "";
+	_currentClient.write(response.c_str(), response.length());
+	if (content.length())
+		sendContent(content);
+}
+
+void WebServer::sendContent(const char *content, size_t contentLength)
+{
+	if (_chunked)
+	{
+		char chunkSize[12];
+		int n = snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", contentLength);
+		_currentClient.write(chunkSize, n);
+	}
+	_currentClient.write(content, contentLength);
+	if (_chunked)
+	{
+		_currentClient.write("\r\n", 2);
+		if (!contentLength)
+			_chunked = false;
+	}
+}
+
+size_t WebServer::streamContent(Stream &stream)
+{
+	uint8_t buf[1360];
+	size_t total = 0;
+	while (true)
+	{
+		size_t n = stream.readBytes(buf, sizeof(buf));
+		if (!n)
+			break;
+		size_t sent = _currentClient.write(buf, n);
+		total += sent;
+		if (sent < n)
+			break;
+	}
+	return total;
+}
@@ -0,0 +1,124 @@
+/*
+	Native HAL: synchronous HTTP server, API of the ESP32 WebServer library
+*/
+#ifndef _NATIVE_WEBSERVER_h
+#define _NATIVE_WEBSERVER_h
+
+#include <functional>
+#include <vector>
+
+#include "Arduino.h"
+#include "HTTP_Method.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+// maximum time to wait for request data [ms]
+#define HTTP_MAX_DATA_WAIT 5000
+
+/**
+ * HTTP/1.1 server handling one client per handleClient() call, like the ESP32 WebServer
+ */
+class WebServer
+{
+  public:
+	typedef std::function<void(void)> THandlerFunction;
+
+	explicit WebServer(int port = 80) : _server(port) {}
+
+	void begin() { _server.begin(); }
+	void begin(uint16_t port) { _server.begin(port); }
+	void handleClient();
+	void close() { _server.end(); }
+	void stop() { close(); }
+
+	// routing
+	void on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+	void on(const String &uri, HTTPMethod method, THandlerFunction fn) { on(uri, method, fn, THandlerFunction()); }
+	void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
+	void onNotFound(THandlerFunction fn) { _notFoundHandler = fn; }
+
+	// request
+	String uri() const { return _currentUri; }
+	HTTPMethod method() const { return _currentMethod; }
+	WiFiClient client() { return _currentClient; }
+	String arg(const String &name) const;
+	String arg(int i) const { return i < (int)_args.size() ? _args[i].value : String(); }
+	String argName(int i) const { return i < (int)_args.size() ? _args[i].key : String(); }
+	int args() const { return _args.size(); }
+	bool hasArg(const String &name) const;
+	void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+	String header(const String &name) const;
+	String header(int i) const { return i < (int)_headers.size() ? _headers[i].value : String(); }
+	String headerName(int i) const { return i < (int)_headers.size() ? _headers[i].key : String(); }
+	int headers() const { return _headers.size(); }
+	bool hasHeader(const String &name) const;
+	String hostHeader() const { return _hostHeader; }
+
+	// response
+	void send(int code, const char *content_type = NULL, const String &content = String(""));
+	void send(int code, char *content_type, const String &content) { send(code, (const char *)content_type, content); }
+	void send(int code, const String &content_type, const String &content) { send(code, content_type.c_str(), content); }
+	void setContentLength(const size_t contentLength) { _contentLength = contentLength; }
+	void sendHeader(const String &name, const String &value, bool first = false);
+	void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+	void sendContent(const char *content, size_t contentLength);
+	void sendContent_P(PGM_P content, size_t contentLength) { sendContent(content, contentLength); }
+
+	template <typename T>
+	size_t streamFile(T &file, const String &contentType)
+	{
+		setContentLength(file.size());
+		String name = file.name();
+		if (name.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream")
+			sendHeader("Content-Encoding", "gzip");
+		send(200, contentType, "");
+		return streamContent(file);
+	}
+
+	static String urlDecode(const String &text);
+
+  private:
+	struct KeyValue
+	{
+		String key;
+		String value;
+	};
+	struct Handler
+	{
+		String uri;
+		HTTPMethod method;
+		THandlerFunction fn;
+		THandlerFunction ufn;
+	};
+
+	bool parseRequest(WiFiClient &client);
+	void parseArguments(const String &data);
+	void parseMultipart(const String &body, const String &boundary);
+	void handleRequest();
+	size_t streamContent(Stream &stream);
+	static const char *responseCodeToString(int code);
+
+	WiFiServer _server;
+	std::vector<Handler> _handlers;
+	THandlerFunction _notFoundHandler;
+
+	// current request
+	WiFiClient _currentClient;
+	HTTPMethod _currentMethod = HTTP_ANY;
+	String _currentUri;
+	uint8_t _currentVersion = 1;
+	std::vector<KeyValue> _args;
+	std::vector<KeyValue> _headers;
+	std::vector<String> _collectHeaders;
+	String _hostHeader;
+
+	// current response
+	String _responseHeaders;
+	size_t _contentLength = CONTENT_LENGTH_NOT_SET;
+	bool _chunked = false;
+};
+
+#endif // _NATIVE_WEBSERVER_h
@@ -0,0 +1,300 @@
+/*
+	Native HAL: simulated WiFi station / access point
+*/
+#include "WiFi.h"
+
+#include <stdio.h>
+
+WiFiClass WiFi;
+
+// duration of a simulated scan [ms], about what the ESP32 needs for all channels
+static const unsigned long SCAN_DURATION = 2000;
+
+static unsigned long envMillis(const char *name, unsigned long defaultValue)
+{
+	const char *env = getenv(name);
+	return env ? strtoul(env, NULL, 10) : defaultValue;
+}
+
+/**
+ * simulated router outage "start:duration" [ms since boot], no network is visible meanwhile
+ */
+static bool outage()
+{
+	static unsigned long start = 0, duration = 0;
+	static bool parsed = false;
+	if (!parsed)
+	{
+		parsed = true;
+		const char *env = getenv("SPARKMAKER_WIFI_OUTAGE");
+		if (env)
+		{
+			char *end;
+			start = strtoul(env, &end, 10);
+			duration = *end == ':' ? strtoul(end + 1, NULL, 10) : 0;
+		}
+	}
+	return duration && millis() - start < duration && millis() >= start;
+}
+
+const std::vector<WiFiClass::Network> &WiFiClass::environment()
+{
+	static std::vector<Network> networks;
+	static bool parsed = false;
+	if (parsed)
+		return networks;
+	parsed = true;
+
+	// parse "ssid:rssi:channel,..."
+	const char *env = getenv("SPARKMAKER_WIFI");
+	String spec = env ? env : "test:-40:6,neighbour:-72:11";
+	int start = 0;
+	while (start < (int)spec.length())
+	{
+		int end = spec.indexOf(',', start);
+		if (end < 0)
+			end = spec.length();
+		String entry = spec.substring(start, end);
+		start = end + 1;
+
+		Network net;
+		int sep1 = entry.indexOf(':');
+		int sep2 = sep1 >= 0 ? entry.indexOf(':', sep1 + 1) : -1;
+		net.ssid = sep1 >= 0 ? entry.substring(0, sep1) : entry;
+		net.rssi = sep1 >= 0 ? entry.substring(sep1 + 1, sep2 >= 0 ? sep2 : entry.length()).toInt() : -60;
+		net.channel = sep2 >= 0 ? entry.substring(sep2 + 1).toInt() : 1;
+		net.encryption = WIFI_AUTH_WPA2_PSK;
+		uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, (uint8_t)networks.size(), (uint8_t)net.channel};
+		memcpy(net.bssid, bssid, sizeof(bssid));
+		if (!net.ssid.isEmpty())
+			networks.push_back(net);
+	}
+	return networks;
+}
+
+const WiFiClass::Network *WiFiClass::findNetwork(const String &ssid, const uint8_t *bssid)
+{
+	if (outage())
+		return NULL;
+	for (const auto &net : environment())
+	{
+		if (net.ssid == ssid && (!bssid || memcmp(bssid, net.bssid, 6) == 0))
+			return &net;
+	}
+	return NULL;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+	_mode = mode;
+	if (mode == WIFI_MODE_NULL || mode == WIFI_MODE_STA)
+		_softAPActive = false;
+	return true;
+}
+
+/*******************************************************************************************************************************
+ * station
+ */
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel, const uint8_t *bssid, bool connect)
+{
+	if (_mode == WIFI_MODE_NULL || _mode == WIFI_MODE_AP)
+		_mode = (_mode == WIFI_MODE_AP) ? WIFI_MODE_APSTA : WIFI_MODE_STA;
+	_connected = false;
+	_ssid = ssid ? ssid : "";
+	_channel = channel;
+	if (bssid)
+		memcpy(_bssid, bssid, sizeof(_bssid));
+	else
+		memset(_bssid, 0, sizeof(_bssid));
+	_connectStarted = millis();
+	_status = connect ? WL_DISCONNECTED : WL_IDLE_STATUS;
+	return _status;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap)
+{
+	_connected = false;
+	_status = WL_DISCONNECTED;
+	if (wifioff)
+		_mode = WIFI_MODE_NULL;
+	return true;
+}
+
+bool WiFiClass::reconnect()
+{
+	if (_ssid.isEmpty())
+		return false;
+	begin(_ssid.c_str(), NULL, _channel, NULL);
+	return true;
+}
+
+void WiFiClass::updateStatus()
+{
+	if (_connected && outage())
+	{
+		_connected = false;
+		_status = WL_CONNECTION_LOST;
+		return;
+	}
+	if (_status != WL_DISCONNECTED || _connected)
+		return;
+
+	// association needs some time, connecting with known BSSID and channel skips the scan
+	bool direct = _channel && (_bssid[0] | _bssid[1] | _bssid[2] | _bssid[3] | _bssid[4] | _bssid[5]);
+	unsigned long connectTime = envMillis("SPARKMAKER_WIFI_CONNECT_MS", 500) / (direct ? 4 : 1);
+	if (millis() - _connectStarted < connectTime)
+		return;
+
+	const Network *net = findNetwork(_ssid, direct ? _bssid : NULL);
+	if (!net)
+	{
+		_status = WL_NO_SSID_AVAIL;
+		return;
+	}
+	memcpy(_bssid, net->bssid, sizeof(_bssid));
+	_channel = net->channel;
+	_connected = true;
+	_status = WL_CONNECTED;
+}
+
+wl_status_t WiFiClass::status()
+{
+	updateStatus();
+	return _status;
+}
+
+IPAddress WiFiClass::localIP()
+{
+	return status() == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+int32_t WiFiClass::RSSI()
+{
+	if (status() != WL_CONNECTED)
+		return 0;
+	const Network *net = findNetwork(_ssid, _bssid);
+	return net ? net->rssi : 0;
+}
+
+uint8_t *WiFiClass::BSSID()
+{
+	return status() == WL_CONNECTED ? _bssid : NULL;
+}
+
+String WiFiClass::BSSIDstr()
+{
+	char buf[18];
+	snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", _bssid[0], _bssid[1], _bssid[2], _bssid[3], _bssid[4], _bssid[5]);
+	return status() == WL_CONNECTED ? String(buf) : String();
+}
+
+int32_t WiFiClass::channel()
+{
+	return status() == WL_CONNECTED ? _channel : 0;
+}
+
+String WiFiClass::macAddress()
+{
+	uint64_t mac = ESP.getEfuseMac();
+	char buf[18];
+	snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+			 (unsigned)(mac & 0xFF), (unsigned)((mac >> 8) & 0xFF), (unsigned)((mac >> 16) & 0xFF),
+			 (unsigned)((mac >> 24) & 0xFF), (unsigned)((mac >> 32) & 0xFF), (unsigned)((mac >> 40) & 0xFF));
+	return String(buf);
+}
+
+/*******************************************************************************************************************************
+ * access point
+ */
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssid_hidden, int max_connection)
+{
+	if (_mode == WIFI_MODE_NULL || _mode == WIFI_MODE_STA)
+		_mode = (_mode == WIFI_MODE_STA) ? WIFI_MODE_APSTA : WIFI_MODE_AP;
+	_softAPActive = true;
+	return true;
+}
+
+bool WiFiClass::softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet)
+{
+	_softAPIP = local_ip;
+	return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifioff)
+{
+	_softAPActive = false;
+	return true;
+}
+
+/*******************************************************************************************************************************
+ * scan
+ */
+int16_t WiFiClass::scanNetworks(bool async, bool show_hidden, bool passive, uint32_t max_ms_per_chan)
+{
+	if (_scanRunning)
+		return WIFI_SCAN_RUNNING;
+	_scanResult.clear();
+	_scanRunning = true;
+	_scanStarted = millis();
+	if (async)
+		return WIFI_SCAN_RUNNING;
+
+	// synchronous scans block the caller, like on the ESP32
+	delay(SCAN_DURATION);
+	return scanComplete();
+}
+
+int16_t WiFiClass::scanComplete()
+{
+	if (_scanRunning)
+	{
+		if (millis() - _scanStarted < SCAN_DURATION)
+			return WIFI_SCAN_RUNNING;
+		_scanRunning = false;
+		if (outage())
+			_scanResult.clear();
+		else
+			_scanResult = environment();
+	}
+	return _scanResult.size();
+}
+
+void WiFiClass::scanDelete()
+{
+	_scanResult.clear();
+}
+
+String WiFiClass::SSID(uint8_t i)
+{
+	return i < _scanResult.size() ? _scanResult[i].ssid : String();
+}
+
+int32_t WiFiClass::RSSI(uint8_t i)
+{
+	return i < _scanResult.size() ? _scanResult[i].rssi : 0;
+}
+
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t i)
+{
+	return i < _scanResult.size() ? _scanResult[i].encryption : WIFI_AUTH_OPEN;
+}
+
+uint8_t *WiFiClass::BSSID(uint8_t i)
+{
+	return i < _scanResult.size() ? _scanResult[i].bssid : NULL;
+}
+
+String WiFiClass::BSSIDstr(uint8_t i)
+{
+	if (i >= _scanResult.size())
+		return String();
+	const uint8_t *b = _scanResult[i].bssid;
+	char buf[18];
+	snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", b[0], b[1], b[2], b[3], b[4], b[5]);
+	return String(buf);
+}
+
+int32_t WiFiClass::channel(uint8_t i)
+{
+	return i < _scanResult.size() ? _scanResult[i].channel : 0;
+}
@@ -0,0 +1,133 @@
+/*
+	Native HAL: simulated WiFi station / access point
+*/
+#ifndef _NATIVE_WIFI_h
+#define _NATIVE_WIFI_h
+
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+typedef enum
+{
+	WL_NO_SHIELD = 255,
+	WL_IDLE_STATUS = 0,
+	WL_NO_SSID_AVAIL = 1,
+	WL_SCAN_COMPLETED = 2,
+	WL_CONNECTED = 3,
+	WL_CONNECT_FAILED = 4,
+	WL_CONNECTION_LOST = 5,
+	WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+	WIFI_MODE_NULL = 0,
+	WIFI_MODE_STA,
+	WIFI_MODE_AP,
+	WIFI_MODE_APSTA,
+	WIFI_MODE_MAX
+} wifi_mode_t;
+
+typedef enum
+{
+	WIFI_AUTH_OPEN = 0,
+	WIFI_AUTH_WEP,
+	WIFI_AUTH_WPA_PSK,
+	WIFI_AUTH_WPA2_PSK,
+	WIFI_AUTH_WPA_WPA2_PSK,
+	WIFI_AUTH_WPA2_ENTERPRISE,
+	WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+/**
+ * WiFi interface with simulated radio environment
+ * visible networks are given by SPARKMAKER_WIFI="ssid:rssi:channel,..." (default "test:-40:6,neighbour:-72:11")
+ * the station connects to every visible network after SPARKMAKER_WIFI_CONNECT_MS (default 500) ms
+ * the local IP is 127.0.0.1, so the web interface answers on http://127.0.0.1:8080
+ */
+class WiFiClass
+{
+  public:
+	// mode
+	bool mode(wifi_mode_t mode);
+	wifi_mode_t getMode() const { return _mode; }
+	void persistent(bool persistent) {}
+	bool setAutoReconnect(bool autoReconnect) { return true; }
+	bool setHostname(const char *hostname) { _hostname = hostname; return true; }
+	const char *getHostname() const { return _hostname.c_str(); }
+
+	// station
+	wl_status_t begin(const char *ssid, const char *passphrase = NULL, int32_t channel = 0, const uint8_t *bssid = NULL, bool connect = true);
+	bool disconnect(bool wifioff = false, bool eraseap = false);
+	bool reconnect();
+	wl_status_t status();
+	bool isConnected() { return status() == WL_CONNECTED; }
+	IPAddress localIP();
+	String SSID() const { return _connected ? _ssid : String(); }
+	int32_t RSSI();
+	uint8_t *BSSID();
+	String BSSIDstr();
+	int32_t channel();
+	String macAddress();
+
+	// access point
+	bool softAP(const char *ssid, const char *passphrase = NULL, int channel = 1, int ssid_hidden = 0, int max_connection = 4);
+	bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet);
+	bool softAPdisconnect(bool wifioff = false);
+	IPAddress softAPIP() const { return _softAPActive ? _softAPIP : IPAddress(); }
+	uint8_t softAPgetStationNum() const { return 0; }
+
+	// scan
+	int16_t scanNetworks(bool async = false, bool show_hidden = false, bool passive = false, uint32_t max_ms_per_chan = 300);
+	int16_t scanComplete();
+	void scanDelete();
+	String SSID(uint8_t i);
+	int32_t RSSI(uint8_t i);
+	wifi_auth_mode_t encryptionType(uint8_t i);
+	uint8_t *BSSID(uint8_t i);
+	String BSSIDstr(uint8_t i);
+	int32_t channel(uint8_t i);
+
+  private:
+	struct Network
+	{
+		String ssid;
+		int32_t rssi;
+		int32_t channel;
+		uint8_t bssid[6];
+		wifi_auth_mode_t encryption;
+	};
+	const std::vector<Network> &environment();
+	const Network *findNetwork(const String &ssid, const uint8_t *bssid = NULL);
+	void updateStatus();
+
+	wifi_mode_t _mode = WIFI_MODE_NULL;
+	String _hostname;
+
+	// station
+	wl_status_t _status = WL_IDLE_STATUS;
+	bool _connected = false;
+	String _ssid;
+	uint8_t _bssid[6] = {};
+	int32_t _channel = 0;
+	unsigned long _connectStarted = 0;
+
+	// access point
+	bool _softAPActive = false;
+	IPAddress _softAPIP = IPAddress(192, 168, 4, 1);
+
+	// scan
+	std::vector<Network> _scanResult;
+	bool _scanRunning = false;
+	unsigned long _scanStarted = 0;
+};
+
+extern WiFiClass WiFi;
+
+#endif // _NATIVE_WIFI_h
@@ -0,0 +1,177 @@
+/*
+	Native HAL: TCP client over POSIX sockets
+*/
+#include "WiFiClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+// maximum time a blocking write waits for the peer [ms]
+static const int WIFICLIENT_WRITE_TIMEOUT = 5000;
+
+struct WiFiClient::Socket
+{
+	int fd;
+	explicit Socket(int fd) : fd(fd) {}
+	~Socket() { close(); }
+	void close()
+	{
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+	}
+};
+
+WiFiClient::WiFiClient(int fd)
+{
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	_socket = std::make_shared<Socket>(fd);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+	stop();
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return 0;
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = (uint32_t)ip;
+	if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		::close(fd);
+		return 0;
+	}
+	*this = WiFiClient(fd);
+	return 1;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+	addrinfo hints = {}, *result = nullptr;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, nullptr, &hints, &result) || !result)
+		return 0;
+	IPAddress ip((uint32_t)((sockaddr_in *)result->ai_addr)->sin_addr.s_addr);
+	freeaddrinfo(result);
+	return connect(ip, port);
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size)
+{
+	int fd = this->fd();
+	size_t sent = 0;
+	while (fd >= 0 && sent < size)
+	{
+		ssize_t n = send(fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+		if (n > 0)
+		{
+			sent += n;
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// socket buffer full, wait for the peer like lwIP does
+			pollfd pfd = {fd, POLLOUT, 0};
+			if (poll(&pfd, 1, WIFICLIENT_WRITE_TIMEOUT) > 0)
+				continue;
+		}
+		stop();
+		break;
+	}
+	return sent;
+}
+
+int WiFiClient::available()
+{
+	int count = 0;
+	if (fd() < 0 || ioctl(fd(), FIONREAD, &count) < 0)
+		return 0;
+	return count;
+}
+
+int WiFiClient::read()
+{
+	uint8_t c;
+	return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size)
+{
+	if (fd() < 0)
+		return -1;
+	ssize_t n = recv(fd(), buffer, size, 0);
+	if (n == 0)
+	{
+		// orderly shutdown by peer
+		stop();
+		return -1;
+	}
+	return n < 0 ? -1 : (int)n;
+}
+
+int WiFiClient::peek()
+{
+	uint8_t c;
+	if (fd() < 0 || recv(fd(), &c, 1, MSG_PEEK) != 1)
+		return -1;
+	return c;
+}
+
+void WiFiClient::stop()
+{
+	if (_socket)
+		_socket->close();
+	_socket.reset();
+}
+
+uint8_t WiFiClient::connected()
+{
+	if (fd() < 0)
+		return 0;
+	uint8_t c;
+	ssize_t n = recv(fd(), &c, 1, MSG_PEEK);
+	if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+		return 1;
+	// peer closed or socket error
+	return 0;
+}
+
+int WiFiClient::setNoDelay(bool nodelay)
+{
+	int flag = nodelay;
+	return fd() >= 0 ? setsockopt(fd(), IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) : -1;
+}
+
+IPAddress WiFiClient::remoteIP() const
+{
+	sockaddr_in addr = {};
+	socklen_t len = sizeof(addr);
+	if (fd() < 0 || getpeername(fd(), (sockaddr *)&addr, &len) < 0)
+		return IPAddress();
+	return IPAddress((uint32_t)addr.sin_addr.s_addr);
+}
+
+uint16_t WiFiClient::remotePort() const
+{
+	sockaddr_in addr = {};
+	socklen_t len = sizeof(addr);
+	if (fd() < 0 || getpeername(fd(), (sockaddr *)&addr, &len) < 0)
+		return 0;
+	return ntohs(addr.sin_port);
+}
+
+int WiFiClient::fd() const
+{
+	return _socket ? _socket->fd : -1;
+}
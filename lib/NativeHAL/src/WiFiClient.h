@@ -0,0 +1,49 @@
+/*
+	Native HAL: TCP client over POSIX sockets
+*/
+#ifndef _NATIVE_WIFICLIENT_h
+#define _NATIVE_WIFICLIENT_h
+
+#include <memory>
+
+#include "Arduino.h"
+
+/**
+ * TCP connection, shared between copies like the ESP32 WiFiClient
+ * the socket is closed by stop() or when the last copy is destroyed
+ */
+class WiFiClient : public Stream
+{
+  public:
+	WiFiClient() {}
+	explicit WiFiClient(int fd);
+
+	int connect(IPAddress ip, uint16_t port);
+	int connect(const char *host, uint16_t port);
+
+	using Print::write;
+	size_t write(uint8_t c) override { return write(&c, 1); }
+	size_t write(const uint8_t *buffer, size_t size) override;
+	int available() override;
+	int read() override;
+	int read(uint8_t *buffer, size_t size);
+	int peek() override;
+	void flush() override {}
+
+	void stop();
+	uint8_t connected();
+	explicit operator bool() { return connected(); }
+	bool operator==(const WiFiClient &rhs) const { return _socket == rhs._socket; }
+	bool operator!=(const WiFiClient &rhs) const { return _socket != rhs._socket; }
+
+	int setNoDelay(bool nodelay);
+	IPAddress remoteIP() const;
+	uint16_t remotePort() const;
+	int fd() const;
+
+  private:
+	struct Socket;
+	std::shared_ptr<Socket> _socket;
+};
+
+#endif // _NATIVE_WIFICLIENT_h
@@ -0,0 +1,82 @@
+/*
+	Native HAL: TCP server over POSIX sockets
+*/
+#include "WiFiServer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+uint16_t WiFiServer::hostPort(uint16_t port)
+{
+	if (port >= 1024 || geteuid() == 0)
+		return port;
+	const char *offset = getenv("SPARKMAKER_PORT_OFFSET");
+	return port + (offset ? atoi(offset) : 8000);
+}
+
+void WiFiServer::begin(uint16_t port)
+{
+	if (port)
+		_port = port;
+	end();
+
+	_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (_fd < 0)
+		return;
+	int reuse = 1;
+	setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(hostPort(_port));
+	addr.sin_addr.s_addr = INADDR_ANY;
+	if (bind(_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(_fd, 8) < 0)
+	{
+		Serial.printf("WiFiServer: cannot listen on port %u\n", hostPort(_port));
+		end();
+		return;
+	}
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+	Serial.printf("WiFiServer: port %u listening on %u\n", _port, hostPort(_port));
+}
+
+void WiFiServer::end()
+{
+	if (_fd >= 0)
+		::close(_fd);
+	_fd = -1;
+}
+
+WiFiClient WiFiServer::available()
+{
+	if (_fd < 0)
+		return WiFiClient();
+	int fd = ::accept(_fd, nullptr, nullptr);
+	if (fd < 0)
+		return WiFiClient();
+	// send buffer of lwIP on the ESP32 (TCP_SND_BUF), so responses larger than the socket takes show up like on the device
+	static int sendBuffer = -1;
+	if (sendBuffer < 0)
+	{
+		const char *env = getenv("SPARKMAKER_TCP_SNDBUF");
+		sendBuffer = env ? atoi(env) : 5744;
+	}
+	if (sendBuffer > 0)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+	WiFiClient client(fd);
+	if (_noDelay)
+		client.setNoDelay(true);
+	return client;
+}
+
+bool WiFiServer::hasClient()
+{
+	if (_fd < 0)
+		return false;
+	pollfd pfd = {_fd, POLLIN, 0};
+	return poll(&pfd, 1, 0) > 0;
+}
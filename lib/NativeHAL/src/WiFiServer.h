@@ -0,0 +1,37 @@
+/*
+	Native HAL: TCP server over POSIX sockets
+*/
+#ifndef _NATIVE_WIFISERVER_h
+#define _NATIVE_WIFISERVER_h
+
+#include "WiFiClient.h"
+
+/**
+ * listening TCP socket
+ * privileged ports (< 1024) are moved up by SPARKMAKER_PORT_OFFSET (default 8000), e.g. HTTP runs on 8080
+ */
+class WiFiServer
+{
+  public:
+	explicit WiFiServer(uint16_t port = 80) : _port(port) {}
+	~WiFiServer() { end(); }
+
+	void begin(uint16_t port = 0);
+	void end();
+	void close() { end(); }
+	WiFiClient available();
+	WiFiClient accept() { return available(); }
+	bool hasClient();
+	void setNoDelay(bool nodelay) { _noDelay = nodelay; }
+	explicit operator bool() const { return _fd >= 0; }
+
+	uint16_t port() const { return _port; }
+	static uint16_t hostPort(uint16_t port);
+
+  private:
+	uint16_t _port;
+	int _fd = -1;
+	bool _noDelay = false;
+};
+
+#endif // _NATIVE_WIFISERVER_h
@@ -0,0 +1,109 @@
+/*
+	Native HAL: UDP over POSIX sockets
+*/
+#include "WiFiUdp.h"
+#include "WiFiServer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static const size_t MAX_DATAGRAM = 1500;
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+	stop();
+	_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (_fd < 0)
+		return 0;
+	int on = 1;
+	setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(WiFiServer::hostPort(port));
+	addr.sin_addr.s_addr = INADDR_ANY;
+	if (bind(_fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		Serial.printf("WiFiUDP: cannot bind port %u\n", WiFiServer::hostPort(port));
+		stop();
+		return 0;
+	}
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+	Serial.printf("WiFiUDP: port %u listening on %u\n", port, WiFiServer::hostPort(port));
+	return 1;
+}
+
+void WiFiUDP::stop()
+{
+	if (_fd >= 0)
+		::close(_fd);
+	_fd = -1;
+	flush();
+}
+
+int WiFiUDP::parsePacket()
+{
+	flush();
+	if (_fd < 0)
+		return 0;
+	_rx.resize(MAX_DATAGRAM);
+	sockaddr_in addr = {};
+	socklen_t len = sizeof(addr);
+	ssize_t size = recvfrom(_fd, _rx.data(), _rx.size(), 0, (sockaddr *)&addr, &len);
+	if (size <= 0)
+	{
+		_rx.clear();
+		return 0;
+	}
+	_rx.resize(size);
+	_remoteIP = IPAddress((uint32_t)addr.sin_addr.s_addr);
+	_remotePort = ntohs(addr.sin_port);
+	return (int)size;
+}
+
+int WiFiUDP::read()
+{
+	if (_rxPos >= _rx.size())
+		return -1;
+	return _rx[_rxPos++];
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t len)
+{
+	size_t n = _rx.size() - _rxPos;
+	if (n > len)
+		n = len;
+	memcpy(buffer, _rx.data() + _rxPos, n);
+	_rxPos += n;
+	return (int)n;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+	_tx.clear();
+	_txIP = ip;
+	_txPort = port;
+	return _fd >= 0;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
+{
+	_tx.insert(_tx.end(), buffer, buffer + size);
+	return size;
+}
+
+int WiFiUDP::endPacket()
+{
+	if (_fd < 0)
+		return 0;
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(_txPort);
+	addr.sin_addr.s_addr = (uint32_t)_txIP;
+	ssize_t sent = sendto(_fd, _tx.data(), _tx.size(), 0, (sockaddr *)&addr, sizeof(addr));
+	_tx.clear();
+	return sent >= 0;
+}
@@ -0,0 +1,50 @@
+/*
+	Native HAL: UDP over POSIX sockets
+*/
+#ifndef _NATIVE_WIFIUDP_h
+#define _NATIVE_WIFIUDP_h
+
+#include <vector>
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+/**
+ * non-blocking UDP socket, one received packet at a time
+ * privileged ports are moved like WiFiServer ports, e.g. DNS runs on 8053
+ */
+class WiFiUDP
+{
+  public:
+	WiFiUDP() {}
+	~WiFiUDP() { stop(); }
+
+	uint8_t begin(uint16_t port);
+	void stop();
+
+	int parsePacket();
+	int available() const { return (int)(_rx.size() - _rxPos); }
+	int read();
+	int read(uint8_t *buffer, size_t len);
+	int read(char *buffer, size_t len) { return read((uint8_t *)buffer, len); }
+	void flush() { _rx.clear(); _rxPos = 0; }
+	IPAddress remoteIP() const { return _remoteIP; }
+	uint16_t remotePort() const { return _remotePort; }
+
+	int beginPacket(IPAddress ip, uint16_t port);
+	size_t write(uint8_t c) { return write(&c, 1); }
+	size_t write(const uint8_t *buffer, size_t size);
+	int endPacket();
+
+  private:
+	int _fd = -1;
+	std::vector<uint8_t> _rx;
+	size_t _rxPos = 0;
+	IPAddress _remoteIP;
+	uint16_t _remotePort = 0;
+	std::vector<uint8_t> _tx;
+	IPAddress _txIP;
+	uint16_t _txPort = 0;
+};
+
+#endif // _NATIVE_WIFIUDP_h
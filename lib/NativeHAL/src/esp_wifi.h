@@ -0,0 +1,7 @@
+/*
+	Native HAL: ESP-IDF WiFi driver header, the host has nothing to offer here
+*/
+#ifndef _NATIVE_ESP_WIFI_h
+#define _NATIVE_ESP_WIFI_h
+
+#endif // _NATIVE_ESP_WIFI_h
@@ -0,0 +1,199 @@
+/*
+	Static Asset Index
+*/
+#include "AssetIndex.h"
+#include <time.h>
+
+void AssetIndex::addEmbedded(const EmbeddedAsset *embedded, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		Asset asset;
+		asset.uri = embedded[i].uri;
+		asset.uriHash = hash(asset.uri.c_str(), asset.uri.length());
+		asset.contentType = embedded[i].contentType;
+		asset.size = embedded[i].size;
+		asset.etag = embedded[i].etag;
+		asset.compressed = embedded[i].compressed;
+		asset.immutable = embedded[i].immutable;
+		asset.data = embedded[i].data;
+		assets.push_back(asset);
+	}
+}
+
+void AssetIndex::build(fs::FS &fs, const char *folder)
+{
+	scan(fs, folder, folder);
+}
+
+/**
+ * add files of folder, SPIFFS lists all files below the folder, other file systems return sub folders
+ */
+void AssetIndex::scan(fs::FS &fs, const String &root, const String &folder)
+{
+	fs::File dir = fs.open(folder, "r");
+	if (!dir || !dir.isDirectory())
+		return;
+
+	for (fs::File file = dir.openNextFile(); file; file = dir.openNextFile())
+	{
+		// some file systems return names relative to the folder
+		String path = file.name();
+		if (!path.startsWith("/"))
+			path = folder + "/" + path;
+		if (file.isDirectory())
+		{
+			scan(fs, root, path);
+			continue;
+		}
+		if (!path.startsWith(root + "/"))
+			continue;
+
+		String uri = path.substring(root.length());
+		add(file, path, uri, false);
+		if (uri.endsWith(".gz"))
+			add(file, path, uri.substring(0, uri.length() - 3), true);
+	}
+}
+
+const AssetIndex::Asset *AssetIndex::find(const String &uri) const
+{
+	String path = uri.endsWith("/") ? uri + "index.html" : uri;
+	uint32_t uriHash = hash(path.c_str(), path.length());
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		if (assets[i].uriHash == uriHash && assets[i].uri == path)
+			return &assets[i];
+	}
+	return NULL;
+}
+
+/**
+ * add file to index, a compressed variant replaces the uncompressed file
+ */
+void AssetIndex::add(fs::File &file, const String &path, const String &uri, bool compressed)
+{
+	uint32_t uriHash = hash(uri.c_str(), uri.length());
+	Asset *asset = NULL;
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		if (assets[i].uriHash == uriHash && assets[i].uri == uri)
+			asset = &assets[i];
+	}
+	if (asset)
+	{
+		// keep embedded content and compressed variant
+		if (asset->data || !compressed)
+			return;
+	}
+	else
+	{
+		assets.push_back(Asset());
+		asset = &assets.back();
+	}
+
+	// content hash, reuse hash of the file if it is already indexed under its own name
+	String etag;
+	for (size_t i = 0; i < assets.size() && etag.isEmpty(); i++)
+	{
+		if (assets[i].path == path)
+			etag = assets[i].etag;
+	}
+	if (etag.isEmpty())
+	{
+		uint32_t contentHash = 2166136261UL;
+		char buffer[512];
+		size_t n;
+		file.seek(0);
+		while ((n = file.read((uint8_t *)buffer, sizeof(buffer))) > 0)
+			contentHash = hash(buffer, n, contentHash);
+		etag = "\"" + String(file.size(), HEX) + "-" + String(contentHash, HEX) + "\"";
+	}
+
+	asset->uriHash = uriHash;
+	asset->uri = uri;
+	asset->path = path;
+	asset->contentType = getContentType(uri);
+	asset->size = file.size();
+	asset->etag = etag;
+	asset->lastModified = httpDate(file.getLastWrite());
+	asset->compressed = path.endsWith(".gz");
+	asset->immutable = isHashedName(uri);
+	asset->data = NULL;
+}
+
+/**
+ * test for content hash in file name: <name>.<6-8 hex digits>.<ext>
+ */
+bool AssetIndex::isHashedName(const String &uri)
+{
+	int ext = uri.lastIndexOf('.');
+	int start = ext > 0 ? uri.lastIndexOf('.', ext - 1) : -1;
+	if (start < 0 || ext - start < 7 || ext - start > 9 || uri.lastIndexOf('/') > start)
+		return false;
+	for (int i = start + 1; i < ext; i++)
+	{
+		if (!isxdigit(uri[i]))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * get MIME type from filename
+ */
+const char *AssetIndex::getContentType(const String &filename)
+{
+	if (filename.endsWith(".htm"))
+		return "text/html";
+	if (filename.endsWith(".html"))
+		return "text/html";
+	if (filename.endsWith(".css"))
+		return "text/css";
+	if (filename.endsWith(".js"))
+		return "application/javascript";
+	if (filename.endsWith(".png"))
+		return "image/png";
+	if (filename.endsWith(".gif"))
+		return "image/gif";
+	if (filename.endsWith(".jpg"))
+		return "image/jpeg";
+	if (filename.endsWith(".ico"))
+		return "image/x-icon";
+	if (filename.endsWith(".xml"))
+		return "text/xml";
+	if (filename.endsWith(".pdf"))
+		return "application/x-pdf";
+	if (filename.endsWith(".zip"))
+		return "application/x-zip";
+	if (filename.endsWith(".gz"))
+		return "application/x-gzip";
+	return "text/plain";
+}
+
+/**
+ * FNV-1a hash
+ */
+uint32_t AssetIndex::hash(const char *data, size_t length, uint32_t hash)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 16777619UL;
+	}
+	return hash;
+}
+
+/**
+ * format time stamp as HTTP date, empty if the time stamp is not set
+ */
+String AssetIndex::httpDate(time_t time)
+{
+	if (time < 946684800L) // 2000-01-01
+		return String();
+	struct tm tm;
+	gmtime_r(&time, &tm);
+	char buffer[32];
+	strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	return String(buffer);
+}
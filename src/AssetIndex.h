@@ -0,0 +1,77 @@
+/*
+	Static Asset Index
+*/
+#ifndef _ASSETINDEX_h
+#define _ASSETINDEX_h
+
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+
+/**
+ * index of the static web files, built once at boot
+ * maps request URIs to the file to send with MIME type, size and validators for conditional requests
+ */
+class AssetIndex
+{
+  public:
+	typedef struct
+	{
+		uint32_t uriHash;
+		String uri;				 // request path, e.g. /js/vue.js
+		String path;			 // file to send, the compressed variant if available
+		const char *contentType; // MIME type of the uncompressed file
+		size_t size;
+		String etag;		 // quoted content hash
+		String lastModified; // HTTP date, empty if the file system has no time stamps
+		bool compressed;	 // gzip content encoding
+		bool immutable;		 // content hash in file name, e.g. style.0123ab.css
+		const uint8_t *data; // content compiled into the firmware, NULL for files
+	} Asset;
+
+	/**
+	 * asset compiled into the firmware (PROGMEM), generated by tools/web_assets.py
+	 */
+	typedef struct
+	{
+		const char *uri;
+		const char *contentType;
+		const char *etag;
+		bool compressed;
+		bool immutable;
+		const uint8_t *data;
+		size_t size;
+	} EmbeddedAsset;
+
+	/**
+	 * add assets compiled into the firmware, they take precedence over files
+	 */
+	void addEmbedded(const EmbeddedAsset *embedded, size_t count);
+
+	/**
+	 * walk folder and index all files, <file>.gz is served for <file>
+	 */
+	void build(fs::FS &fs, const char *folder);
+
+	/**
+	 * find asset for request URI, "/" is mapped to "/index.html"
+	 * @return NULL if not found
+	 */
+	const Asset *find(const String &uri) const;
+
+	size_t count() const { return assets.size(); }
+
+	static const char *getContentType(const String &filename);
+
+  private:
+	void scan(fs::FS &fs, const String &root, const String &folder);
+	void add(fs::File &file, const String &path, const String &uri, bool compressed);
+
+	static bool isHashedName(const String &uri);
+	static uint32_t hash(const char *data, size_t length, uint32_t hash = 2166136261UL);
+	static String httpDate(time_t time);
+
+	std::vector<Asset> assets;
+};
+
+#endif // _ASSETINDEX_h
@@ -0,0 +1,84 @@
+/*
+	Boot Timeline
+*/
+#include "BootProfiler.h"
+
+BootProfiler::Phase BootProfiler::phases[MAX_PHASES];
+uint8_t BootProfiler::phaseCount = 0;
+bool BootProfiler::phaseRunning = false;
+BootProfiler::Event BootProfiler::events[MAX_EVENTS];
+uint8_t BootProfiler::eventCount = 0;
+uint32_t BootProfiler::setupTime = 0;
+
+void BootProfiler::phase(const char *name)
+{
+	endPhase();
+	if (phaseCount >= MAX_PHASES)
+		return;
+	phases[phaseCount].name = name;
+	phases[phaseCount].start = micros();
+	phases[phaseCount].duration = 0;
+	phaseRunning = true;
+}
+
+void BootProfiler::endPhase()
+{
+	if (!phaseRunning)
+		return;
+	Phase &p = phases[phaseCount++];
+	p.duration = micros() - p.start;
+	phaseRunning = false;
+
+	Serial.print("boot: ");
+	Serial.print(p.name);
+	Serial.print(" ");
+	Serial.print(p.duration / 1000.0, 1);
+	Serial.println(" ms");
+}
+
+void BootProfiler::done()
+{
+	endPhase();
+	setupTime = millis();
+	event("setup done");
+}
+
+void BootProfiler::event(const char *name)
+{
+	if (eventCount >= MAX_EVENTS)
+		return;
+	for (uint8_t i = 0; i < eventCount; i++)
+	{
+		if (!strcmp(events[i].name, name))
+			return;
+	}
+	events[eventCount].name = name;
+	events[eventCount].time = millis();
+	eventCount++;
+
+	Serial.print("boot: ");
+	Serial.print(name);
+	Serial.print(" after ");
+	Serial.print(millis());
+	Serial.println(" ms");
+}
+
+void BootProfiler::toJson(JsonDocument &json)
+{
+	json["setup"] = setupTime;
+	JsonArray list = json.createNestedArray("phases");
+	for (uint8_t i = 0; i < phaseCount; i++)
+	{
+		JsonObject p = list.createNestedObject();
+		p["name"] = phases[i].name;
+		p["start"] = phases[i].start / 1000.0;
+		p["duration"] = phases[i].duration / 1000.0;
+	}
+	list = json.createNestedArray("events");
+	for (uint8_t i = 0; i < eventCount; i++)
+	{
+		JsonObject e = list.createNestedObject();
+		e["name"] = events[i].name;
+		e["time"] = events[i].time;
+	}
+}
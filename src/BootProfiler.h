@@ -0,0 +1,70 @@
+/*
+	Boot Timeline
+*/
+#ifndef _BOOTPROFILER_h
+#define _BOOTPROFILER_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * records the duration of the setup phases and the time when links came up
+ * phases are sequential, phase() ends the previous one
+ * events are asynchronous milestones, only the first occurrence of each name is kept
+ */
+class BootProfiler
+{
+  public:
+	static const uint8_t MAX_PHASES = 16;
+	static const uint8_t MAX_EVENTS = 12;
+
+	/**
+	 * start phase, names must be string literals
+	 */
+	static void phase(const char *name);
+
+	/**
+	 * end of setup()
+	 */
+	static void done();
+
+	/**
+	 * record milestone, e.g. "wifi connected"
+	 */
+	static void event(const char *name);
+
+	/**
+	 * time from power-up to end of setup() [ms]
+	 */
+	static uint32_t getSetupTime() { return setupTime; }
+
+	/**
+	 * add timeline to JSON document
+	 */
+	static void toJson(JsonDocument &json);
+
+  private:
+	typedef struct
+	{
+		const char *name;
+		uint32_t start; // [us]
+		uint32_t duration;
+	} Phase;
+
+	typedef struct
+	{
+		const char *name;
+		uint32_t time; // [ms]
+	} Event;
+
+	static void endPhase();
+
+	static Phase phases[MAX_PHASES];
+	static uint8_t phaseCount;
+	static bool phaseRunning;
+	static Event events[MAX_EVENTS];
+	static uint8_t eventCount;
+	static uint32_t setupTime;
+};
+
+#endif // _BOOTPROFILER_h
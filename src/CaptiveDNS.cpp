@@ -0,0 +1,103 @@
+/*
+	Captive Portal DNS Server
+*/
+#include "CaptiveDNS.h"
+#include "Metrics.h"
+
+static const size_t DNS_HEADER_SIZE = 12;
+static const uint16_t DNS_TYPE_A = 1;
+static const uint16_t DNS_CLASS_IN = 1;
+
+static Counter dnsQueries("sparkmaker_dns_queries_total", "DNS queries received by the captive portal");
+static Counter dnsDropped("sparkmaker_dns_dropped_total", "DNS packets dropped as malformed or unsupported");
+
+bool CaptiveDNS::start(uint16_t port, const IPAddress &address, uint32_t timeToLive)
+{
+	ip = address;
+	ttl = timeToLive;
+	running = udp.begin(port);
+	return running;
+}
+
+void CaptiveDNS::stop()
+{
+	udp.stop();
+	running = false;
+}
+
+void CaptiveDNS::processNextRequest()
+{
+	if (!running)
+		return;
+	for (uint8_t i = 0; i < MAX_REQUESTS_PER_LOOP && handleRequest(); i++)
+		;
+}
+
+/**
+ * @return false if no request was pending
+ */
+bool CaptiveDNS::handleRequest()
+{
+	int size = udp.parsePacket();
+	if (size <= 0)
+		return false;
+	dnsQueries.inc();
+	if (size < (int)DNS_HEADER_SIZE || size > MAX_PACKET_SIZE)
+	{
+		udp.flush();
+		dnsDropped.inc();
+		return true;
+	}
+	udp.read(buffer, size);
+
+	// standard query with one question
+	uint16_t questions = buffer[4] << 8 | buffer[5];
+	if ((buffer[2] & 0x80) || (buffer[2] & 0x78) || questions != 1)
+	{
+		dnsDropped.inc();
+		return true;
+	}
+
+	// question: name labels, type, class
+	size_t pos = DNS_HEADER_SIZE;
+	while (pos < (size_t)size && buffer[pos])
+	{
+		if (buffer[pos] & 0xc0)
+		{
+			dnsDropped.inc(); // compressed names are not expected in a question
+			return true;
+		}
+		pos += buffer[pos] + 1;
+	}
+	if (pos + 5 > (size_t)size)
+	{
+		dnsDropped.inc();
+		return true;
+	}
+	uint16_t type = buffer[pos + 1] << 8 | buffer[pos + 2];
+	uint16_t cls = buffer[pos + 3] << 8 | buffer[pos + 4];
+	size_t length = pos + 5; // additional records (EDNS) are not answered
+
+	// response header: authoritative answer, recursion desired copied, no error
+	bool answer = type == DNS_TYPE_A && (cls & 0x7fff) == DNS_CLASS_IN && length + 16 <= MAX_PACKET_SIZE;
+	buffer[2] = 0x84 | (buffer[2] & 0x01);
+	buffer[3] = 0;
+	buffer[6] = 0;
+	buffer[7] = answer ? 1 : 0;
+	memset(buffer + 8, 0, 4);
+	if (answer)
+	{
+		const uint8_t record[] = {
+			0xc0, DNS_HEADER_SIZE, // name: pointer to question
+			0, DNS_TYPE_A, 0, DNS_CLASS_IN,
+			(uint8_t)(ttl >> 24), (uint8_t)(ttl >> 16), (uint8_t)(ttl >> 8), (uint8_t)ttl,
+			0, 4, ip[0], ip[1], ip[2], ip[3]};
+		memcpy(buffer + length, record, sizeof(record));
+		length += sizeof(record);
+	}
+
+	udp.beginPacket(udp.remoteIP(), udp.remotePort());
+	udp.write(buffer, length);
+	udp.endPacket();
+	return true;
+}
@@ -0,0 +1,38 @@
+/*
+	Captive Portal DNS Server
+*/
+#ifndef _CAPTIVEDNS_h
+#define _CAPTIVEDNS_h
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+/**
+ * answers every A query with the address of the access point, other queries without answer
+ * replaces DNSServer, which gives no insight into the queries it handled
+ */
+class CaptiveDNS
+{
+  public:
+	static const uint16_t MAX_PACKET_SIZE = 512;
+	static const uint8_t MAX_REQUESTS_PER_LOOP = 4;
+
+	bool start(uint16_t port, const IPAddress &ip, uint32_t ttl = 60);
+	void stop();
+
+	/**
+	 * answer pending queries
+	 */
+	void processNextRequest();
+
+  private:
+	bool handleRequest();
+
+	WiFiUDP udp;
+	IPAddress ip;
+	uint32_t ttl = 60;
+	bool running = false;
+	uint8_t buffer[MAX_PACKET_SIZE];
+};
+
+#endif // _CAPTIVEDNS_h
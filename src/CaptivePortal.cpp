@@ -7,41 +7,92 @@ extern "C"
 {
 #include "user_interface.h"
 }
-static inline uint32_t ESP_getChipId() { return ESP.getChipId(); }
 #else //ESP32
 #include <esp_wifi.h>
-static inline uint32_t ESP_getChipId() { return (uint32_t)ESP.getEfuseMac(); }
 #endif
 
 
 // DNS _httpServer
 static const byte DNS_PORT = 53;
-DNSServer _dnsServer;
+static CaptiveDNS _dnsServer;
 static bool _dnsServerActive = false;
 
 // Web
 static const byte HTTP_PORT = 80;
-WebServer _httpServer(HTTP_PORT);
+HttpServerBackend _httpServer(HTTP_PORT);
+
+// static files
+static const char *PUBLIC_FOLDER = "/public";
+static AssetIndex _assets;
+#ifdef EMBED_WEB_ASSETS
+#include "WebAssets.h" // generated by tools/web_assets.py
+#endif
 
 // JSON
 DynamicJsonDocument config(configJsonSize);
 DynamicJsonDocument tempJson(tempJsonSize);
+static ConfigStore _configStore(config);
 
-// Captive Portal defaults
-const static struct
-{
-	uint16_t wifiClientConnectionTimeout = 5;
-	uint16_t portalTimeout = 300;
-	uint8_t softAP_IP[4] = {192, 168, 4, 1};
-	uint8_t subnet[4] = {255, 255, 255, 0};
-	String hostname = "ESP-" + String(ESP_getChipId());
-	String portalPath = "portal.html";
-} defaultConfig;
 // parameters
 static bool _portalActive = false;
-static uint16_t _portalTimeout;
 static uint16_t _portalStarted;
-static uint16_t _wifiClientConnectionTimeout;
+static bool _portalRestart = false; // AP settings changed
+static unsigned long _pollTime = 0;	// end of the last HTTP poll [us]
+
+// WiFi client
+static WifiScanner _wifiScanner;
+static WifiConnector _wifiConnector(_wifiScanner);
+
+// metrics
+static const uint32_t REQUEST_DURATION_BOUNDS[] = {1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000}; // [us]
+static int32_t readRSSI() { return WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0; }
+static Gauge wifiRSSI("sparkmaker_wifi_rssi_dbm", "signal strength of the WiFi client connection, 0 if not connected", readRSSI);
+
+static const uint32_t RESPONSE_HEAP_BOUNDS[] = {256, 512, 1024, 2048, 4096, 8192, 16384, 32768}; // [bytes]
+static Histogram responseHeap("sparkmaker_http_response_heap_bytes", "peak heap used to build and send a response",
+							  RESPONSE_HEAP_BOUNDS, sizeof(RESPONSE_HEAP_BOUNDS) / sizeof(RESPONSE_HEAP_BOUNDS[0]));
+
+// lowest free heap seen while the current request is handled
+static uint32_t _heapMin = 0;
+
+/**
+ * sample free heap while a response is built and sent
+ */
+static void heapSample()
+{
+	uint32_t heap = ESP.getFreeHeap();
+	if (heap < _heapMin)
+		_heapMin = heap;
+}
+
+/**
+ * wrap handler to count requests and measure the handler time per route and the peak heap used
+ * URIs of the same route template, e.g. /printers/{id}/status, and of several methods share one histogram
+ */
+static HttpServerBackend::THandlerFunction measured(const String &route, HttpServerBackend::THandlerFunction handler)
+{
+	static std::vector<Histogram *> routes;
+	String labels = "route=\"" + route + "\"";
+	Histogram *duration = NULL;
+	for (size_t i = 0; i < routes.size() && !duration; i++)
+		if (routes[i]->getLabels() == labels)
+			duration = routes[i];
+	if (!duration)
+	{
+		duration = new Histogram("sparkmaker_http_request_duration_seconds", "time spent in the HTTP request handler per route",
+								 REQUEST_DURATION_BOUNDS, sizeof(REQUEST_DURATION_BOUNDS) / sizeof(REQUEST_DURATION_BOUNDS[0]), 1e-6, labels);
+		routes.push_back(duration);
+	}
+	return [handler, duration]() {
+		unsigned long start = micros();
+		uint32_t heapStart = ESP.getFreeHeap();
+		_heapMin = heapStart;
+		handler();
+		heapSample();
+		duration->observe(micros() - start);
+		responseHeap.observe(heapStart - _heapMin);
+	};
+}
 
 /**
  * sanity check for strings
@@ -56,34 +107,68 @@ String sanity(const String _str)
 	return str;
 }
 
+/**
+ * writes output as HTTP chunks straight to the client
+ * only a small buffer collects the single characters written by the serializer
+ */
+class ChunkedPrint : public Print
+{
+  public:
+	ChunkedPrint() : length(0) {}
+
+	size_t write(uint8_t c)
+	{
+		if (length == sizeof(buffer))
+			flush();
+		buffer[length++] = c;
+		return 1;
+	}
+	size_t write(const uint8_t *data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			write(data[i]);
+		return size;
+	}
+	void flush()
+	{
+		if (!length)
+			return;
+		heapSample();
+		_httpServer.sendContent((const char *)buffer, length);
+		length = 0;
+	}
+
+  private:
+	uint8_t buffer[256];
+	size_t length;
+};
+
 /**
  * start captive portal AP
  */
 void startCaptivePortal()
 {
-	Serial.print("Start WiFi AP: " + config["hostname"].as<String>() + " ... ");
+	Serial.print("Start WiFi AP: " + settings.hostname + " ... ");
 	WiFi.softAPdisconnect(true);
 
-	IPAddress softAP_IP(defaultConfig.softAP_IP);
-	if (config["CaptivePortal"]["ip"].is<const char *>())
-		softAP_IP.fromString(config["CaptivePortal"]["ip"].as<const char *>());
-	IPAddress subnet(defaultConfig.subnet);
-	if (config["CaptivePortal"]["subnet"].is<const char *>())
-		subnet.fromString(config["CaptivePortal"]["subnet"].as<const char *>());
+	IPAddress softAP_IP;
+	if (!softAP_IP.fromString(settings.CaptivePortal.ip))
+		softAP_IP.fromString(ConfigDefaults::CaptivePortal::ip);
+	IPAddress subnet;
+	if (!subnet.fromString(settings.CaptivePortal.subnet))
+		subnet.fromString(ConfigDefaults::CaptivePortal::subnet);
 
 	// create WiFi AP
 	WiFi.softAPConfig(softAP_IP, softAP_IP, subnet);
-	WiFi.softAP(config["hostname"].as<const char*>());
+	WiFi.softAP(settings.hostname.c_str());
 	_portalActive = true;
 	_portalStarted = millis()/1000;
 	Serial.println("OK");
 
 	// redirecting all the domains to the ESP
 	Serial.print("Start DNS ... ");
-	_dnsServer.setErrorReplyCode(DNSReplyCode::NoError);
-	_dnsServer.start(DNS_PORT, "*", WiFi.softAPIP());
-	_dnsServerActive = true;
-	Serial.println("OK");
+	_dnsServerActive = _dnsServer.start(DNS_PORT, WiFi.softAPIP());
+	Serial.println(_dnsServerActive ? "OK" : "Failed !");
 
 }
 
@@ -92,7 +177,7 @@ void startCaptivePortal()
  */
 void stopCaptivePortal()
 {
-	Serial.print("Stop WiFi AP: " + config["hostname"].as<String>() + " ... ");
+	Serial.print("Stop WiFi AP: " + settings.hostname + " ... ");
 	WiFi.softAPdisconnect(true);
 
 	// redirecting all the domains to the ESP
@@ -106,106 +191,6 @@ void stopCaptivePortal()
 }
 
 
-/**
- * connect as WiFi Client
- * use strongest available network in known credentials list
- */
-void findAndConnectWifiNetwork()
-{
-	// scan for networks and connect to strongest one we have credentials
-	WiFi.disconnect();
-	WiFi.scanDelete();
-	int n = WiFi.scanNetworks(false, false);
-	std::vector<int> order(n);
-	int i, j; 
-
-	// init order list
-	for (j = 0; j < n; j++)
-		order[j] = j;
-	// sort networks (bubble sort)
-	for (i = 0; i < n-1; i++)       
-	{
-		// last i elements are already in place    
-		for (j = 0; j < n-i-1; j++) 
-		{
-			if ( WiFi.RSSI( order[j] ) < WiFi.RSSI( order[j+1] ) )
-			{
-				// swap
-				int tmp = order[j];
-				order[j] = order[j+1]; 
-				order[j+1] = tmp;
-			}
-		}
-	}
-
-	// connect to first known network
-	bool connected = false;
-	for (j = 0; j < n && !connected; j++)
-	{
-		String ssid = WiFi.SSID(order[j]);
-		int32_t rssi = WiFi.RSSI(order[j]);
-		// list networks
-		Serial.print("Found Network: "); Serial.print(ssid);
-		Serial.print(" ("); Serial.print( rssi ); Serial.print(")");
-		if (config["Credentials"].containsKey(ssid))
-		{
-			String pwd = config["Credentials"][ssid];
-			Serial.print(" connecting ... ");
-
-			WiFi.begin(ssid.c_str(), pwd.c_str());
-			// wait for connection
-			for (i = _wifiClientConnectionTimeout * 10; (i > 0) && (WiFi.status() != WL_CONNECTED); i--)
-			{
-				delay(100);
-			}
-			if (WiFi.status() == WL_CONNECTED)
-			{
-				connected = true;
-				Serial.println("OK");
-				Serial.print("Client IP Address: "); Serial.println(WiFi.localIP());
-			}
-			else
-				Serial.println("Failed");
-		}
-		else
-		{
-			Serial.println(" unknown");
-		}
-		
-	}
-}
-
-/**
- * connect as WiFi Client
- * try given credentials, use strongest available network in known credentials list as fallback
- */
-void connectWifiNetwork(String ssid, String pwd)
-{
-	WiFi.disconnect();
-	Serial.print("Connect to ");
-	Serial.print(ssid);
-	Serial.print(" ... ");
-	WiFi.begin(ssid.c_str(), pwd.c_str());
-	// wait for connection
-	for (int16_t i = _wifiClientConnectionTimeout * 10; (i > 0) && (WiFi.status() != WL_CONNECTED); i--)
-	{
-		delay(100);
-	}
-
-	if (WiFi.status() == WL_CONNECTED)
-	{
-		Serial.println("OK");
-		Serial.print("Client IP Address: "); Serial.println(WiFi.localIP());
-	}
-	else
-	{
-		Serial.println("Failed");
-
-		// fallback to known networks
-		findAndConnectWifiNetwork();
-	}
-}
-
 /**
  * test for captive portal requests
  * 
@@ -243,91 +228,66 @@ static void handleCaptiveRequest()
 {
 	// redirect
 	Serial.println("request captured and redirected");
-	String portalPath = config["CaptivePortal"]["path"] | defaultConfig.portalPath;
-	_httpServer.sendHeader("Location", "http://" + config["hostname"].as<String>() + ".local/" + portalPath, true);
+	_httpServer.sendHeader("Location", "http://" + settings.hostname + ".local/" + settings.CaptivePortal.path, true);
 	_httpServer.send(302, "text/html", "");
-	_httpServer.client().stop();
-}
-
-/**
- * get MIME type from filename
- */
-static String getContentType(String filename)
-{
-	if (filename.endsWith(".htm"))
-		return "text/html";
-	if (filename.endsWith(".html"))
-		return "text/html";
-	if (filename.endsWith(".css"))
-		return "text/css";
-	if (filename.endsWith(".js"))
-		return "application/javascript";
-	if (filename.endsWith(".png"))
-		return "image/png";
-	if (filename.endsWith(".gif"))
-		return "image/gif";
-	if (filename.endsWith(".jpg"))
-		return "image/jpeg";
-	if (filename.endsWith(".ico"))
-		return "image/x-icon";
-	if (filename.endsWith(".xml"))
-		return "text/xml";
-	if (filename.endsWith(".pdf"))
-		return "application/x-pdf";
-	if (filename.endsWith(".zip"))
-		return "application/x-zip";
-	if (filename.endsWith(".gz"))
-		return "application/x-gzip";
-	return "text/plain";
+	CaptivePortal::endResponse();
 }
 
 /**
- * send static file
+ * send static file from asset index
  * 
  * @return true if file exist and was sent
  */
-static bool handleFile(String path)
+static bool handleFile(const String &uri)
 {
-	Serial.print("handleFile: "); Serial.println(path);
+	Serial.print("handleFile: "); Serial.println(uri);
 
-	// security check
-	if (path.indexOf("..") >= 0)
+	const AssetIndex::Asset *asset = _assets.find(uri);
+	if (!asset)
+	{
+		Serial.println(String("File Not Found: ") + uri);
 		return false;
+	}
 
-	// prepend web server folder
-	path = "/public" + path;
-
-	// add default page
-	if (path.endsWith("/"))
-		path += "index.html";
-
-	// MIME type
-	String contentType = getContentType(path);
+	// hashed names never change, other files are revalidated
+	_httpServer.sendHeader("Cache-Control", asset->immutable ? "public, max-age=31536000, immutable" : "no-cache");
+	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
+	_httpServer.sendHeader("ETag", asset->etag);
+	if (asset->lastModified.length())
+		_httpServer.sendHeader("Last-Modified", asset->lastModified);
 
-	String pathCompressed = path + ".gz";
-	bool found = SPIFFS.exists(path);
-	bool foundCompressed = SPIFFS.exists(pathCompressed);
-	if (found || foundCompressed)
+	// conditional request, If-None-Match takes precedence over If-Modified-Since
+	String etag = _httpServer.header("If-None-Match");
+	if ( etag.length() ? etag == asset->etag : (asset->lastModified.length() && _httpServer.header("If-Modified-Since") == asset->lastModified) )
 	{
-		// use compressed version if exist
-		if (foundCompressed)
-			path = pathCompressed;
-
-		// send file
-		_httpServer.sendHeader("Cache-Control", "public, max-age=36000"); // enable cache
-		_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
-		File file = SPIFFS.open(path, "r");
-		_httpServer.streamFile(file, contentType);
-		_httpServer.client().setNoDelay(true);
-		file.close();
-		_httpServer.client().stop();
+		_httpServer.send(304);
+		CaptivePortal::endResponse();
+		Serial.println(String("Not modified: ") + asset->path);
+		return true;
+	}
 
-		Serial.println(String("Sent file: ") + path);
+	// send content compiled into the firmware
+	if (asset->data)
+	{
+		if (asset->compressed)
+			_httpServer.sendHeader("Content-Encoding", "gzip");
+		_httpServer.setContentLength(asset->size);
+		_httpServer.send(200, asset->contentType, "");
+		_httpServer.sendContent_P((PGM_P)asset->data, asset->size); // the async server sends it from flash after the handler, like a file
+		CaptivePortal::endResponse();
+		Serial.println(String("Sent embedded: ") + asset->uri);
 		return true;
 	}
 
-	Serial.println(String("File Not Found: ") + path);
-	return false;
+	// send file
+	File file = SPIFFS.open(asset->path, "r");
+	if (!file)
+		return false;
+	_httpServer.streamFile(file, asset->contentType); // file is closed with its last handle, the async server streams it after the handler
+	CaptivePortal::endResponse();
+
+	Serial.println(String("Sent file: ") + asset->path);
+	return true;
 }
 
 /**
@@ -360,11 +320,11 @@ static void handleGenericHTTP()
 	_httpServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
 	// HTML Content
 	static String html;
-	html = "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><title>" + config["hostname"].as<String>() + "</title></head><body>";
+	html = "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><title>" + settings.hostname + "</title></head><body>";
 	html += "<i>" + _httpServer.uri() + "</i> not found";
 	html += "</body></html>";
 	_httpServer.send(404, "text/html", html);
-	_httpServer.client().stop();
+	CaptivePortal::endResponse();
 }
 
 /**
@@ -376,21 +336,28 @@ static void handleInfo()
 
 	// scan available networks
 	tempJson.clear();
-	tempJson["name"] = config["hostname"];
+	tempJson["name"] = settings.hostname;
 	auto portal = tempJson.createNestedObject("CaptivePortal");
-	portal["ssid"] = config["hostname"];
+	portal["ssid"] = settings.hostname;
 	portal["ip"] = WiFi.softAPIP().toString();
 	auto client = tempJson.createNestedObject("client");
 	client["ssid"] = WiFi.SSID();
 	client["ip"] = WiFi.localIP().toString();
+	client["state"] = _wifiConnector.getStateName();
+	client["rssi"] = WiFi.RSSI();
+	client["connectTime"] = _wifiConnector.getConnectTime();
+	client["reconnects"] = _wifiConnector.getReconnects();
+	client["roams"] = _wifiConnector.getRoams();
+	if (_wifiConnector.getState() == WIFI_CLIENT_CONNECTING)
+	{
+		client["connecting"] = _wifiConnector.getCandidate();
+		client["attempt"] = _wifiConnector.getAttempt();
+		client["candidates"] = _wifiConnector.getCandidateCount();
+	}
+	_configStore.stats(tempJson.createNestedObject("config"));
 
 	// send json data
-	String content;
-	serializeJsonPretty(tempJson, content);
-	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
-	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
-	_httpServer.send(200, "application/json", content);
-	_httpServer.client().stop();
+	CaptivePortal::sendJson(200, tempJson);
 }
 
 /**
@@ -408,47 +375,54 @@ const char *encryptionTypeNames[] = {
 	"WIFI_AUTH_MAX"};
 
 /**
- * perform WiFi scan and send detected networks
+ * scanning would disturb the association of the WiFi client
+ */
+static bool scanAllowed()
+{
+	WIFICONNECTSTATE state = _wifiConnector.getState();
+	return state != WIFI_CLIENT_PENDING && state != WIFI_CLIENT_CONNECTING;
+}
+
+/**
+ * send detected networks from scan cache, an outdated result is refreshed in the background
+ * X-Scan-Running tells the client to ask again for the new result
  */
 static void handleWifiScan()
 {
-	Serial.print("WiFi scan: ... ");
+	if (scanAllowed())
+		_wifiScanner.refresh(settings.CaptivePortal.scanCacheTTL * 1000UL);
 
-	// scan available networks
+	// available networks, strongest access point per network
 	tempJson.clear();
-	WiFi.scanDelete();
-	int n = WiFi.scanNetworks(false, false); //WiFi.scanNetworks(async, show_hidden)
-	for (int i = 0; i < n; i++)
+	auto credentials = config["Credentials"].as<JsonObject>();
+	const std::vector<WifiScanner::Network> &networks = _wifiScanner.getNetworks();
+	String connectedSSID = WiFi.SSID();
+	for (size_t i = 0; i < networks.size(); i++)
 	{
-		JsonObject ap = tempJson.createNestedObject();
-		ap["ssid"] = WiFi.SSID(i);
-		ap["rssi"] = WiFi.RSSI(i);
-		ap["encrypted"] = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+		bool duplicate = false;
+		for (size_t j = 0; j < i && !duplicate; j++)
+			duplicate = networks[j].ssid == networks[i].ssid;
+		if (duplicate)
+			continue;
 
-		// check for currently connected
-		if (WiFi.SSID(i) == WiFi.SSID())
+		JsonObject ap = tempJson.createNestedObject();
+		ap["ssid"] = networks[i].ssid;
+		ap["rssi"] = networks[i].rssi;
+		ap["encrypted"] = networks[i].encrypted;
+		if (networks[i].ssid == connectedSSID)
 			ap["connected"] = true;
+		if (credentials.containsKey(networks[i].ssid))
+			ap["known"] = true;
 	}
 
-	// augment known networks
-	auto credentials = config["Credentials"].as<JsonObject>();
+	// known networks not in range
 	for (const auto &kv : credentials)
 	{
-		// search in networks
 		bool found = false;
-		for (auto ap : tempJson.as<JsonArray>())
-		{
-			if (kv.key() == ap["ssid"])
-			{
-				// we have credentials for this network
-				found = true;
-				ap["known"] = true;
-				break;
-			}
-		}
+		for (size_t i = 0; i < networks.size() && !found; i++)
+			found = networks[i].ssid == kv.key().c_str();
 		if (!found)
 		{
-			// add to network list
 			JsonObject newNet = tempJson.createNestedObject();
 			newNet["ssid"] = kv.key();
 			newNet["encrypted"] = (kv.value().as<String>().length() > 0);
@@ -457,13 +431,11 @@ static void handleWifiScan()
 	}
 
 	// send json data
-	String content;
-	serializeJsonPretty(tempJson, content);
-	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
-	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
-	_httpServer.send(200, "application/json", content);
-	_httpServer.client().stop();
-	Serial.println(content);
+	_httpServer.sendHeader("X-Scan-Running", _wifiScanner.isRunning() ? "true" : "false");
+	uint32_t age = _wifiScanner.getAge();
+	if (age != UINT32_MAX)
+		_httpServer.sendHeader("X-Scan-Age", String(age / 1000));
+	CaptivePortal::sendJson(200, tempJson);
 }
 
 /**
@@ -475,22 +447,23 @@ static void handleWifiAdd()
 	String pwd = sanity(_httpServer.arg("pwd"));
 	Serial.print("add '" + ssid + "' to known networks list");
 
-	auto credentials = config["Credentials"].as<JsonObject>();
-	credentials[ssid] = pwd;
-	saveConfig(config);
+	if (!_configStore.set("Credentials", ssid, pwd))
+	{
+		_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
+		_httpServer.send(507, "application/json", "{\"status\": \"config full\"}");
+		CaptivePortal::endResponse();
+		return;
+	}
 
 	// send reply
 	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
 	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
 	_httpServer.send(200, "application/json", "{\"status\": \"OK\"}");
-	_httpServer.client().stop();
+	CaptivePortal::endResponse();
 
-	// connect to WiFi
+	// connect to WiFi, progress is reported by /c/info
 	if (ssid != WiFi.SSID())
-	{
-		delay(100);
-		connectWifiNetwork(ssid, pwd);
-	}
+		_wifiConnector.connect(ssid, pwd);
 }
 
 /**
@@ -503,21 +476,17 @@ static void handleWifiDel()
 
 	bool reconnect = (ssid == WiFi.SSID());
 
-	config["Credentials"].remove(ssid);
-	saveConfig(config);
+	_configStore.remove("Credentials", ssid);
 
 	// send reply
 	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
 	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
 	_httpServer.send(200, "application/json", "{\"status\": \"OK\"}");
-	_httpServer.client().stop();
+	CaptivePortal::endResponse();
 
 	// connect to WiFi
 	if (reconnect)
-	{
-		delay(100);
-		findAndConnectWifiNetwork();
-	}
+		_wifiConnector.connectKnown();
 }
 
 /**
@@ -533,19 +502,57 @@ static void handleUpdateHostname()
 		// nothing to do, just send summary
 		return handleInfo();
 	}
-	config["hostname"] = hostname;
-	saveConfig(config);
+	_configStore.set(NULL, "hostname", hostname);
+	settings.reload(config.as<JsonObject>());
+
+	// answer with updated info, AP is re-started in loop()
+	handleInfo();
+}
+
+/**
+ * read config files and update settings, subsystems are notified
+ */
+static void loadSettings()
+{
+	_configStore.load();
+	loadConfig(tempJson, "/private.json", config.as<JsonObject>()); // overwrite with private config
+	uint8_t errors = settings.reload(config.as<JsonObject>());
+	if (errors)
+	{
+		Serial.print("config: ");
+		Serial.print(errors);
+		Serial.println(" invalid values replaced by defaults");
+	}
+}
 
-	// answer with updated info
+/**
+ * reload config files after they were changed
+ */
+static void handleReload()
+{
+	_configStore.flush();
+	loadSettings();
 	handleInfo();
+}
+
+/**
+ * settings listener
+ */
+static void applySettings(const Settings &s, const Settings &previous)
+{
+	_wifiConnector.setTimeout(s.CaptivePortal.wifiClientConnectionTimeout);
+	_wifiConnector.setRoamThreshold(s.CaptivePortal.roamThreshold);
+	_configStore.configure(s.ConfigStore.debounce, s.ConfigStore.journal, s.ConfigStore.journalLimit);
 
-	// re-start AP
-	startCaptivePortal();
+	// re-start AP after the response was sent
+	if (_portalActive && (s.hostname != previous.hostname || s.CaptivePortal.ip != previous.CaptivePortal.ip || s.CaptivePortal.subnet != previous.CaptivePortal.subnet))
+		_portalRestart = true;
 }
 
 void CaptivePortal::setup()
 {
 	// file system
+	BootProfiler::phase("fs");
 	if ( !SPIFFS.begin() )
 	{
 		// format filesystem if failed
@@ -553,21 +560,26 @@ void CaptivePortal::setup()
 		SPIFFS.begin();
 	}
 
-	// load config
-	loadConfig(config);
-	loadConfig(tempJson, "/private.json", config.as<JsonObject>()); // overwrite with private config
+	// index static files
+	BootProfiler::phase("assets");
+#ifdef EMBED_WEB_ASSETS
+	_assets.addEmbedded(webAssets, sizeof(webAssets) / sizeof(webAssets[0]));
+#endif
+	_assets.build(SPIFFS, PUBLIC_FOLDER);
+	Serial.print("static files: ");
+	Serial.println(_assets.count());
 
-	// sanity check for config
-	if (!config["hostname"])
-		config["hostname"] = defaultConfig.hostname;
-	_wifiClientConnectionTimeout = config["CaptivePortal"]["wifiClientConnectionTimeout"] | defaultConfig.wifiClientConnectionTimeout;
-	_portalTimeout = config["CaptivePortal"]["portalTimeout"] | defaultConfig.portalTimeout;
+	// load config
+	BootProfiler::phase("config");
+	settings.onChange(applySettings);
+	loadSettings();
 
 	// init WiFi
+	BootProfiler::phase("wifi");
 	WiFi.setAutoReconnect(false);
 	WiFi.persistent(false);
 
-	if ( config["CaptivePortal"]["wifiClientConnectionTimeout"].as<bool>() )
+	if ( settings.CaptivePortal.enabled )
 	{
 		// start AP and Captive Portal
 		WiFi.mode(WIFI_MODE_APSTA);
@@ -581,12 +593,14 @@ void CaptivePortal::setup()
 	Serial.print("AP IP Address: ");
 	Serial.println(WiFi.softAPIP());
 
-	// connect as WiFi Client
-	findAndConnectWifiNetwork();
+	// connect as WiFi Client, continued in loop()
+	_wifiConnector.begin();
+	_wifiConnector.connectKnown();
 
 	// enable mDNS
+	BootProfiler::phase("mdns");
 	Serial.print("Start mDNS ... ");
-	if (MDNS.begin(config["hostname"].as<const char*>()))
+	if (MDNS.begin(settings.hostname.c_str()))
 	{
 		MDNS.addService("http", "tcp", 80);
 		Serial.println("OK");
@@ -596,20 +610,26 @@ void CaptivePortal::setup()
 		Serial.println("Failed !");
 	}	
 
-	// setup HTTP server
+	// setup HTTP server, started by begin()
+	BootProfiler::phase("routes");
 	Serial.print("Start WebServer ... ");
 
-	_httpServer.on("/c/info", handleInfo);				 // send status info
-	_httpServer.on("/c/hostname", handleUpdateHostname); // update
-	_httpServer.on("/c/scan", handleWifiScan);			 // scan active WiFi networks
-	_httpServer.on("/c/add", handleWifiAdd);			 // add credential for WiFi network
-	_httpServer.on("/c/del", handleWifiDel);			 // remove known WiFi network
+	CaptivePortal::on("/c/info", handleInfo);				  // send status info
+	CaptivePortal::on("/c/hostname", handleUpdateHostname); // update
+	CaptivePortal::on("/c/scan", handleWifiScan);			  // scan active WiFi networks
+	CaptivePortal::on("/c/add", handleWifiAdd);			  // add credential for WiFi network
+	CaptivePortal::on("/c/del", handleWifiDel);			  // remove known WiFi network
+	CaptivePortal::on("/c/reload", handleReload);			  // reload config files
 
-	_httpServer.on("/generate_204", handleCaptiveRequest); // Android captive portal.
-	_httpServer.on("/fwlink", handleCaptiveRequest);	   // Microsoft captive portal.
+	CaptivePortal::on("/generate_204", handleCaptiveRequest); // Android captive portal.
+	CaptivePortal::on("/fwlink", handleCaptiveRequest);	   // Microsoft captive portal.
 
-	// generic not found
-	_httpServer.onNotFound(handleGenericHTTP);
+	// generic not found, static files
+	_httpServer.onNotFound(measured("*", handleGenericHTTP));
+
+	// request headers for conditional requests
+	static const char *headerKeys[] = {"If-None-Match", "If-Modified-Since"};
+	_httpServer.collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
 	Serial.println("OK");
 }
 
@@ -617,48 +637,81 @@ void CaptivePortal::begin()
 {
 	// start _httpServer
 	_httpServer.begin();
+	_pollTime = micros();
+	BootProfiler::event("http ready");
 }
 
 void CaptivePortal::loop()
 {
 	//DNS
+	LoopProfiler::phase("dns");
 	if ( _dnsServerActive )
 		_dnsServer.processNextRequest();
 
 	// Portal
+	LoopProfiler::phase("portal");
 	if ( _portalActive )
 	{
 		uint16_t time = millis() / 1000 - _portalStarted;
-		if ( time > _portalTimeout )
+		if ( time > settings.CaptivePortal.portalTimeout )
 		{
 			// stop Captive Portal
 			// 
 			stopCaptivePortal();
 		}
+		else if ( _portalRestart )
+		{
+			_portalRestart = false;
+			startCaptivePortal();
+		}
 	}
 
+	// WiFi client
+	LoopProfiler::phase("wifi");
+	_wifiScanner.loop(scanAllowed());
+	_wifiConnector.loop();
+
+	// config changes
+	LoopProfiler::phase("config");
+	_configStore.loop();
+
 	//HTTP
+	LoopProfiler::phase("http");
 	_httpServer.handleClient();
+	_pollTime = micros();
 }
 
 /*******************************************************************************************************************************
  * WebServer wrapper functions
  */
-WebServer &CaptivePortal::getHttpServer()
+HttpServerBackend &CaptivePortal::getHttpServer()
 {
 	return _httpServer;
 }
-void CaptivePortal::on(const String &uri, WebServer::THandlerFunction handler)
+unsigned long CaptivePortal::getRequestTime()
+{
+#ifdef ASYNC_HTTP_SERVER
+	return micros(); // handlers run as soon as the request is parsed
+#else
+	return _pollTime; // the request arrived after the previous poll
+#endif
+}
+
+void CaptivePortal::on(const String &uri, HttpServerBackend::THandlerFunction handler)
 {
-	_httpServer.on(uri, handler);
+	_httpServer.on(uri, measured(uri, handler));
 }
-void CaptivePortal::on(const String &uri, HTTPMethod method, WebServer::THandlerFunction handler)
+void CaptivePortal::on(const String &uri, const String &route, HttpServerBackend::THandlerFunction handler)
 {
-	_httpServer.on(uri, method, handler);
+	_httpServer.on(uri, measured(route, handler));
 }
-void CaptivePortal::on(const String &uri, HTTPMethod method, WebServer::THandlerFunction handler, WebServer::THandlerFunction ufn)
+void CaptivePortal::on(const String &uri, HTTPMethod method, HttpServerBackend::THandlerFunction handler)
 {
-	_httpServer.on(uri, method, handler, ufn);
+	_httpServer.on(uri, method, measured(uri, handler));
+}
+void CaptivePortal::on(const String &uri, HTTPMethod method, HttpServerBackend::THandlerFunction handler, HttpServerBackend::THandlerFunction ufn)
+{
+	_httpServer.on(uri, method, measured(uri, handler), ufn);
 }
 void CaptivePortal::sendHeader(const String &name, const String &value, bool first)
 {
@@ -669,12 +722,104 @@ void CaptivePortal::sendFinal(int code, char *content_type, const String &conten
 	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
 	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
 	_httpServer.send(code, content_type, content);
-	_httpServer.client().stop();
+	CaptivePortal::endResponse();
 }
 void CaptivePortal::sendFinal(int code, const String &content_type, const String &content)
 {
 	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
 	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
 	_httpServer.send(code, content_type, content);
+	CaptivePortal::endResponse();
+}
+void CaptivePortal::sendFinal(int code, const String &content_type, const String &content, const String &etag)
+{
+	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
+	_httpServer.sendHeader("Cache-Control", "no-cache");		 // always revalidate with ETag
+	_httpServer.sendHeader("ETag", etag);
+	_httpServer.send(code, content_type, content);
+	CaptivePortal::endResponse();
+}
+
+/**
+ * send JSON document with chunked transfer encoding, serialized straight to the client
+ * compact by default, pretty printed if the request has the argument "pretty"
+ */
+void CaptivePortal::sendJson(int code, const JsonDocument &json)
+{
+	bool pretty = _httpServer.hasArg("pretty");
+	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
+	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
+	_httpServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	_httpServer.send(code, "application/json", "");
+
+	ChunkedPrint out;
+	if (pretty)
+		serializeJsonPretty(json, out);
+	else
+		serializeJson(json, out);
+	out.flush();
+	_httpServer.sendContent("");	// last chunk
+	CaptivePortal::endResponse();
+}
+
+/**
+ * send text generated by a writer function with chunked transfer encoding
+ */
+void CaptivePortal::sendChunked(int code, const String &content_type, void (*writer)(Print &out))
+{
+	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
+	_httpServer.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");	// disable cache
+	_httpServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	_httpServer.send(code, content_type, "");
+
+	ChunkedPrint out;
+	writer(out);
+	out.flush();
+	_httpServer.sendContent("");	// last chunk
+	CaptivePortal::endResponse();
+}
+
+/**
+ * answer conditional request with 304 Not Modified if the client has the current version
+ * If-None-Match uses the weak comparison, the W/ prefix is ignored on both sides
+ * @return true if the response was sent
+ */
+bool CaptivePortal::notModified(const String &etag)
+{
+	String match = _httpServer.header("If-None-Match");
+	if (match.startsWith("W/"))
+		match = match.substring(2);
+	if (match != (etag.startsWith("W/") ? etag.substring(2) : etag))
+		return false;
+
+	_httpServer.sendHeader("Access-Control-Allow-Origin", "*"); // allow CORS
+	_httpServer.sendHeader("Cache-Control", "no-cache");
+	_httpServer.sendHeader("ETag", etag);
+	_httpServer.send(304);
+	CaptivePortal::endResponse();
+	return true;
+}
+
+/**
+ * finish response
+ * the synchronous server closes the connection, the async server keeps it alive for further requests
+ */
+void CaptivePortal::endResponse()
+{
+	heapSample(); // the async server still holds the unsent response
+#ifndef ASYNC_HTTP_SERVER
 	_httpServer.client().stop();
+#endif
+}
+
+/**
+ * take over connection of current request, e.g. for event streams
+ */
+WiFiClient CaptivePortal::takeClient()
+{
+#ifdef ASYNC_HTTP_SERVER
+	return _httpServer.detachClient();
+#else
+	return _httpServer.client();
+#endif
 }
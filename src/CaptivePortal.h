@@ -5,7 +5,7 @@
 #define _CAPTIVEPORTAL_h
 
 #include <Arduino.h>
-#ifdef ESP32
+#if defined(ESP32) || defined(NATIVE)
 	#include <WiFi.h>
 	#include <WebServer.h>
 	#include <ESPmDNS.h>
@@ -26,12 +26,28 @@
 	#include <FS.h>
 #endif
 
-#include <DNSServer.h>
 #include <ArduinoJson.h>
+#include "AssetIndex.h"
+#include "WifiScanner.h"
+#include "WifiConnector.h"
+#include "CaptiveDNS.h"
+#include "Metrics.h"
+
+// HTTP server backend, the async server handles several keep-alive connections at once
+#ifdef ASYNC_HTTP_SERVER
+	#include "HttpServer.h"
+	typedef HttpServer HttpServerBackend;
+#else
+	typedef WebServer HttpServerBackend;
+#endif
 
 // config
 #include "config.h"
-const size_t configJsonSize = 1024;
+#include "ConfigStore.h"
+#include "Settings.h"
+#include "BootProfiler.h"
+#include "LoopProfiler.h"
+const size_t configJsonSize = 2048;	// the default config takes about 900 bytes, the rest is for credentials and replaced strings
 extern DynamicJsonDocument config;
 
 
@@ -48,13 +64,27 @@ class CaptivePortal
 	static void loop();
 
 	// web server functions
-	static WebServer &getHttpServer();
-	static void on(const String &uri, WebServer::THandlerFunction handler);
-	static void on(const String &uri, HTTPMethod method, WebServer::THandlerFunction handler);
-	static void on(const String &uri, HTTPMethod method, WebServer::THandlerFunction handler, WebServer::THandlerFunction ufn);
+	static HttpServerBackend &getHttpServer();
+	/**
+	 * earliest arrival of the current request [us], for latency measurements in handlers
+	 */
+	static unsigned long getRequestTime();
+	static void on(const String &uri, HttpServerBackend::THandlerFunction handler);
+	/**
+	 * register URI with the route template it is measured under, e.g. /printers/{id}/status
+	 */
+	static void on(const String &uri, const String &route, HttpServerBackend::THandlerFunction handler);
+	static void on(const String &uri, HTTPMethod method, HttpServerBackend::THandlerFunction handler);
+	static void on(const String &uri, HTTPMethod method, HttpServerBackend::THandlerFunction handler, HttpServerBackend::THandlerFunction ufn);
 	static void sendHeader(const String &name, const String &value, bool first = false);
 	static void sendFinal(int code, char *content_type, const String &content);
 	static void sendFinal(int code, const String &content_type, const String &content);
+	static void sendFinal(int code, const String &content_type, const String &content, const String &etag);
+	static void sendJson(int code, const JsonDocument &json);
+	static void sendChunked(int code, const String &content_type, void (*writer)(Print &out));
+	static bool notModified(const String &etag);
+	static void endResponse();
+	static WiFiClient takeClient();
 };
 
 #endif // _CAPTIVEPORTAL_h
\ No newline at end of file
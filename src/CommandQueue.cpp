@@ -0,0 +1,266 @@
+/*
+	SparkMaker Command Queue
+*/
+#include "CommandQueue.h"
+
+CommandQueue::CommandQueue(WriteFunction write, void *context)
+	: write(write), context(context), sequence(0), replyHead(0), replyTail(0),
+	  sent(0), acked(0), retries(0), timeouts(0), failed(0), dropped(0), unmatched(0), maxDepth(0),
+	  lastLatency(0), maxLatency(0), totalLatency(0), latencyCount(0),
+	  urgentBudget(UINT32_MAX), urgentCount(0), urgentLast(0), urgentMax(0), urgentOverBudget(0)
+{
+}
+
+bool CommandQueue::push(const String &cmd, CMDPRIORITY priority, MESSAGETYPE ack, uint32_t timeout, uint8_t retries, bool barrier)
+{
+	// coalesce repeated status and file list requests, every other command runs once per push (e.g. relative moves)
+	for (size_t i = 0; priority == CMD_PRIORITY_BACKGROUND && i < queue.size(); i++)
+	{
+		if (queue[i].cmd == cmd)
+			return true;
+	}
+
+	// full queue: drop the newest command of lowest priority for a more important one
+	if (queue.size() >= MAX_QUEUED)
+	{
+		dropped++;
+		if (queue.back().priority <= priority)
+		{
+			Serial.print("command queue full, dropped: ");
+			Serial.println(cmd);
+			return false;
+		}
+		Serial.print("command queue full, dropped: ");
+		Serial.println(queue.back().cmd);
+		queue.pop_back();
+	}
+
+	Command command = {cmd, priority, ack, timeout, retries, barrier, ++sequence, 0, millis(), 0};
+	std::vector<Command>::iterator it = queue.end();
+	while (it != queue.begin() && (it - 1)->priority > priority)
+		--it;
+	queue.insert(it, command);
+	if (queue.size() > maxDepth)
+		maxDepth = queue.size();
+	return true;
+}
+
+bool CommandQueue::urgent(const String &cmd, MESSAGETYPE ack, unsigned long requestTime)
+{
+	unsigned long now = millis();
+	Command command = {cmd, CMD_PRIORITY_EMERGENCY, ack, ACK_TIMEOUT, MAX_RETRIES, false, ++sequence, 0, now, 0};
+	if (!send(command, now))
+		return false;
+	urgentLast = micros() - requestTime;
+	urgentCount++;
+	if (urgentLast > urgentMax)
+		urgentMax = urgentLast;
+	if (urgentLast > urgentBudget)
+		urgentOverBudget++;
+	if (ack != MSG_UNKNOWN)
+		inFlight.push_back(command);
+
+	// drop print and motion commands waiting behind the stop
+	for (size_t i = 0; i < queue.size();)
+	{
+		if (queue[i].priority == CMD_PRIORITY_CONTROL || queue[i].priority == CMD_PRIORITY_NORMAL)
+		{
+			Serial.print("command dropped by ");
+			Serial.print(cmd);
+			Serial.print(": ");
+			Serial.println(queue[i].cmd);
+			queue.erase(queue.begin() + i);
+			dropped++;
+		}
+		else
+			i++;
+	}
+	return true;
+}
+
+void CommandQueue::received(MESSAGETYPE type)
+{
+	// periodic messages never acknowledge a command
+	switch (type)
+	{
+	case MSG_UNKNOWN:
+	case MSG_HEARTBEAT:
+	case MSG_HANDSHAKE:
+	case MSG_FILE_ENTRY:
+	case MSG_LAYER:
+		return;
+	default:
+		break;
+	}
+
+	uint8_t head = replyHead.load(std::memory_order_relaxed);
+	uint8_t next = (head + 1) % REPLY_BUFFER_SIZE;
+	if (next == replyTail.load(std::memory_order_acquire))
+		return; // full, the command runs into its timeout
+	replies[head].type = type;
+	replies[head].time = millis();
+	replyHead.store(next, std::memory_order_release);
+}
+
+void CommandQueue::loop()
+{
+	unsigned long now = millis();
+	matchReplies();
+	checkTimeouts(now);
+
+	// pipeline queued commands
+	while (!queue.empty())
+	{
+		Command &command = queue.front();
+		if (command.priority != CMD_PRIORITY_EMERGENCY && (inFlight.size() >= MAX_IN_FLIGHT || barrierInFlight()))
+			break;
+		if (!send(command, now))
+			break; // not connected, keep queued
+		if (command.ack == MSG_UNKNOWN)
+			complete(command, now);
+		else
+			inFlight.push_back(command);
+		queue.erase(queue.begin());
+	}
+}
+
+void CommandQueue::clear()
+{
+	dropped += queue.size() + inFlight.size();
+	queue.clear();
+	inFlight.clear();
+}
+
+bool CommandQueue::send(Command &command, unsigned long now)
+{
+	if (!write(context, command.cmd))
+		return false;
+	command.sent = now;
+	command.attempts++;
+	sent++;
+	return true;
+}
+
+void CommandQueue::complete(const Command &command, unsigned long time)
+{
+	if (command.ack == MSG_UNKNOWN)
+		return;
+	acked++;
+	lastLatency = time - command.queued;
+	if (lastLatency > maxLatency)
+		maxLatency = lastLatency;
+	totalLatency += lastLatency;
+	latencyCount++;
+}
+
+/**
+ * replies are matched to the oldest command in flight waiting for this message type
+ */
+void CommandQueue::matchReplies()
+{
+	uint8_t tail = replyTail.load(std::memory_order_relaxed);
+	while (tail != replyHead.load(std::memory_order_acquire))
+	{
+		Reply reply = replies[tail];
+		tail = (tail + 1) % REPLY_BUFFER_SIZE;
+		replyTail.store(tail, std::memory_order_release);
+
+		bool matched = false;
+		for (size_t i = 0; i < inFlight.size() && !matched; i++)
+		{
+			if (inFlight[i].ack == reply.type)
+			{
+				complete(inFlight[i], reply.time);
+				inFlight.erase(inFlight.begin() + i);
+				matched = true;
+			}
+		}
+		if (!matched && reply.type == MSG_OK)
+			unmatched++;
+	}
+}
+
+void CommandQueue::checkTimeouts(unsigned long now)
+{
+	for (size_t i = 0; i < inFlight.size();)
+	{
+		Command &command = inFlight[i];
+		if (now - command.sent < command.timeout)
+		{
+			i++;
+			continue;
+		}
+		timeouts++;
+		if (command.attempts <= command.retries && send(command, now))
+		{
+			retries++;
+			Serial.print("command timeout, resend: ");
+			Serial.println(command.cmd);
+			i++;
+			continue;
+		}
+		failed++;
+		Serial.print("command failed: ");
+		Serial.println(command.cmd);
+		if (command.barrier)
+			dropDependents(command);
+		inFlight.erase(inFlight.begin() + i);
+	}
+}
+
+/**
+ * drop queued control and normal commands pushed after a failed barrier, e.g. the start of a print after the file selection
+ */
+void CommandQueue::dropDependents(const Command &barrier)
+{
+	for (size_t i = 0; i < queue.size();)
+	{
+		const Command &command = queue[i];
+		if (command.sequence > barrier.sequence && (command.priority == CMD_PRIORITY_CONTROL || command.priority == CMD_PRIORITY_NORMAL))
+		{
+			Serial.print("command dropped by failed ");
+			Serial.print(barrier.cmd);
+			Serial.print(": ");
+			Serial.println(command.cmd);
+			queue.erase(queue.begin() + i);
+			dropped++;
+		}
+		else
+			i++;
+	}
+}
+
+bool CommandQueue::barrierInFlight() const
+{
+	for (size_t i = 0; i < inFlight.size(); i++)
+	{
+		if (inFlight[i].barrier)
+			return true;
+	}
+	return false;
+}
+
+void CommandQueue::stats(JsonObject obj) const
+{
+	obj["depth"] = queue.size();
+	obj["maxDepth"] = maxDepth;
+	obj["inFlight"] = inFlight.size();
+	obj["sent"] = sent;
+	obj["acked"] = acked;
+	obj["retries"] = retries;
+	obj["timeouts"] = timeouts;
+	obj["failed"] = failed;
+	obj["dropped"] = dropped;
+	obj["unmatched"] = unmatched;
+	JsonObject latency = obj.createNestedObject("latency");
+	latency["last"] = lastLatency;
+	latency["avg"] = latencyCount ? (uint32_t)(totalLatency / latencyCount) : 0;
+	latency["max"] = maxLatency;
+	JsonObject urgent = obj.createNestedObject("urgent");
+	urgent["count"] = urgentCount;
+	urgent["last"] = urgentLast / 1000.0;
+	urgent["max"] = urgentMax / 1000.0;
+	if (urgentBudget != UINT32_MAX)
+		urgent["budget"] = urgentBudget / 1000.0;
+	urgent["overBudget"] = urgentOverBudget;
+}
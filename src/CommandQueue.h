@@ -0,0 +1,151 @@
+/*
+	SparkMaker Command Queue
+*/
+#ifndef _COMMANDQUEUE_h
+#define _COMMANDQUEUE_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <vector>
+#include "SparkMakerProtocol.h"
+
+typedef enum
+{
+	CMD_PRIORITY_EMERGENCY,	 // sent before everything else, ignores barriers and the in-flight limit
+	CMD_PRIORITY_CONTROL,	 // print, pause, resume, stop
+	CMD_PRIORITY_NORMAL,	 // moves and raw commands
+	CMD_PRIORITY_BACKGROUND, // status requests and file list
+	CMD_PRIORITY_COUNT
+} CMDPRIORITY;
+
+/**
+ * outbound printer commands
+ * commands are written without waiting for the previous reply, up to MAX_IN_FLIGHT commands wait for their reply at once
+ * replies carry no command id, a reply is matched to the oldest command in flight expecting this message type
+ * a barrier command holds back the following commands until it is acknowledged
+ * control and normal commands pushed after a barrier depend on it, they are dropped if the barrier fails
+ */
+class CommandQueue
+{
+  public:
+	static const uint8_t MAX_QUEUED = 16;
+	static const uint8_t MAX_IN_FLIGHT = 4;
+	static const uint32_t ACK_TIMEOUT = 1000; // [ms]
+	static const uint8_t MAX_RETRIES = 2;
+	static const uint8_t REPLY_BUFFER_SIZE = 16;
+
+	/**
+	 * writes one command to the printer, false if not connected
+	 * @param context pointer given to the constructor, e.g. the printer connection
+	 */
+	typedef bool (*WriteFunction)(void *context, const String &cmd);
+
+	CommandQueue(WriteFunction write, void *context);
+
+	/**
+	 * queue command, background requests already waiting are not queued twice
+	 * @param ack expected reply, MSG_UNKNOWN if the printer does not answer
+	 * @param retries resends after a timeout, 0 for commands that must not run twice (relative moves)
+	 * @return false if the queue is full
+	 */
+	bool push(const String &cmd, CMDPRIORITY priority, MESSAGETYPE ack = MSG_UNKNOWN, uint32_t timeout = ACK_TIMEOUT, uint8_t retries = MAX_RETRIES, bool barrier = false);
+
+	/**
+	 * write now, before queued commands and regardless of commands in flight
+	 * queued control and normal commands are dropped, they must not run after a stop
+	 * @param requestTime arrival of the request [us], for the latency statistics
+	 * @return false if not connected
+	 */
+	bool urgent(const String &cmd, MESSAGETYPE ack, unsigned long requestTime);
+
+	/**
+	 * latency budget for urgent commands from request to write [us]
+	 */
+	void setUrgentBudget(uint32_t budget) { urgentBudget = budget; }
+
+	/**
+	 * printer message received, called from the BLE task
+	 */
+	void received(MESSAGETYPE type);
+
+	/**
+	 * match replies, handle timeouts and write queued commands
+	 */
+	void loop();
+
+	/**
+	 * drop all commands, e.g. on disconnect
+	 */
+	void clear();
+
+	size_t getDepth() const { return queue.size(); }
+	size_t getInFlight() const { return inFlight.size(); }
+
+	/**
+	 * add metrics to JSON object
+	 */
+	void stats(JsonObject obj) const;
+
+  private:
+	typedef struct
+	{
+		String cmd;
+		CMDPRIORITY priority;
+		MESSAGETYPE ack;
+		uint32_t timeout;
+		uint8_t retries;
+		bool barrier;
+		uint32_t sequence; // push order
+		uint8_t attempts;
+		unsigned long queued;
+		unsigned long sent;
+	} Command;
+
+	typedef struct
+	{
+		MESSAGETYPE type;
+		unsigned long time;
+	} Reply;
+
+	bool send(Command &command, unsigned long now);
+	void complete(const Command &command, unsigned long time);
+	void matchReplies();
+	void checkTimeouts(unsigned long now);
+	bool barrierInFlight() const;
+	void dropDependents(const Command &barrier);
+
+	WriteFunction write;
+	void *context;
+	std::vector<Command> queue; // ordered by priority, FIFO within a priority
+	std::vector<Command> inFlight;
+	uint32_t sequence;
+
+	// replies from the BLE task, single producer / single consumer ring
+	Reply replies[REPLY_BUFFER_SIZE];
+	std::atomic<uint8_t> replyHead;
+	std::atomic<uint8_t> replyTail;
+
+	// statistics
+	uint32_t sent;
+	uint32_t acked;
+	uint32_t retries;
+	uint32_t timeouts;
+	uint32_t failed;
+	uint32_t dropped;
+	uint32_t unmatched;
+	uint16_t maxDepth;
+	uint32_t lastLatency; // queued until acknowledged [ms]
+	uint32_t maxLatency;
+	uint64_t totalLatency;
+	uint32_t latencyCount;
+
+	// urgent commands, request to write [us]
+	uint32_t urgentBudget;
+	uint32_t urgentCount;
+	uint32_t urgentLast;
+	uint32_t urgentMax;
+	uint32_t urgentOverBudget;
+};
+
+#endif // _COMMANDQUEUE_h
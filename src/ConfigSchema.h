@@ -0,0 +1,65 @@
+/*
+	Config Schema
+*/
+#ifndef _CONFIGSCHEMA_h
+#define _CONFIGSCHEMA_h
+
+/**
+ * keys of config.json with type, default and valid range
+ *   NUM(type, name, default, min, max)
+ *   STR(name, default)
+ * the Settings struct, its defaults and the JSON parser are generated from these lists
+ */
+
+// top level keys, empty hostname: ESP-<chip id>
+#define CONFIG_SCHEMA_ROOT(NUM, STR) \
+	STR(hostname, "")
+
+// portalTimeout [s], wifiClientConnectionTimeout per candidate network [s],
+// scanCacheTTL: age of scan result before /c/scan starts a new scan [s],
+// roamThreshold: look for a stronger access point below this RSSI [dBm], 0 disables roaming
+#define CONFIG_SCHEMA_CAPTIVEPORTAL(NUM, STR)                \
+	NUM(bool, enabled, true, 0, 1)                           \
+	NUM(uint16_t, portalTimeout, 300, 0, 65535)              \
+	NUM(uint16_t, wifiClientConnectionTimeout, 5, 1, 60)     \
+	NUM(uint16_t, scanCacheTTL, 30, 1, 3600)                 \
+	NUM(int8_t, roamThreshold, -75, -100, 0)                 \
+	STR(ip, "192.168.4.1")                                   \
+	STR(subnet, "255.255.255.0")                             \
+	STR(path, "portal.html")
+
+// debounce: quiet period before changes are written [ms],
+// journal: append changes instead of rewriting config.json, journalLimit: compact journal above this size [bytes]
+#define CONFIG_SCHEMA_CONFIGSTORE(NUM, STR)                  \
+	NUM(uint32_t, debounce, 2000, 0, 60000)                  \
+	NUM(bool, journal, true, 0, 1)                           \
+	NUM(uint16_t, journalLimit, 1024, 0, 16384)
+
+// status requests per printer state [s]: statusRequestInterval while printing (shorter if a layer is overdue),
+// pauseRequestInterval, idleRequestInterval in standby and after a print (backs off up to idleMaxRequestInterval),
+// transitionRequestInterval while connecting, stopping or updating
+// statusEventInterval: min. time between status events, faster changes are coalesced [ms],
+// emergencyBudget: max. time from stop request to BLE write [ms],
+// maxPrinters: printers connected at the same time, up to PrinterRegistry::MAX_PRINTERS
+#define CONFIG_SCHEMA_SPARKMAKER(NUM, STR)                   \
+	NUM(uint16_t, statusRequestInterval, 20, 1, 3600)        \
+	NUM(uint16_t, pauseRequestInterval, 30, 1, 3600)         \
+	NUM(uint16_t, idleRequestInterval, 60, 1, 3600)          \
+	NUM(uint16_t, idleMaxRequestInterval, 300, 1, 3600)      \
+	NUM(uint16_t, transitionRequestInterval, 2, 1, 3600)     \
+	NUM(uint16_t, statusEventInterval, 250, 0, 10000)        \
+	NUM(uint16_t, emergencyBudget, 50, 1, 10000)            \
+	NUM(uint8_t, maxPrinters, 1, 1, 3)
+
+// budget: max. duration of a main loop iteration before it is logged as stall [ms], 0 disables the warning
+#define CONFIG_SCHEMA_LOOP(NUM, STR)                         \
+	NUM(uint16_t, budget, 50, 0, 10000)
+
+// config sections: SECTION(name, schema)
+#define CONFIG_SCHEMA_SECTIONS(SECTION)                      \
+	SECTION(CaptivePortal, CONFIG_SCHEMA_CAPTIVEPORTAL)      \
+	SECTION(ConfigStore, CONFIG_SCHEMA_CONFIGSTORE)          \
+	SECTION(SparkMaker, CONFIG_SCHEMA_SPARKMAKER)            \
+	SECTION(Loop, CONFIG_SCHEMA_LOOP)
+
+#endif // _CONFIGSCHEMA_h
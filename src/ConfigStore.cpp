@@ -0,0 +1,278 @@
+/*
+	Config Persistence
+*/
+#include "ConfigStore.h"
+#include "config.h"
+#include "Settings.h"
+#if defined(ESP32) || defined(NATIVE)
+	#include <SPIFFS.h>
+#endif
+#ifdef ESP8266
+	#include <FS.h>
+	#define FILE_READ "r"
+	#define FILE_APPEND "a"
+#endif
+
+ConfigStore::ConfigStore(DynamicJsonDocument &config, const String &filename)
+	: config(config), filename(filename),
+	  debounce(ConfigDefaults::ConfigStore::debounce), journal(ConfigDefaults::ConfigStore::journal), journalLimit(ConfigDefaults::ConfigStore::journalLimit),
+	  journalSize(0), journalDamaged(false), incomplete(false), firstChange(0), lastChange(0),
+	  changes(0), writes(0), appends(0), bytesWritten(0), flushTime(0), maxFlushTime(0)
+{
+	journalFilename = filename.substring(0, filename.lastIndexOf('.')) + ".log";
+}
+
+bool ConfigStore::load()
+{
+	bool ok = loadConfig(config, filename);
+	uint16_t records = replay();
+	if (records)
+	{
+		Serial.print("ConfigStore: replayed ");
+		Serial.print(records);
+		Serial.println(" journal records");
+	}
+	return ok;
+}
+
+void ConfigStore::configure(uint32_t debounce, bool journal, size_t journalLimit)
+{
+	this->debounce = debounce;
+	this->journal = journal;
+	this->journalLimit = journalLimit;
+}
+
+bool ConfigStore::set(const char *section, const String &key, const String &value)
+{
+	if (!assign(section, key, value))
+	{
+		Serial.println("ConfigStore: config full, " + key + " not changed");
+		return false;
+	}
+	record(section, key, &value);
+	return true;
+}
+
+/**
+ * set value in the config document
+ * replaced strings are not freed by ArduinoJson, the pool is compacted once before giving up
+ */
+bool ConfigStore::assign(const char *section, const String &key, const String &value)
+{
+	for (uint8_t attempt = 0; attempt < 2; attempt++)
+	{
+		if (attempt && !config.garbageCollect())
+			return false;
+		if (section ? config[section][key].set(value) : config[key].set(value))
+			return true;
+	}
+	return false;
+}
+
+void ConfigStore::remove(const char *section, const String &key)
+{
+	JsonVariant parent = section ? config[section] : config.as<JsonVariant>();
+	if (!parent.containsKey(key))
+		return;
+	parent.remove(key);
+	record(section, key, NULL);
+}
+
+/**
+ * queue journal record, value NULL removes the key
+ */
+void ConfigStore::record(const char *section, const String &key, const String *value)
+{
+	DynamicJsonDocument entry(256);
+	if (section)
+		entry["s"] = section;
+	entry["k"] = key;
+	if (value)
+		entry["v"] = *value;
+	Record rec;
+	rec.id = String(section ? section : "") + "/" + key;
+	serializeJson(entry, rec.line);
+
+	// only the last change of a key is written
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		if (pending[i].id == rec.id)
+		{
+			pending.erase(pending.begin() + i);
+			break;
+		}
+	}
+	pending.push_back(rec);
+
+	if (!firstChange)
+		firstChange = millis();
+	lastChange = millis();
+	changes++;
+}
+
+void ConfigStore::loop()
+{
+	if (!isDirty())
+		return;
+	unsigned long now = millis();
+	if (now - lastChange >= debounce || now - firstChange >= MAX_DELAY)
+		flush();
+}
+
+bool ConfigStore::flush()
+{
+	if (!isDirty())
+		return true;
+
+	unsigned long start = micros();
+	size_t count = pending.size();
+	size_t size = 0;
+	for (size_t i = 0; i < pending.size(); i++)
+		size += pending[i].line.length() + 1;
+	bool ok;
+	if (journal && !journalDamaged && journalSize + size <= journalLimit)
+		ok = append() || compact();
+	else
+		ok = compact();
+	flushTime = micros() - start;
+	if (flushTime > maxFlushTime)
+		maxFlushTime = flushTime;
+
+	Serial.print("ConfigStore: flushed ");
+	Serial.print(count);
+	Serial.print(" changes in ");
+	Serial.print(flushTime);
+	Serial.println(" us");
+	if (ok)
+	{
+		pending.clear();
+		firstChange = 0;
+	}
+	else
+	{
+		// file system full or failing, changes stay pending and are tried again after the quiet period
+		firstChange = lastChange = millis();
+	}
+	return ok;
+}
+
+/**
+ * append pending records to the journal
+ * a short write leaves an incomplete record, the records stay pending and the journal is marked damaged
+ */
+bool ConfigStore::append()
+{
+	File file = SPIFFS.open(journalFilename, FILE_APPEND);
+	if (!file)
+	{
+		Serial.println("ConfigStore: failed to open journal");
+		return false;
+	}
+	size_t size = 0;
+	bool ok = true;
+	for (size_t i = 0; i < pending.size() && ok; i++)
+	{
+		size_t written = file.print(pending[i].line);
+		size += written;
+		ok = written == pending[i].line.length();
+		if (ok)
+		{
+			written = file.print('\n');
+			size += written;
+			ok = written == 1;
+		}
+	}
+	file.close();
+	journalSize += size;
+	bytesWritten += size;
+	if (!ok)
+	{
+		Serial.println("ConfigStore: journal write incomplete");
+		journalDamaged = true;
+		return false;
+	}
+	appends++;
+	return true;
+}
+
+/**
+ * rewrite config file and remove the journal
+ * pending records are appended to an existing journal first: after a power loss between the config write and the journal
+ * removal the replay ends with the newest values, so it only repeats what the config file already holds
+ */
+bool ConfigStore::compact()
+{
+	if (incomplete)
+	{
+		// the config file would lose the values only the journal holds
+		Serial.println("ConfigStore: journal not applied, no compaction");
+		return false;
+	}
+	if (journalSize && !journalDamaged && !pending.empty() && !append())
+		Serial.println("ConfigStore: journal not updated before compaction");
+	config.garbageCollect();	// drop strings of replaced values
+	if (!saveConfig(config, filename))
+		return false;
+	SPIFFS.remove(journalFilename);
+	journalSize = 0;
+	journalDamaged = false;
+	pending.clear();
+	firstChange = 0;
+	writes++;
+	bytesWritten += measureJson(config);
+	return true;
+}
+
+/**
+ * apply journal records to the loaded config, an incomplete last record is ignored
+ */
+uint16_t ConfigStore::replay()
+{
+	journalSize = 0;
+	journalDamaged = false;
+	incomplete = false;
+	File file = SPIFFS.open(journalFilename, FILE_READ);
+	if (!file)
+		return 0;
+	journalSize = file.size();
+
+	uint16_t records = 0;
+	DynamicJsonDocument entry(256);
+	while (file.available())
+	{
+		String line = file.readStringUntil('\n');
+		if (deserializeJson(entry, line) || !entry["k"])
+		{
+			// records appended behind it would never be replayed
+			journalDamaged = true;
+			break;
+		}
+		String key = entry["k"].as<String>();
+		const char *section = entry["s"];
+		if (entry["v"].isNull())
+		{
+			JsonVariant parent = section ? config[section] : config.as<JsonVariant>();
+			parent.remove(key);
+		}
+		else if (!assign(section, key, entry["v"].as<String>()))
+		{
+			Serial.println("ConfigStore: config full, journal record " + key + " not applied");
+			incomplete = true;
+		}
+		records++;
+	}
+	file.close();
+	return records;
+}
+
+void ConfigStore::stats(JsonObject obj) const
+{
+	obj["changes"] = changes;
+	obj["pending"] = pending.size();
+	obj["writes"] = writes;
+	obj["appends"] = appends;
+	obj["bytesWritten"] = bytesWritten;
+	obj["journalSize"] = journalSize;
+	obj["flushTime"] = flushTime;
+	obj["maxFlushTime"] = maxFlushTime;
+}
@@ -0,0 +1,98 @@
+/*
+	Config Persistence
+*/
+#ifndef _CONFIGSTORE_h
+#define _CONFIGSTORE_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+
+/**
+ * keeps config changes in memory and writes them after a quiet period
+ * small changes are appended to a journal, the config file is only rewritten when the journal is full
+ * the config file is replaced atomically by saveConfig()
+ */
+class ConfigStore
+{
+  public:
+	static const uint32_t MAX_DELAY = 10000; // flush at latest after first change [ms]
+
+	ConfigStore(DynamicJsonDocument &config, const String &filename = "/config.json");
+
+	/**
+	 * load config file and replay journal
+	 */
+	bool load();
+
+	/**
+	 * @param debounce quiet period before changes are written [ms]
+	 * @param journal append changes instead of rewriting the config file
+	 * @param journalLimit compact journal above this size [bytes]
+	 */
+	void configure(uint32_t debounce, bool journal, size_t journalLimit);
+
+	/**
+	 * change value, section NULL for top level keys
+	 * @return false if the config document is full, the change is not recorded
+	 */
+	bool set(const char *section, const String &key, const String &value);
+	void remove(const char *section, const String &key);
+
+	void loop();
+
+	/**
+	 * write pending changes now
+	 */
+	bool flush();
+
+	/**
+	 * write config file and clear journal
+	 */
+	bool compact();
+
+	bool isDirty() const { return pending.size() > 0; }
+
+	/**
+	 * add statistics to JSON object
+	 */
+	void stats(JsonObject obj) const;
+
+  private:
+	bool assign(const char *section, const String &key, const String &value);
+	void record(const char *section, const String &key, const String *value);
+	bool append();
+	uint16_t replay();
+
+	DynamicJsonDocument &config;
+	String filename;
+	String journalFilename;
+
+	// settings
+	uint32_t debounce;
+	bool journal;
+	size_t journalLimit;
+
+	// pending journal records, one per key
+	typedef struct
+	{
+		String id;
+		String line;
+	} Record;
+	std::vector<Record> pending;
+	size_t journalSize;
+	bool journalDamaged; // incomplete record in the journal, the replay would stop there, so the next flush compacts
+	bool incomplete;	 // journal records did not fit into the config document, compaction would lose them
+	unsigned long firstChange;
+	unsigned long lastChange;
+
+	// statistics
+	uint32_t changes;
+	uint32_t writes;
+	uint32_t appends;
+	uint32_t bytesWritten;
+	uint32_t flushTime; // [us]
+	uint32_t maxFlushTime;
+};
+
+#endif // _CONFIGSTORE_h
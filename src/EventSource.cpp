@@ -0,0 +1,141 @@
+/*
+	Server-Sent Events
+*/
+#include "EventSource.h"
+#include "CaptivePortal.h"
+
+EventSource::EventSource() : subscriberCount(0), lastSend(0)
+{
+}
+
+bool EventSource::subscribe(const char *event, const String &data, const String &id)
+{
+	HttpServerBackend &server = CaptivePortal::getHttpServer();
+
+	if (subscriberCount >= MAX_SUBSCRIBERS)
+	{
+		Serial.println("FAILURE: too many event subscribers");
+		server.sendHeader("Retry-After", "10");
+		server.send(503, "text/plain", "too many subscribers");
+		CaptivePortal::endResponse();
+		return false;
+	}
+
+	// keep connection open, the web server releases its copy of the client after the handler
+	WiFiClient client = CaptivePortal::takeClient();
+	String header =
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/event-stream\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Access-Control-Allow-Origin: *\r\n"
+		"Connection: keep-alive\r\n"
+		"\r\n"
+		"retry: 3000\n\n";
+	if (!write(client, header + format(event, data, id)))
+	{
+		client.stop();
+		return false;
+	}
+	client.setNoDelay(true);
+	lastIds[subscriberCount] = id;
+	subscribers[subscriberCount++] = client;
+
+	Serial.print("event subscriber connected: ");
+	Serial.println(subscriberCount);
+	return true;
+}
+
+void EventSource::send(const char *event, const String &data, const String &id)
+{
+	if (!subscriberCount)
+		return;
+
+	String message = format(event, data, id);
+	for (uint8_t i = subscriberCount; i-- > 0;)
+	{
+		if (id.length() && lastIds[i] == id)
+			continue;
+		if (!write(subscribers[i], message))
+			remove(i);
+		else
+			lastIds[i] = id;
+	}
+	lastSend = millis();
+}
+
+void EventSource::loop()
+{
+	if (!subscriberCount)
+		return;
+
+	// drop closed connections, discard anything sent by the browser
+	for (uint8_t i = subscriberCount; i-- > 0;)
+	{
+		while (subscribers[i].available())
+			subscribers[i].read();
+		if (!subscribers[i].connected())
+			remove(i);
+	}
+
+	// keep-alive comment, stops proxies and the browser from closing idle connections
+	if (millis() - lastSend > KEEPALIVE_INTERVAL)
+	{
+		for (uint8_t i = subscriberCount; i-- > 0;)
+		{
+			if (!write(subscribers[i], ":\n\n"))
+				remove(i);
+		}
+		lastSend = millis();
+	}
+}
+
+bool EventSource::write(WiFiClient &client, const String &message)
+{
+	if (!client.connected())
+		return false;
+	return client.write((const uint8_t *)message.c_str(), message.length()) == message.length();
+}
+
+void EventSource::remove(uint8_t i)
+{
+	subscribers[i].stop();
+	subscriberCount--;
+	if (i != subscriberCount)
+	{
+		subscribers[i] = subscribers[subscriberCount];
+		lastIds[i] = lastIds[subscriberCount];
+	}
+	subscribers[subscriberCount] = WiFiClient();
+	lastIds[subscriberCount] = String();
+
+	Serial.print("event subscriber disconnected: ");
+	Serial.println(subscriberCount);
+}
+
+/**
+ * format event, every line of data gets its own data field
+ */
+String EventSource::format(const char *event, const String &data, const String &id)
+{
+	String message;
+	message.reserve(data.length() + 64);
+	if (id.length())
+	{
+		message += "id: ";
+		message += id;
+		message += "\n";
+	}
+	message += "event: ";
+	message += event;
+	message += "\ndata: ";
+	for (size_t i = 0; i < data.length(); i++)
+	{
+		char c = data[i];
+		if (c == '\n')
+			message += "\ndata: ";
+		else if (c != '\r')
+			message += c;
+	}
+	message += "\n\n";
+	return message;
+}
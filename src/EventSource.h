@@ -0,0 +1,55 @@
+/*
+	Server-Sent Events
+*/
+#ifndef _EVENTSOURCE_h
+#define _EVENTSOURCE_h
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/**
+ * text/event-stream channel with several subscribers
+ * subscribers keep their HTTP connection open, events are pushed to all of them
+ */
+class EventSource
+{
+  public:
+	static const uint8_t MAX_SUBSCRIBERS = 4;
+	static const uint32_t KEEPALIVE_INTERVAL = 15000; // keep idle connections open [ms]
+
+	EventSource();
+
+	/**
+	 * HTTP handler: take over the current client as subscriber and send it the current state as first event
+	 * @return false if there are too many subscribers
+	 */
+	bool subscribe(const char *event, const String &data, const String &id = String());
+
+	/**
+	 * send event to all subscribers
+	 * subscribers that already received an event with this id are skipped, e.g. the first event of a new subscriber
+	 */
+	void send(const char *event, const String &data, const String &id = String());
+
+	/**
+	 * send keep-alive and drop closed connections
+	 */
+	void loop();
+
+	/**
+	 * number of connected subscribers
+	 */
+	uint8_t count() const { return subscriberCount; }
+
+  private:
+	bool write(WiFiClient &client, const String &message);
+	void remove(uint8_t i);
+	static String format(const char *event, const String &data, const String &id);
+
+	WiFiClient subscribers[MAX_SUBSCRIBERS];
+	String lastIds[MAX_SUBSCRIBERS]; // id of the last event sent to the subscriber
+	uint8_t subscriberCount;
+	unsigned long lastSend;
+};
+
+#endif // _EVENTSOURCE_h
@@ -0,0 +1,749 @@
+/*
+	Asynchronous HTTP/1.1 Server
+*/
+#include "HttpServer.h"
+#include <errno.h>
+#if defined(NATIVE)
+	#include <sys/socket.h>
+#elif defined(ESP32)
+	#include <lwip/sockets.h>
+#endif
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+HttpServer::HttpServer(int port) : server(port), current(NULL), currentMethod(HTTP_GET), currentVersion(1), responseLength(CONTENT_LENGTH_NOT_SET), responseSent(false), chunked(false), detached(false)
+{
+}
+
+void HttpServer::begin()
+{
+	server.begin();
+	server.setNoDelay(true);
+}
+
+void HttpServer::on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn)
+{
+	Handler handler;
+	handler.uri = uri;
+	handler.method = method;
+	handler.fn = fn;
+	if (ufn)
+	{
+		// requests are limited to MAX_BODY_SIZE and read as a whole, there is no upload streaming
+		Serial.print("FAILURE: HttpServer does not support upload handlers, ");
+		Serial.print(uri);
+		Serial.println(" answers 501");
+		handler.fn = [this]() { send(501, "text/plain", "upload not supported"); };
+	}
+	handlers.push_back(handler);
+}
+
+/**
+ * serve all connections, called from the Arduino loop
+ */
+void HttpServer::handleClient()
+{
+	accept();
+
+	unsigned long time = millis();
+	for (uint8_t i = 0; i < MAX_CONNECTIONS; i++)
+	{
+		Connection &connection = connectionPool[i];
+		switch (connection.state)
+		{
+		case HTTP_CLOSED:
+			break;
+
+		case HTTP_READ:
+			if (!connection.client.connected() || time - connection.timestamp > KEEP_ALIVE_TIMEOUT)
+			{
+				close(connection);
+				break;
+			}
+			receive(connection);
+			break;
+
+		case HTTP_WRITE:
+			transmit(connection);
+			break;
+		}
+	}
+}
+
+/**
+ * accept new connections while there are free slots
+ * further connections wait in the backlog of the listening socket
+ */
+void HttpServer::accept()
+{
+	for (uint8_t i = 0; i < MAX_CONNECTIONS; i++)
+	{
+		Connection &connection = connectionPool[i];
+		if (connection.state != HTTP_CLOSED)
+			continue;
+		if (!server.hasClient())
+			return;
+
+		connection.client = server.available();
+		if (!connection.client)
+			return;
+		connection.client.setNoDelay(true);
+		connection.state = HTTP_READ;
+		connection.input = "";
+		clearOutput(connection);
+		connection.requests = 0;
+		connection.timestamp = millis();
+	}
+}
+
+/**
+ * read available request data and handle complete requests
+ */
+void HttpServer::receive(Connection &connection)
+{
+	char buffer[257];
+	int available = connection.client.available();
+	while (available > 0)
+	{
+		int len = connection.client.read((uint8_t *)buffer, available < 256 ? available : 256);
+		if (len <= 0)
+			break;
+		buffer[len] = 0x00;
+		connection.input += buffer;
+		connection.timestamp = millis();
+		available -= len;
+	}
+
+	// complete header?
+	int headerEnd = connection.input.indexOf("\r\n\r\n");
+	if (headerEnd < 0)
+	{
+		if (connection.input.length() > MAX_HEADER_SIZE)
+		{
+			connection.client.print("HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+			close(connection);
+		}
+		return;
+	}
+
+	// complete body?
+	size_t contentLength = 0;
+	String header = connection.input.substring(0, headerEnd + 2);
+	header.toLowerCase();
+	int pos = header.indexOf("\r\ncontent-length:");
+	if (pos >= 0)
+		contentLength = header.substring(pos + 17, header.indexOf("\r\n", pos + 17)).toInt();
+	if (contentLength > MAX_BODY_SIZE)
+	{
+		connection.client.print("HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+		close(connection);
+		return;
+	}
+	size_t requestLength = headerEnd + 4 + contentLength;
+	if (connection.input.length() < requestLength)
+		return;
+
+	if (!parseRequest(connection, headerEnd + 4))
+	{
+		connection.client.print("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+		close(connection);
+		return;
+	}
+	connection.input.remove(0, requestLength); // keep pipelined requests
+	handleRequest(connection);
+}
+
+/**
+ * parse request line, headers and body of the current request
+ */
+bool HttpServer::parseRequest(Connection &connection, size_t headerLength)
+{
+	const String &request = connection.input;
+	currentArgs.clear();
+	currentHeaders.clear();
+	currentHost = "";
+
+	// request line
+	int lineEnd = request.indexOf("\r\n");
+	String line = request.substring(0, lineEnd);
+	int sp1 = line.indexOf(' ');
+	int sp2 = line.indexOf(' ', sp1 + 1);
+	if (sp1 < 0 || sp2 < 0)
+		return false;
+	String methodStr = line.substring(0, sp1);
+	String url = line.substring(sp1 + 1, sp2);
+	currentVersion = line.endsWith("1.0") ? 0 : 1;
+	currentMethod = HTTP_GET;
+	if (methodStr == "POST")
+		currentMethod = HTTP_POST;
+	else if (methodStr == "DELETE")
+		currentMethod = HTTP_DELETE;
+	else if (methodStr == "OPTIONS")
+		currentMethod = HTTP_OPTIONS;
+	else if (methodStr == "PUT")
+		currentMethod = HTTP_PUT;
+	else if (methodStr == "PATCH")
+		currentMethod = HTTP_PATCH;
+	else if (methodStr == "HEAD")
+		currentMethod = HTTP_HEAD;
+
+	int query = url.indexOf('?');
+	currentUri = query >= 0 ? url.substring(0, query) : url;
+	if (query >= 0)
+		parseArguments(url.substring(query + 1));
+
+	// headers
+	bool keepAlive = currentVersion > 0;
+	size_t contentLength = 0;
+	String contentType;
+	size_t pos = lineEnd + 2;
+	while (pos < headerLength - 2)
+	{
+		int end = request.indexOf("\r\n", pos);
+		String header = request.substring(pos, end);
+		pos = end + 2;
+		int colon = header.indexOf(':');
+		if (colon < 0)
+			continue;
+		String name = header.substring(0, colon);
+		String value = header.substring(colon + 1);
+		value.trim();
+
+		if (name.equalsIgnoreCase("Host"))
+		{
+			// host name without port
+			int portSep = value.lastIndexOf(':');
+			currentHost = portSep > 0 && value.lastIndexOf(']') < portSep ? value.substring(0, portSep) : value;
+		}
+		else if (name.equalsIgnoreCase("Content-Length"))
+			contentLength = value.toInt();
+		else if (name.equalsIgnoreCase("Content-Type"))
+			contentType = value;
+		else if (name.equalsIgnoreCase("Connection"))
+			keepAlive = value.equalsIgnoreCase("keep-alive") || (keepAlive && !value.equalsIgnoreCase("close"));
+
+		for (size_t i = 0; i < headerKeys.size(); i++)
+		{
+			if (name.equalsIgnoreCase(headerKeys[i]))
+			{
+				KeyValue kv;
+				kv.key = headerKeys[i];
+				kv.value = value;
+				currentHeaders.push_back(kv);
+			}
+		}
+	}
+	connection.requests++;
+	connection.keepAlive = keepAlive && connection.requests < MAX_KEEP_ALIVE_REQUESTS;
+
+	// body
+	if (contentLength)
+	{
+		String body = request.substring(headerLength, headerLength + contentLength);
+		if (contentType.startsWith("application/x-www-form-urlencoded"))
+			parseArguments(body);
+		else if (contentType.startsWith("multipart/form-data"))
+			parseMultipart(body, contentType.substring(contentType.indexOf("boundary=") + 9));
+		else
+		{
+			KeyValue kv;
+			kv.key = "plain";
+			kv.value = body;
+			currentArgs.push_back(kv);
+		}
+	}
+	return true;
+}
+
+/**
+ * call handler of the current request
+ */
+void HttpServer::handleRequest(Connection &connection)
+{
+	current = &connection;
+	responseHeaders = "";
+	responseLength = CONTENT_LENGTH_NOT_SET;
+	responseSent = false;
+	chunked = false;
+	detached = false;
+	clearOutput(connection);
+	connection.aborted = false;
+	connection.timestamp = millis();
+
+	bool handled = false;
+	for (size_t i = 0; i < handlers.size(); i++)
+	{
+		const Handler &handler = handlers[i];
+		if ((handler.method == HTTP_ANY || handler.method == currentMethod) && handler.uri == currentUri)
+		{
+			handler.fn();
+			handled = true;
+			break;
+		}
+	}
+	if (!handled)
+	{
+		if (notFoundHandler)
+			notFoundHandler();
+		else
+			send(404, "text/plain", String("Not found: ") + currentUri);
+	}
+	current = NULL;
+
+	if (connection.aborted)
+	{
+		// the response did not fit into the output queue, the rest of it was dropped
+		close(connection);
+		return;
+	}
+	if (detached)
+	{
+		// connection owned by the handler now
+		connection.client = WiFiClient();
+		connection.file = fs::File();
+		connection.state = HTTP_CLOSED;
+		return;
+	}
+	if (!responseSent)
+		send(500, "text/plain", "no response");
+	if (chunked)
+		queue(connection, "0\r\n\r\n", 5);
+	connection.state = HTTP_WRITE;
+	transmit(connection);
+}
+
+/**
+ * send next slice of the response
+ */
+void HttpServer::transmit(Connection &connection)
+{
+	if (!connection.client.connected())
+	{
+		close(connection);
+		return;
+	}
+
+	size_t len = 0;
+	size_t sent = 0;
+	if (!connection.output.empty())
+	{
+		// queued response, up to one segment per call
+		len = WRITE_SIZE;
+		sent = writeSegment(connection, len);
+	}
+	else if (connection.file)
+	{
+		// file content, the part the socket did not take is read again
+		uint8_t buffer[WRITE_SIZE];
+		len = connection.file.read(buffer, sizeof(buffer));
+		sent = len ? write(connection, buffer, len) : 0;
+		if (sent < len)
+			connection.file.seek(connection.file.position() - (len - sent));
+		else if (len < sizeof(buffer))
+			connection.file = fs::File();
+	}
+
+	if (sent)
+		connection.timestamp = millis();
+	if (sent < len)
+	{
+		// socket buffer full, continue with the next handleClient()
+		if (millis() - connection.timestamp > KEEP_ALIVE_TIMEOUT)
+		{
+			Serial.println("HttpServer: client stopped reading, connection closed");
+			close(connection);
+		}
+		return;
+	}
+
+	if (!connection.output.empty() || connection.file)
+		return;
+
+	// response complete
+	clearOutput(connection);
+	connection.timestamp = millis();
+	if (!connection.keepAlive)
+	{
+		close(connection);
+		return;
+	}
+	connection.state = HTTP_READ;
+	if (connection.input.length())
+		receive(connection); // pipelined request
+}
+
+/**
+ * pass queued output of the current response to the socket while the handler is running, as far as the socket takes it
+ */
+void HttpServer::flush(Connection &connection)
+{
+	while (!connection.output.empty())
+	{
+		size_t len = SIZE_MAX;
+		if (writeSegment(connection, len) < len)
+			break;
+	}
+}
+
+/**
+ * write the first queued segment as far as the socket takes it, it is removed once it is sent
+ * @param length maximum to write, set to the bytes tried
+ * @return bytes written
+ */
+size_t HttpServer::writeSegment(Connection &connection, size_t &length)
+{
+	const Segment &segment = connection.output.front();
+	const char *data = segment.content ? segment.content : segment.copy.c_str();
+	size_t remaining = (segment.content ? segment.length : segment.copy.length()) - connection.outputPos;
+	if (length > remaining)
+		length = remaining;
+
+	size_t sent = write(connection, (const uint8_t *)data + connection.outputPos, length);
+	connection.outputPos += sent;
+	if (!segment.content)
+		connection.outputSize -= sent;
+	if (sent == remaining)
+	{
+		connection.output.pop_front();
+		connection.outputPos = 0;
+	}
+	return sent;
+}
+
+/**
+ * append response data to the output queue, sent by transmit() as the client takes it
+ * @return false if the queue is full or the heap is low, the response is incomplete then
+ */
+bool HttpServer::queue(Connection &connection, const char *data, size_t length)
+{
+	if (connection.outputSize + length > MAX_OUTPUT_SIZE || ESP.getFreeHeap() < length + OUTPUT_HEAP_RESERVE)
+		return false;
+
+	connection.outputSize += length;
+	while (length)
+	{
+		if (connection.output.empty() || connection.output.back().content || connection.output.back().copy.length() >= WRITE_SIZE)
+		{
+			connection.output.push_back(Segment());
+			connection.output.back().copy.reserve(WRITE_SIZE);
+		}
+		String &segment = connection.output.back().copy;
+		size_t len = WRITE_SIZE - segment.length();
+		if (len > length)
+			len = length;
+		for (size_t i = 0; i < len; i++)
+			segment += data[i];
+		data += len;
+		length -= len;
+	}
+	return true;
+}
+
+void HttpServer::clearOutput(Connection &connection)
+{
+	connection.output.clear();
+	connection.outputPos = 0;
+	connection.outputSize = 0;
+}
+
+/**
+ * write without waiting for the client
+ * @return bytes taken by the socket, 0 if its send buffer is full
+ */
+size_t HttpServer::write(Connection &connection, const uint8_t *data, size_t length)
+{
+#ifdef ESP8266
+	size_t space = connection.client.availableForWrite();
+	return connection.client.write(data, length < space ? length : space);
+#else
+	int fd = connection.client.fd();
+	if (fd < 0)
+		return 0;
+	ssize_t sent = ::send(fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			connection.client.stop(); // closed by transmit()
+		return 0;
+	}
+	return sent;
+#endif
+}
+
+void HttpServer::close(Connection &connection)
+{
+	connection.client.stop();
+	connection.client = WiFiClient();
+	connection.file = fs::File();
+	connection.input = "";
+	clearOutput(connection);
+	connection.state = HTTP_CLOSED;
+}
+
+uint8_t HttpServer::connections() const
+{
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < MAX_CONNECTIONS; i++)
+	{
+		if (connectionPool[i].state != HTTP_CLOSED)
+			n++;
+	}
+	return n;
+}
+
+/*******************************************************************************************************************************
+ * request
+ */
+WiFiClient HttpServer::client()
+{
+	return current ? current->client : WiFiClient();
+}
+
+WiFiClient HttpServer::detachClient()
+{
+	if (!current)
+		return WiFiClient();
+	detached = true;
+	return current->client;
+}
+
+String HttpServer::arg(const String &name) const
+{
+	for (size_t i = 0; i < currentArgs.size(); i++)
+	{
+		if (currentArgs[i].key == name)
+			return currentArgs[i].value;
+	}
+	return String();
+}
+
+bool HttpServer::hasArg(const String &name) const
+{
+	for (size_t i = 0; i < currentArgs.size(); i++)
+	{
+		if (currentArgs[i].key == name)
+			return true;
+	}
+	return false;
+}
+
+void HttpServer::collectHeaders(const char *keys[], const size_t count)
+{
+	headerKeys.clear();
+	for (size_t i = 0; i < count; i++)
+		headerKeys.push_back(keys[i]);
+}
+
+String HttpServer::header(const String &name) const
+{
+	for (size_t i = 0; i < currentHeaders.size(); i++)
+	{
+		if (currentHeaders[i].key.equalsIgnoreCase(name))
+			return currentHeaders[i].value;
+	}
+	return String();
+}
+
+bool HttpServer::hasHeader(const String &name) const
+{
+	for (size_t i = 0; i < currentHeaders.size(); i++)
+	{
+		if (currentHeaders[i].key.equalsIgnoreCase(name))
+			return true;
+	}
+	return false;
+}
+
+void HttpServer::parseArguments(const String &data)
+{
+	int pos = 0;
+	while (pos < (int)data.length())
+	{
+		int end = data.indexOf('&', pos);
+		if (end < 0)
+			end = data.length();
+		String pair = data.substring(pos, end);
+		pos = end + 1;
+		if (!pair.length())
+			continue;
+		KeyValue kv;
+		int eq = pair.indexOf('=');
+		kv.key = urlDecode(eq < 0 ? pair : pair.substring(0, eq));
+		if (eq >= 0)
+			kv.value = urlDecode(pair.substring(eq + 1));
+		currentArgs.push_back(kv);
+	}
+}
+
+void HttpServer::parseMultipart(const String &body, const String &boundary)
+{
+	String delimiter = "--" + boundary;
+	int pos = body.indexOf(delimiter);
+	while (pos >= 0)
+	{
+		int partStart = pos + delimiter.length();
+		if (body.substring(partStart, partStart + 2) == "--")
+			break;
+		int next = body.indexOf(delimiter, partStart);
+		if (next < 0)
+			break;
+		String part = body.substring(partStart + 2, next - 2);
+		pos = next;
+
+		int headerEnd = part.indexOf("\r\n\r\n");
+		if (headerEnd < 0)
+			continue;
+		String headers = part.substring(0, headerEnd);
+		int nameStart = headers.indexOf("name=\"");
+		if (nameStart < 0)
+			continue;
+		nameStart += 6;
+		KeyValue kv;
+		kv.key = headers.substring(nameStart, headers.indexOf('"', nameStart));
+		kv.value = part.substring(headerEnd + 4);
+		currentArgs.push_back(kv);
+	}
+}
+
+String HttpServer::urlDecode(const String &text)
+{
+	String decoded;
+	for (size_t i = 0; i < text.length(); i++)
+	{
+		char c = text[i];
+		if (c == '+')
+			decoded += ' ';
+		else if (c == '%' && i + 2 < text.length())
+		{
+			char hex[3] = {text[i + 1], text[i + 2], 0};
+			decoded += (char)strtol(hex, NULL, 16);
+			i += 2;
+		}
+		else
+			decoded += c;
+	}
+	return decoded;
+}
+
+/*******************************************************************************************************************************
+ * response
+ */
+const char *HttpServer::responseCodeToString(int code)
+{
+	switch (code)
+	{
+	case 200: return "OK";
+	case 204: return "No Content";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 413: return "Payload Too Large";
+	case 500: return "Internal Server Error";
+	case 503: return "Service Unavailable";
+	default: return "";
+	}
+}
+
+void HttpServer::sendHeader(const String &name, const String &value, bool first)
+{
+	String line = name + ": " + value + "\r\n";
+	if (first)
+		responseHeaders = line + responseHeaders;
+	else
+		responseHeaders += line;
+}
+
+void HttpServer::send(int code, const char *content_type, const String &content)
+{
+	if (!current || responseSent)
+		return;
+	Connection &connection = *current;
+	responseSent = true;
+
+	String response = String("HTTP/1.") + String(currentVersion) + " " + String(code) + " " + responseCodeToString(code) + "\r\n";
+	response += "Content-Type: ";
+	response += content_type ? content_type : "text/html";
+	response += "\r\n";
+	if (responseLength == CONTENT_LENGTH_NOT_SET)
+		response += "Content-Length: " + String(content.length()) + "\r\n";
+	else if (responseLength != CONTENT_LENGTH_UNKNOWN)
+		response += "Content-Length: " + String(responseLength) + "\r\n";
+	else if (currentVersion)
+	{
+		chunked = true;
+		response += "Transfer-Encoding: chunked\r\n";
+	}
+	else
+	{
+		// HTTP/1.0 without length, the connection end marks the end of the content
+		connection.keepAlive = false;
+	}
+	if (connection.keepAlive)
+		response += "Connection: keep-alive\r\nKeep-Alive: timeout=" + String(KEEP_ALIVE_TIMEOUT / 1000) + ", max=" + String(MAX_KEEP_ALIVE_REQUESTS) + "\r\n";
+	else
+		response += "Connection: close\r\n";
+	response += responseHeaders;
+	response += "\r\n";
+	responseHeaders = "";
+
+	if (!queue(connection, response.c_str(), response.length()))
+	{
+		connection.aborted = true;
+		return;
+	}
+	if (content.length() && currentMethod != HTTP_HEAD)
+		sendContent(content);
+}
+
+/**
+ * queue content of the current response, copied or referenced
+ */
+void HttpServer::appendContent(const char *content, size_t length, bool copy)
+{
+	if (!current || !length || currentMethod == HTTP_HEAD)
+		return;
+	Connection &connection = *current;
+
+	if (connection.aborted)
+		return;
+	char chunkSize[12] = "";
+	if (chunked)
+		snprintf(chunkSize, sizeof(chunkSize), "%x\r\n", (unsigned)length);
+	bool queued = queue(connection, chunkSize, strlen(chunkSize));
+	if (queued && copy)
+		queued = queue(connection, content, length);
+	else if (queued)
+	{
+		Segment segment;
+		segment.content = content;
+		segment.length = length;
+		connection.output.push_back(segment);
+	}
+	if (!queued || (chunked && !queue(connection, "\r\n", 2)))
+	{
+		Serial.println("HttpServer: response too large for the output queue, connection closed");
+		connection.aborted = true;
+		return;
+	}
+
+	// pass large responses to the socket while they are built, a fast client keeps the queue short
+	if (connection.outputSize >= FLUSH_SIZE)
+		flush(connection);
+}
+
+size_t HttpServer::streamFile(fs::File &file, const String &contentType)
+{
+	String name = file.name();
+	if (name.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream")
+		sendHeader("Content-Encoding", "gzip");
+	setContentLength(file.size());
+	send(200, contentType, "");
+	if (current && currentMethod != HTTP_HEAD)
+		current->file = file; // streamed by transmit()
+	return file.size();
+}
@@ -0,0 +1,168 @@
+/*
+	Asynchronous HTTP/1.1 Server
+*/
+#ifndef _HTTPSERVER_h
+#define _HTTPSERVER_h
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include <FS.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * event driven HTTP server with the routing and response API of the Arduino WebServer
+ * serves several connections at once, connections are kept alive for further requests
+ * handleClient() never waits for a client, responses are sent in slices and files are streamed after the handler
+ * response data the socket does not take while the handler runs is queued and sent by the following handleClient() calls
+ */
+class HttpServer
+{
+  public:
+	typedef std::function<void(void)> THandlerFunction;
+
+	static const uint8_t MAX_CONNECTIONS = 6;
+	static const uint32_t KEEP_ALIVE_TIMEOUT = 5000;	// close idle connections [ms]
+	static const uint16_t MAX_KEEP_ALIVE_REQUESTS = 100; // requests per connection
+	static const size_t MAX_HEADER_SIZE = 2048;
+	static const size_t MAX_BODY_SIZE = 4096;
+	static const size_t MAX_OUTPUT_SIZE = 65536;	  // queued response data per connection, a larger response is dropped
+	static const size_t OUTPUT_HEAP_RESERVE = 16384; // free heap kept when queueing response data
+	static const size_t FLUSH_SIZE = 4096;			  // queued response data passed to the socket while the handler runs
+	static const size_t WRITE_SIZE = 1460;			  // bytes per connection and handleClient() call, size of the queued segments
+
+	explicit HttpServer(int port = 80);
+
+	void begin();
+	void handleClient();
+
+	// routing
+	void on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+	void on(const String &uri, HTTPMethod method, THandlerFunction fn) { on(uri, method, fn, THandlerFunction()); }
+	void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
+	void onNotFound(THandlerFunction fn) { notFoundHandler = fn; }
+
+	// request
+	String uri() const { return currentUri; }
+	HTTPMethod method() const { return currentMethod; }
+	WiFiClient client();
+	String arg(const String &name) const;
+	String arg(int i) const { return i < (int)currentArgs.size() ? currentArgs[i].value : String(); }
+	String argName(int i) const { return i < (int)currentArgs.size() ? currentArgs[i].key : String(); }
+	int args() const { return currentArgs.size(); }
+	bool hasArg(const String &name) const;
+	void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+	String header(const String &name) const;
+	bool hasHeader(const String &name) const;
+	String hostHeader() const { return currentHost; }
+
+	/**
+	 * take over connection of the current request, the server does not send a response and forgets the connection
+	 */
+	WiFiClient detachClient();
+
+	// response
+	void sendHeader(const String &name, const String &value, bool first = false);
+	void setContentLength(const size_t contentLength) { responseLength = contentLength; }
+	void send(int code, const char *content_type = NULL, const String &content = String(""));
+	void send(int code, char *content_type, const String &content) { send(code, (const char *)content_type, content); }
+	void send(int code, const String &content_type, const String &content) { send(code, content_type.c_str(), content); }
+	void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+	void sendContent(const char *content, size_t length) { appendContent(content, length, true); }
+	/**
+	 * send content that stays in memory until it is sent, e.g. in flash (memory mapped), it is not copied
+	 */
+	void sendContent_P(PGM_P content, size_t length) { appendContent(content, length, false); }
+	size_t streamFile(fs::File &file, const String &contentType);
+
+	/**
+	 * number of open connections
+	 */
+	uint8_t connections() const;
+
+  private:
+	typedef enum
+	{
+		HTTP_CLOSED,
+		HTTP_READ,
+		HTTP_WRITE
+	} HTTPSTATE;
+
+	typedef struct
+	{
+		String key;
+		String value;
+	} KeyValue;
+
+	typedef struct
+	{
+		String uri;
+		HTTPMethod method;
+		THandlerFunction fn;
+	} Handler;
+
+	typedef struct
+	{
+		String copy;				  // response data copied into the queue
+		const char *content = NULL; // or response data referenced by sendContent_P()
+		size_t length = 0;			  // of content
+	} Segment;
+
+	typedef struct
+	{
+		WiFiClient client;
+		HTTPSTATE state = HTTP_CLOSED;
+		String input;				// received request data
+		std::deque<Segment> output; // response data not sent yet, copies in segments of up to WRITE_SIZE
+		size_t outputPos = 0;		// sent part of the first segment
+		size_t outputSize = 0;		// copied bytes in the queue
+		fs::File file;				// file sent after output
+		bool keepAlive = false;
+		bool aborted = false; // response larger than the queue takes, closed after the handler
+		uint16_t requests = 0;
+		unsigned long timestamp = 0; // last activity, last write progress while sending
+	} Connection;
+
+	void accept();
+	void receive(Connection &connection);
+	bool parseRequest(Connection &connection, size_t headerLength);
+	void handleRequest(Connection &connection);
+	void transmit(Connection &connection);
+	void flush(Connection &connection);
+	bool queue(Connection &connection, const char *data, size_t length);
+	size_t writeSegment(Connection &connection, size_t &length);
+	void appendContent(const char *content, size_t length, bool copy);
+	void clearOutput(Connection &connection);
+	size_t write(Connection &connection, const uint8_t *data, size_t length);
+	void close(Connection &connection);
+	void parseArguments(const String &data);
+	void parseMultipart(const String &body, const String &boundary);
+	static String urlDecode(const String &text);
+	static const char *responseCodeToString(int code);
+
+	WiFiServer server;
+	Connection connectionPool[MAX_CONNECTIONS];
+	std::vector<Handler> handlers;
+	THandlerFunction notFoundHandler;
+	std::vector<String> headerKeys;
+
+	// current request
+	Connection *current;
+	String currentUri;
+	HTTPMethod currentMethod;
+	uint8_t currentVersion;
+	String currentHost;
+	std::vector<KeyValue> currentArgs;
+	std::vector<KeyValue> currentHeaders;
+
+	// current response
+	String responseHeaders;
+	size_t responseLength;
+	bool responseSent;
+	bool chunked;
+	bool detached;
+};
+
+#endif // _HTTPSERVER_h
@@ -0,0 +1,303 @@
+/*
+	SparkMaker Job Log
+*/
+#include "JobLog.h"
+#if defined(ESP32) || defined(NATIVE)
+	#include <SPIFFS.h>
+#endif
+#ifdef ESP8266
+	#define FILE_READ "r"
+	#define FILE_WRITE "w"
+	#define FILE_APPEND "a"
+#endif
+
+static const uint32_t SUMMARY_MAGIC = 0x4a4f4201; // "JOB" and version
+
+const char *jobOutcomeNames[] = {
+	"FINISHED",
+	"STOPPED",
+	"EMERGENCY"
+};
+
+JobLog::JobLog(const String &filename, const String &summaryFilename)
+	: filename(filename), summaryFilename(summaryFilename), jobCount(0), lastId(0)
+{
+	memset(&summary, 0, sizeof(summary));
+}
+
+void JobLog::begin()
+{
+	// finish or discard an interrupted compaction
+	String tmpFilename = filename + ".tmp";
+	if (SPIFFS.exists(tmpFilename))
+	{
+		if (SPIFFS.exists(filename))
+			SPIFFS.remove(tmpFilename);
+		else
+			SPIFFS.rename(tmpFilename, filename);
+	}
+
+	// summary
+	File file = SPIFFS.open(summaryFilename, FILE_READ);
+	if (!file || file.read((uint8_t *)&summary, sizeof(summary)) != sizeof(summary) || summary.magic != SUMMARY_MAGIC)
+	{
+		Serial.println("job log: new summary");
+		memset(&summary, 0, sizeof(summary));
+		summary.magic = SUMMARY_MAGIC;
+	}
+	file.close();
+	summary.boot++;
+	lastId = summary.lastId;
+
+	// log
+	file = SPIFFS.open(filename, FILE_READ);
+	bool torn = false;
+	if (file)
+	{
+		jobCount = file.size() / sizeof(Job);
+		torn = file.size() % sizeof(Job) != 0; // interrupted append
+
+		// replay jobs written after the last summary, from the end back to the first known job
+		uint16_t first = jobCount;
+		Job job;
+		while (first > 0 && read(file, first - 1, job) && job.id > summary.lastId)
+			first--;
+		for (uint16_t i = first; i < jobCount; i++)
+		{
+			if (read(file, i, job))
+				apply(job);
+		}
+		if (first < jobCount)
+		{
+			Serial.print("job log: replayed ");
+			Serial.println(jobCount - first);
+		}
+		if (jobCount && read(file, jobCount - 1, job) && job.id > lastId)
+			lastId = job.id;
+		file.close();
+	}
+	saveSummary();
+	if (torn)
+		compact();
+
+	Serial.print("job log: ");
+	Serial.print(jobCount);
+	Serial.print(" jobs, boot ");
+	Serial.println(summary.boot);
+}
+
+bool JobLog::append(Job &job)
+{
+	job.id = ++lastId;
+	job.boot = summary.boot;
+	job.file[sizeof(job.file) - 1] = 0;
+	job.checksum = checksum(job);
+
+	File file = SPIFFS.open(filename, FILE_APPEND);
+	if (!file)
+	{
+		Serial.println("job log: failed to open log");
+		return false;
+	}
+	bool ok = file.write((const uint8_t *)&job, sizeof(job)) == sizeof(job);
+	file.close();
+	if (!ok)
+	{
+		Serial.println("job log: failed to write job");
+		return false;
+	}
+	jobCount++;
+
+	apply(job);
+	saveSummary();
+	if (jobCount >= MAX_JOBS)
+		compact();
+	return true;
+}
+
+bool JobLog::compact()
+{
+	File file = SPIFFS.open(filename, FILE_READ);
+	if (!file)
+		return false;
+	String tmpFilename = filename + ".tmp";
+	File tmp = SPIFFS.open(tmpFilename, FILE_WRITE);
+	if (!tmp)
+	{
+		file.close();
+		return false;
+	}
+
+	// copy the newest complete jobs
+	uint16_t first = jobCount > KEEP_JOBS ? jobCount - KEEP_JOBS : 0;
+	uint16_t count = 0;
+	Job job;
+	for (uint16_t i = first; i < jobCount; i++)
+	{
+		if (read(file, i, job) && tmp.write((const uint8_t *)&job, sizeof(job)) == sizeof(job))
+			count++;
+	}
+	file.close();
+	tmp.close();
+
+	// replace log
+	SPIFFS.remove(filename);
+	if (!SPIFFS.rename(tmpFilename, filename))
+	{
+		Serial.println("job log: compaction failed");
+		return false;
+	}
+	Serial.print("job log: compacted to ");
+	Serial.println(count);
+	jobCount = count;
+	return true;
+}
+
+/**
+ * read job by index (0 = oldest), false if the record is damaged
+ */
+bool JobLog::read(File &file, uint16_t index, Job &job)
+{
+	if (!file.seek(index * sizeof(Job)) || file.read((uint8_t *)&job, sizeof(job)) != sizeof(job))
+		return false;
+	return job.checksum == checksum(job);
+}
+
+/**
+ * add job to the statistics
+ */
+void JobLog::apply(const Job &job)
+{
+	summary.lastId = job.id;
+	summary.jobs++;
+	if (job.outcome <= JOB_EMERGENCY)
+		summary.outcomes[job.outcome]++;
+	summary.printTime += job.duration;
+	summary.pausedTime += job.paused;
+
+	// find file, replace the least recently printed file if not found
+	FileStats *stats = NULL;
+	for (uint16_t i = 0; i < summary.fileCount && !stats; i++)
+	{
+		if (!strncmp(summary.files[i].file, job.file, FILE_NAME_SIZE))
+			stats = &summary.files[i];
+	}
+	if (!stats)
+	{
+		if (summary.fileCount < MAX_FILES)
+		{
+			stats = &summary.files[summary.fileCount++];
+		}
+		else
+		{
+			stats = &summary.files[0];
+			for (uint16_t i = 1; i < summary.fileCount; i++)
+			{
+				if (summary.files[i].lastId < stats->lastId)
+					stats = &summary.files[i];
+			}
+		}
+		memset(stats, 0, sizeof(FileStats));
+		strncpy(stats->file, job.file, FILE_NAME_SIZE - 1);
+	}
+	stats->jobs++;
+	stats->lastId = job.id;
+	if (job.outcome == JOB_FINISHED)
+	{
+		stats->finished++;
+		stats->finishedTime += job.duration;
+	}
+}
+
+/**
+ * write summary atomically
+ */
+bool JobLog::saveSummary()
+{
+	String tmpFilename = summaryFilename + ".tmp";
+	File file = SPIFFS.open(tmpFilename, FILE_WRITE);
+	if (!file)
+		return false;
+	bool ok = file.write((const uint8_t *)&summary, sizeof(summary)) == sizeof(summary);
+	file.close();
+	if (!ok)
+	{
+		Serial.println("job log: failed to write summary");
+		SPIFFS.remove(tmpFilename);
+		return false;
+	}
+	SPIFFS.remove(summaryFilename);
+	return SPIFFS.rename(tmpFilename, summaryFilename);
+}
+
+/**
+ * CRC-8 (polynomial 0x07) of the record with checksum 0
+ */
+uint8_t JobLog::checksum(const Job &job)
+{
+	Job copy = job;
+	copy.checksum = 0;
+	const uint8_t *data = (const uint8_t *)&copy;
+	uint8_t crc = 0;
+	for (size_t i = 0; i < sizeof(copy); i++)
+	{
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; bit++)
+			crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+	return crc;
+}
+
+void JobLog::toJson(JsonDocument &json, uint16_t offset, uint8_t limit)
+{
+	if (limit > MAX_PAGE)
+		limit = MAX_PAGE;
+	json["total"] = jobCount;
+	json["offset"] = offset;
+	json["boot"] = summary.boot;
+
+	JsonObject totals = json.createNestedObject("summary");
+	totals["jobs"] = summary.jobs;
+	for (uint8_t i = 0; i <= JOB_EMERGENCY; i++)
+		totals[jobOutcomeNames[i]] = summary.outcomes[i];
+	totals["printHours"] = (int)(summary.printTime / 36.0 + 0.5) / 100.0;
+	totals["pausedHours"] = (int)(summary.pausedTime / 36.0 + 0.5) / 100.0;
+
+	// newest first
+	JsonArray list = json.createNestedArray("jobs");
+	File file = SPIFFS.open(filename, FILE_READ);
+	if (!file)
+		return;
+	Job job;
+	for (uint16_t i = 0; i < limit && offset + i < jobCount; i++)
+	{
+		if (!read(file, jobCount - 1 - offset - i, job))
+			continue;
+		JsonObject entry = list.createNestedObject();
+		entry["id"] = job.id;
+		entry["printer"] = job.printer;
+		entry["file"] = job.file;
+		entry["outcome"] = job.outcome <= JOB_EMERGENCY ? jobOutcomeNames[job.outcome] : "";
+		entry["boot"] = job.boot;
+		entry["start"] = job.start;
+		entry["duration"] = job.duration;
+		entry["paused"] = job.paused;
+		entry["layers"] = job.layers;
+		entry["totalLayers"] = job.totalLayers;
+	}
+	file.close();
+}
+
+void JobLog::filesToJson(JsonDocument &json) const
+{
+	JsonArray list = json.createNestedArray("files");
+	for (uint16_t i = 0; i < summary.fileCount; i++)
+	{
+		const FileStats &stats = summary.files[i];
+		JsonObject entry = list.createNestedObject();
+		entry["file"] = (char *)stats.file; // copied
+		entry["jobs"] = stats.jobs;
+		entry["finished"] = stats.finished;
+		entry["averageTime"] = stats.finished ? stats.finishedTime / stats.finished : 0;
+	}
+}
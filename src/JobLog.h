@@ -0,0 +1,122 @@
+/*
+	SparkMaker Job Log
+*/
+#ifndef _JOBLOG_h
+#define _JOBLOG_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+
+typedef enum
+{
+	JOB_FINISHED,
+	JOB_STOPPED,
+	JOB_EMERGENCY
+} JOBOUTCOME;
+
+/**
+ * string names for job outcomes
+ */
+extern const char *jobOutcomeNames[];
+
+/**
+ * append-only log of finished and stopped prints
+ * jobs are fixed size binary records, a page is read by seeking to its records
+ * the log is compacted to the newest KEEP_JOBS records when it reaches MAX_JOBS
+ * totals and per-file statistics are updated with every job and kept in a summary file, they outlive compaction
+ * on load only jobs newer than the summary are replayed
+ * there is no wall clock, start times are counted from the boot given by the boot counter
+ */
+class JobLog
+{
+  public:
+	static const uint16_t MAX_JOBS = 256;
+	static const uint16_t KEEP_JOBS = 192;
+	static const uint8_t MAX_FILES = 20;  // files with statistics, the least recently printed is replaced
+	static const uint8_t PAGE_SIZE = 10;  // default page size of toJson()
+	static const uint8_t MAX_PAGE = 20;
+	static const uint8_t FILE_NAME_SIZE = 40; // including terminator, longer names are truncated
+	static const size_t JSON_SIZE = JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(MAX_PAGE) + MAX_PAGE * (JSON_OBJECT_SIZE(10) + FILE_NAME_SIZE);
+
+	typedef struct
+	{
+		uint32_t id;	  // sequence number, assigned by append()
+		uint16_t boot;	  // boot counter, assigned by append()
+		uint8_t outcome;  // JOBOUTCOME
+		uint8_t checksum; // of the whole record with checksum 0
+		uint32_t start;	  // since boot [s]
+		uint32_t duration; // print time without pauses [s]
+		uint32_t paused;   // [s]
+		uint16_t layers;
+		uint16_t totalLayers;
+		char file[FILE_NAME_SIZE - 1];
+		uint8_t printer; // printer id, was the file name terminator in single printer logs
+	} Job;
+
+	JobLog(const String &filename = "/jobs.log", const String &summaryFilename = "/jobs.sum");
+
+	/**
+	 * load summary, count boot and replay jobs not in the summary
+	 */
+	void begin();
+
+	/**
+	 * write job and update statistics
+	 */
+	bool append(Job &job);
+
+	/**
+	 * keep the newest KEEP_JOBS jobs
+	 */
+	bool compact();
+
+	uint16_t count() const { return jobCount; }
+	uint16_t getBoot() const { return summary.boot; }
+
+	/**
+	 * add a page of jobs (newest first) and the totals to JSON document
+	 */
+	void toJson(JsonDocument &json, uint16_t offset, uint8_t limit = PAGE_SIZE);
+
+	/**
+	 * add per-file statistics to JSON document
+	 */
+	void filesToJson(JsonDocument &json) const;
+
+  private:
+	typedef struct
+	{
+		char file[FILE_NAME_SIZE];
+		uint16_t jobs;
+		uint16_t finished;
+		uint32_t finishedTime; // sum of finished jobs [s]
+		uint32_t lastId;	   // last job, for replacement
+	} FileStats;
+
+	typedef struct
+	{
+		uint32_t magic;
+		uint32_t lastId; // last job included
+		uint16_t boot;
+		uint16_t fileCount;
+		uint32_t jobs;
+		uint32_t outcomes[JOB_EMERGENCY + 1];
+		uint32_t printTime;	 // [s]
+		uint32_t pausedTime; // [s]
+		FileStats files[MAX_FILES];
+	} Summary;
+
+	bool read(File &file, uint16_t index, Job &job);
+	void apply(const Job &job);
+	bool saveSummary();
+	static uint8_t checksum(const Job &job);
+
+	String filename;
+	String summaryFilename;
+	Summary summary;
+	uint16_t jobCount;
+	uint32_t lastId;
+};
+
+#endif // _JOBLOG_h
@@ -0,0 +1,81 @@
+/*
+	Line framing for BLE notifications
+*/
+#include "LineFramer.h"
+
+#include <string.h>
+
+LineFramer::LineFramer() : head(0), tail(0), scan(0), discarding(false), lines(0), overflowBytes(0), truncatedLines(0)
+{
+}
+
+size_t LineFramer::write(const uint8_t *data, size_t length)
+{
+	size_t space = BUFFER_SIZE - (head - tail);
+	if (length > space)
+	{
+		overflowBytes += length - space;
+		length = space;
+	}
+
+	// copy in up to two parts (wrap around)
+	size_t pos = head & MASK;
+	size_t first = BUFFER_SIZE - pos;
+	if (first > length)
+		first = length;
+	memcpy(buffer + pos, data, first);
+	memcpy(buffer, data + first, length - first);
+	head += length;
+	return length;
+}
+
+const char *LineFramer::readLine(size_t &length)
+{
+	while (scan != head)
+	{
+		// search end of line
+		if (buffer[scan & MASK] != '\n')
+		{
+			scan++;
+			if (scan - tail >= LINE_SIZE)
+			{
+				// line does not fit, drop it up to its end
+				if (!discarding)
+					truncatedLines++;
+				discarding = true;
+				tail = scan;
+			}
+			continue;
+		}
+
+		size_t len = scan - tail;
+		size_t start = tail;
+		scan++;
+		tail = scan;
+		if (discarding)
+		{
+			// end of overlong line
+			discarding = false;
+			continue;
+		}
+
+		// copy line out of the ring buffer
+		size_t pos = start & MASK;
+		size_t first = BUFFER_SIZE - pos;
+		if (first > len)
+			first = len;
+		memcpy(line, buffer + pos, first);
+		memcpy(line + first, buffer, len - first);
+		line[len] = 0x00;
+		length = len;
+		lines++;
+		return line;
+	}
+	return NULL;
+}
+
+void LineFramer::clear()
+{
+	tail = scan = head;
+	discarding = false;
+}
@@ -0,0 +1,61 @@
+/*
+	Line framing for BLE notifications
+*/
+#ifndef _LINEFRAMER_h
+#define _LINEFRAMER_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * byte ring buffer which splits a notification stream into lines
+ * notifications may contain several lines or end within a line, partial lines are kept until the rest arrives
+ */
+class LineFramer
+{
+  public:
+	static const size_t BUFFER_SIZE = 1024; // ring buffer size, power of 2
+	static const size_t LINE_SIZE = 256;	// max line length including terminator
+
+	LineFramer();
+
+	/**
+	 * append received data
+	 * @return number of bytes stored, bytes which do not fit are dropped and counted as overflow
+	 */
+	size_t write(const uint8_t *data, size_t length);
+
+	/**
+	 * get next complete line
+	 * lines longer than LINE_SIZE are dropped and counted as truncated
+	 * @return terminated line without '\n' (valid until the next call), NULL if there is no complete line
+	 */
+	const char *readLine(size_t &length);
+
+	/**
+	 * discard buffered data
+	 */
+	void clear();
+
+	uint32_t getLines() const { return lines; }
+	uint32_t getOverflowBytes() const { return overflowBytes; }
+	uint32_t getTruncatedLines() const { return truncatedLines; }
+
+  private:
+	static const size_t MASK = BUFFER_SIZE - 1;
+	static_assert((BUFFER_SIZE & MASK) == 0, "LineFramer BUFFER_SIZE must be a power of 2");
+	static_assert(LINE_SIZE < BUFFER_SIZE, "LineFramer LINE_SIZE must be smaller than BUFFER_SIZE");
+
+	uint8_t buffer[BUFFER_SIZE];
+	char line[LINE_SIZE];
+	size_t head;	  // write position (free running)
+	size_t tail;	  // start of the current line (free running)
+	size_t scan;	  // bytes before scan are known to contain no '\n'
+	bool discarding; // drop bytes until the end of an overlong line
+
+	uint32_t lines;
+	uint32_t overflowBytes;
+	uint32_t truncatedLines;
+};
+
+#endif // _LINEFRAMER_h
@@ -0,0 +1,172 @@
+/*
+	Main Loop Profiler
+*/
+#include "LoopProfiler.h"
+
+static const uint32_t DURATION_BOUNDS[] = {100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000}; // [us]
+static const uint8_t DURATION_BOUND_COUNT = sizeof(DURATION_BOUNDS) / sizeof(DURATION_BOUNDS[0]);
+
+static Histogram loopDuration("sparkmaker_loop_duration_seconds", "duration of main loop iterations", DURATION_BOUNDS, DURATION_BOUND_COUNT, 1e-6);
+static Counter loopStalls("sparkmaker_loop_stalls_total", "main loop iterations above the budget");
+
+LoopProfiler::Phase LoopProfiler::phases[MAX_PHASES];
+uint8_t LoopProfiler::phaseCount = 0;
+LoopProfiler::Phase *LoopProfiler::current = NULL;
+uint32_t LoopProfiler::phaseCycles = 0;
+uint32_t LoopProfiler::phaseMicros = 0;
+uint32_t LoopProfiler::loopCycles = 0;
+uint32_t LoopProfiler::loopMicros = 0;
+LoopProfiler::Phase *LoopProfiler::slowest = NULL;
+uint32_t LoopProfiler::slowestDuration = 0;
+uint32_t LoopProfiler::iterations = 0;
+uint32_t LoopProfiler::maxDuration = 0;
+uint32_t LoopProfiler::stalls = 0;
+uint32_t LoopProfiler::stallTime = 0;
+uint32_t LoopProfiler::stallDuration = 0;
+const char *LoopProfiler::stallPhase = NULL;
+uint32_t LoopProfiler::stallPhaseDuration = 0;
+
+/**
+ * time since start [us]
+ * cycle resolution for short intervals, the cycle counter wraps after 17 s at 240 MHz
+ */
+uint32_t LoopProfiler::elapsed(uint32_t startCycles, uint32_t startMicros)
+{
+	uint32_t us = micros() - startMicros;
+	if (us >= 1000000)
+		return us;
+	return (ESP.getCycleCount() - startCycles) / ESP.getCpuFreqMHz();
+}
+
+void LoopProfiler::begin()
+{
+	current = NULL;
+	slowest = NULL;
+	slowestDuration = 0;
+	loopCycles = ESP.getCycleCount();
+	loopMicros = micros();
+}
+
+LoopProfiler::Phase *LoopProfiler::find(const char *name, const Phase *previous)
+{
+	// the phase order rarely changes: start after the previous phase
+	uint8_t start = previous ? previous - phases + 1 : 0;
+	for (uint8_t i = 0; i < phaseCount; i++)
+	{
+		Phase *p = &phases[(start + i) % phaseCount];
+		if (p->name == name || !strcmp(p->name, name))
+			return p;
+	}
+	if (phaseCount >= MAX_PHASES)
+		return NULL;
+
+	Phase *p = &phases[phaseCount++];
+	memset(p, 0, sizeof(Phase));
+	p->name = name;
+	p->histogram = new Histogram("sparkmaker_loop_phase_duration_seconds", "duration of main loop phases",
+								 DURATION_BOUNDS, DURATION_BOUND_COUNT, 1e-6, String("phase=\"") + name + "\"");
+	return p;
+}
+
+void LoopProfiler::phase(const char *name)
+{
+	Phase *previous = current;
+	endPhase();
+	current = find(name, previous);
+	phaseCycles = ESP.getCycleCount();
+	phaseMicros = micros();
+}
+
+void LoopProfiler::endPhase()
+{
+	if (!current)
+		return;
+	uint32_t us = elapsed(phaseCycles, phaseMicros);
+	current->count++;
+	current->total += us;
+	current->last = us;
+	if (us > current->max)
+	{
+		current->max = us;
+		current->maxTime = millis();
+	}
+	current->histogram->observe(us);
+	if (us >= slowestDuration)
+	{
+		slowest = current;
+		slowestDuration = us;
+	}
+	current = NULL;
+}
+
+void LoopProfiler::end(uint16_t budget)
+{
+	endPhase();
+	uint32_t us = elapsed(loopCycles, loopMicros);
+	iterations++;
+	loopDuration.observe(us);
+	if (us > maxDuration)
+		maxDuration = us;
+	if (!budget || us <= budget * 1000UL)
+		return;
+
+	// stall
+	stalls++;
+	loopStalls.inc();
+	const char *name = slowest ? slowest->name : "-";
+	if (us > stallDuration)
+	{
+		stallTime = millis();
+		stallDuration = us;
+		stallPhase = name;
+		stallPhaseDuration = slowestDuration;
+	}
+	Serial.print("WARNING: loop stall ");
+	Serial.print(us / 1000.0, 1);
+	Serial.print(" ms, ");
+	Serial.print(name);
+	Serial.print(" ");
+	Serial.print(slowestDuration / 1000.0, 1);
+	Serial.println(" ms");
+}
+
+void LoopProfiler::reset()
+{
+	for (uint8_t i = 0; i < phaseCount; i++)
+	{
+		phases[i].max = 0;
+		phases[i].maxTime = 0;
+	}
+	maxDuration = 0;
+	stallTime = 0;
+	stallDuration = 0;
+	stallPhase = NULL;
+	stallPhaseDuration = 0;
+}
+
+void LoopProfiler::toJson(JsonDocument &json)
+{
+	json["iterations"] = iterations;
+	json["max"] = maxDuration / 1000.0;
+	json["stalls"] = stalls;
+	if (stallPhase)
+	{
+		JsonObject stall = json.createNestedObject("worstStall");
+		stall["time"] = stallTime;
+		stall["duration"] = stallDuration / 1000.0;
+		stall["phase"] = stallPhase;
+		stall["phaseDuration"] = stallPhaseDuration / 1000.0;
+	}
+	JsonArray list = json.createNestedArray("phases");
+	for (uint8_t i = 0; i < phaseCount; i++)
+	{
+		const Phase &p = phases[i];
+		JsonObject phase = list.createNestedObject();
+		phase["name"] = p.name;
+		phase["count"] = p.count;
+		phase["avg"] = p.count ? p.total / p.count / 1000.0 : 0;
+		phase["last"] = p.last / 1000.0;
+		phase["max"] = p.max / 1000.0;
+		phase["maxTime"] = p.maxTime;
+	}
+}
@@ -0,0 +1,84 @@
+/*
+	Main Loop Profiler
+*/
+#ifndef _LOOPPROFILER_h
+#define _LOOPPROFILER_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "Metrics.h"
+
+/**
+ * measures every loop() iteration split into phases with the CPU cycle counter
+ * phases are sequential, phase() ends the previous one, end() the last one
+ * keeps the worst case per phase and the worst iteration, iterations above the budget are logged as stalls
+ */
+class LoopProfiler
+{
+  public:
+	static const uint8_t MAX_PHASES = 12;
+	static const size_t JSON_SIZE = JSON_OBJECT_SIZE(8) + JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(MAX_PHASES) + MAX_PHASES * JSON_OBJECT_SIZE(6);
+
+	/**
+	 * start of loop()
+	 */
+	static void begin();
+
+	/**
+	 * start phase, names must be string literals
+	 */
+	static void phase(const char *name);
+
+	/**
+	 * end of loop(), checks the budget
+	 * @param budget max. time per iteration [ms], 0 disables the check
+	 */
+	static void end(uint16_t budget);
+
+	/**
+	 * clear worst case records, e.g. after fixing a stall
+	 */
+	static void reset();
+
+	/**
+	 * add phase statistics and the worst stall to JSON document
+	 */
+	static void toJson(JsonDocument &json);
+
+  private:
+	typedef struct
+	{
+		const char *name;
+		Histogram *histogram;
+		uint32_t count;
+		uint64_t total; // [us]
+		uint32_t last;	// [us]
+		uint32_t max;	// [us]
+		uint32_t maxTime; // [ms]
+	} Phase;
+
+	static uint32_t elapsed(uint32_t startCycles, uint32_t startMicros);
+	static void endPhase();
+	static Phase *find(const char *name, const Phase *previous);
+
+	static Phase phases[MAX_PHASES];
+	static uint8_t phaseCount;
+	static Phase *current;
+	static uint32_t phaseCycles;
+	static uint32_t phaseMicros;
+	static uint32_t loopCycles;
+	static uint32_t loopMicros;
+	static Phase *slowest; // slowest phase of the current iteration
+	static uint32_t slowestDuration;
+
+	// iterations
+	static uint32_t iterations;
+	static uint32_t maxDuration; // [us]
+	static uint32_t stalls;
+	static uint32_t stallTime;	   // worst stall [ms since boot]
+	static uint32_t stallDuration; // [us]
+	static const char *stallPhase; // slowest phase of the worst stall
+	static uint32_t stallPhaseDuration;
+};
+
+#endif // _LOOPPROFILER_h
@@ -0,0 +1,155 @@
+/*
+	Metrics Registry
+*/
+#include "Metrics.h"
+
+static const char *metricTypeNames[] = {
+	"counter",
+	"gauge",
+	"histogram"
+};
+
+Metric *Metric::first = NULL;
+
+Metric::Metric(const char *name, const char *help, METRICTYPE type, const String &labels)
+	: name(name), help(help), type(type), labels(labels), next(NULL)
+{
+	// keep families together: insert after the last metric of the same name
+	Metric **link = &first;
+	Metric **insert = NULL;
+	while (*link)
+	{
+		if (!strcmp((*link)->name, name))
+			insert = &(*link)->next;
+		link = &(*link)->next;
+	}
+	if (!insert)
+		insert = link;
+	next = *insert;
+	*insert = this;
+}
+
+void Metric::writeAll(Print &out)
+{
+	const char *family = NULL;
+	for (const Metric *metric = first; metric; metric = metric->next)
+	{
+		if (!family || strcmp(family, metric->name))
+		{
+			family = metric->name;
+			out.print("# HELP ");
+			out.print(metric->name);
+			out.print(' ');
+			out.println(metric->help);
+			out.print("# TYPE ");
+			out.print(metric->name);
+			out.print(' ');
+			out.println(metricTypeNames[metric->type]);
+		}
+		metric->write(out);
+	}
+}
+
+/**
+ * write sample line: name[suffix]{labels,label} value
+ */
+void Metric::sample(Print &out, const char *suffix, const char *label, const char *value) const
+{
+	out.print(name);
+	if (suffix)
+		out.print(suffix);
+	if (labels.length() || label)
+	{
+		out.print('{');
+		out.print(labels);
+		if (labels.length() && label)
+			out.print(',');
+		if (label)
+			out.print(label);
+		out.print('}');
+	}
+	out.print(' ');
+	out.println(value);
+}
+
+void Counter::write(Print &out) const
+{
+	char text[12];
+	snprintf(text, sizeof(text), "%u", (unsigned)value.load(std::memory_order_relaxed));
+	sample(out, NULL, NULL, text);
+}
+
+CounterArray::CounterArray(const char *name, const char *help, const char *label, const char *const *values, uint8_t count)
+	: Metric(name, help, METRIC_COUNTER), label(label), values(values), count(count), counters(new std::atomic<uint32_t>[count])
+{
+	for (uint8_t i = 0; i < count; i++)
+		counters[i].store(0, std::memory_order_relaxed);
+}
+
+void CounterArray::write(Print &out) const
+{
+	String labelValue;
+	char text[12];
+	for (uint8_t i = 0; i < count; i++)
+	{
+		labelValue = String(label) + "=\"" + values[i] + "\"";
+		snprintf(text, sizeof(text), "%u", (unsigned)counters[i].load(std::memory_order_relaxed));
+		sample(out, NULL, labelValue.c_str(), text);
+	}
+}
+
+void Gauge::write(Print &out) const
+{
+	char text[12];
+	snprintf(text, sizeof(text), "%d", (int)(read ? read() : value.load(std::memory_order_relaxed)));
+	sample(out, NULL, NULL, text);
+}
+
+Histogram::Histogram(const char *name, const char *help, const uint32_t *bounds, uint8_t count, double scale, const String &labels)
+	: Metric(name, help, METRIC_HISTOGRAM, labels), bounds(bounds), count(count < MAX_BUCKETS ? count : MAX_BUCKETS), scale(scale), sumLow(0), sumHigh(0)
+{
+	for (uint8_t i = 0; i <= MAX_BUCKETS; i++)
+		buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(uint32_t value)
+{
+	uint8_t bucket = 0;
+	while (bucket < count && value > bounds[bucket])
+		bucket++;
+	buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t previous = sumLow.fetch_add(value, std::memory_order_relaxed);
+	if (previous + value < previous)
+		sumHigh.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::write(Print &out) const
+{
+	// labeled series appear with their first observation, e.g. routes never requested are left out
+	uint32_t observations = 0;
+	for (uint8_t i = 0; i <= count; i++)
+		observations += buckets[i].load(std::memory_order_relaxed);
+	if (!observations && labels.length())
+		return;
+
+	// buckets are cumulative in the text format
+	char le[24];
+	char text[24];
+	uint32_t total = 0;
+	for (uint8_t i = 0; i <= count; i++)
+	{
+		total += buckets[i].load(std::memory_order_relaxed);
+		if (i < count)
+			snprintf(le, sizeof(le), "le=\"%g\"", bounds[i] * scale);
+		else
+			strcpy(le, "le=\"+Inf\"");
+		snprintf(text, sizeof(text), "%u", (unsigned)total);
+		sample(out, "_bucket", le, text);
+	}
+	double sum = ((double)sumHigh.load(std::memory_order_relaxed) * 4294967296.0 + sumLow.load(std::memory_order_relaxed)) * scale;
+	snprintf(text, sizeof(text), "%.9g", sum);
+	sample(out, "_sum", NULL, text);
+	snprintf(text, sizeof(text), "%u", (unsigned)total);
+	sample(out, "_count", NULL, text);
+}
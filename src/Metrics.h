@@ -0,0 +1,145 @@
+/*
+	Metrics Registry
+*/
+#ifndef _METRICS_h
+#define _METRICS_h
+
+#include <Arduino.h>
+#include <atomic>
+
+typedef enum
+{
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM
+} METRICTYPE;
+
+/**
+ * metric in Prometheus text format
+ * metrics register themselves on construction, define them as static objects or create them during setup
+ * metrics of the same name form a family with different labels
+ * updates are lock-free atomic operations and may happen on any task
+ */
+class Metric
+{
+  public:
+	/**
+	 * @param labels label list without braces, e.g. route="/status"
+	 */
+	Metric(const char *name, const char *help, METRICTYPE type, const String &labels = String());
+	virtual ~Metric() {}
+
+	/**
+	 * write all metrics (text format 0.0.4)
+	 */
+	static void writeAll(Print &out);
+
+	const String &getLabels() const { return labels; }
+
+  protected:
+	virtual void write(Print &out) const = 0;
+	void sample(Print &out, const char *suffix, const char *label, const char *value) const;
+
+	const char *name;
+	const char *help;
+	METRICTYPE type;
+	String labels;
+
+  private:
+	Metric *next;
+	static Metric *first;
+};
+
+/**
+ * monotonic counter
+ */
+class Counter : public Metric
+{
+  public:
+	Counter(const char *name, const char *help, const String &labels = String())
+		: Metric(name, help, METRIC_COUNTER, labels), value(0) {}
+
+	void inc(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+
+  protected:
+	void write(Print &out) const;
+
+  private:
+	std::atomic<uint32_t> value;
+};
+
+/**
+ * counters of one name for a fixed list of label values, e.g. one per message type
+ */
+class CounterArray : public Metric
+{
+  public:
+	CounterArray(const char *name, const char *help, const char *label, const char *const *values, uint8_t count);
+
+	void inc(uint8_t index, uint32_t n = 1)
+	{
+		if (index < count)
+			counters[index].fetch_add(n, std::memory_order_relaxed);
+	}
+
+  protected:
+	void write(Print &out) const;
+
+  private:
+	const char *label;
+	const char *const *values;
+	uint8_t count;
+	std::atomic<uint32_t> *counters;
+};
+
+/**
+ * value that can go up and down, set by the owner or read at scrape time
+ */
+class Gauge : public Metric
+{
+  public:
+	typedef int32_t (*ReadFunction)();
+
+	Gauge(const char *name, const char *help, ReadFunction read = NULL, const String &labels = String())
+		: Metric(name, help, METRIC_GAUGE, labels), read(read), value(0) {}
+
+	void set(int32_t v) { value.store(v, std::memory_order_relaxed); }
+
+  protected:
+	void write(Print &out) const;
+
+  private:
+	ReadFunction read;
+	std::atomic<int32_t> value;
+};
+
+/**
+ * distribution over fixed buckets
+ * a histogram with labels is written from its first observation on, so a family with many label values stays small
+ */
+class Histogram : public Metric
+{
+  public:
+	static const uint8_t MAX_BUCKETS = 12;
+
+	/**
+	 * @param bounds upper bounds of the buckets in ascending order, in units of observe()
+	 * @param scale factor from units of observe() to the exported unit, e.g. 1e-6 for [us] to seconds
+	 */
+	Histogram(const char *name, const char *help, const uint32_t *bounds, uint8_t count, double scale = 1, const String &labels = String());
+
+	void observe(uint32_t value);
+
+  protected:
+	void write(Print &out) const;
+
+  private:
+	const uint32_t *bounds;
+	uint8_t count;
+	double scale;
+	std::atomic<uint32_t> buckets[MAX_BUCKETS + 1]; // last bucket: above all bounds
+	std::atomic<uint32_t> sumLow;
+	std::atomic<uint32_t> sumHigh; // carry of sumLow
+};
+
+#endif // _METRICS_h
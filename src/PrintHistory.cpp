@@ -0,0 +1,184 @@
+/*
+	SparkMaker Print History
+*/
+#include "PrintHistory.h"
+
+void PrintHistory::start(uint32_t now)
+{
+	*this = PrintHistory();
+	running = true;
+	startTime = now;
+}
+
+void PrintHistory::layer(int32_t layer, int32_t total, uint32_t now)
+{
+	if (!running)
+		return;
+	if (layer < currentLayer)
+		start(now); // new print without start message
+	if (total > 0)
+		totalLayers = total;
+	if (layer == currentLayer)
+		return; // status request repeats the current layer
+
+	uint32_t active = activeTime(now);
+	if (currentLayer == 0 && layer > 1)
+	{
+		// connected during a print, the time of earlier layers is unknown
+		if (layer > MAX_BOTTOM_LAYERS)
+			bottom = false;
+	}
+	else
+	{
+		if (!count)
+			firstLayer = currentLayer + 1;
+		int32_t layers = layer - currentLayer;
+		uint32_t duration = (active - layerStart) / layers;
+		for (int32_t i = 0; i < layers; i++)
+			record(duration);
+	}
+	currentLayer = layer;
+	layerStart = active;
+}
+
+void PrintHistory::record(uint32_t duration)
+{
+	// timing series
+	if (count < HISTORY_SIZE)
+	{
+		durations[(head + count) % HISTORY_SIZE] = duration;
+		count++;
+	}
+	else
+	{
+		durations[head] = duration;
+		head = (head + 1) % HISTORY_SIZE;
+		firstLayer++;
+	}
+
+	if (bottom)
+	{
+		if (bottomLayers && duration * 3 < bottomTime / bottomLayers * 2)
+		{
+			bottom = false;
+		}
+		else if (bottomLayers >= MAX_BOTTOM_LAYERS)
+		{
+			// no long bottom exposure
+			bottom = false;
+			layerTime = bottomTime / bottomLayers;
+			normalLayers = bottomLayers;
+			bottomLayers = 0;
+			bottomTime = 0;
+		}
+		else
+		{
+			bottomLayers++;
+			bottomTime += duration;
+			return;
+		}
+	}
+
+	if (!normalLayers)
+	{
+		layerTime = duration;
+		layerDeviation = 0;
+	}
+	else
+	{
+		// limit the weight of single slow layers
+		if (duration > 2 * layerTime)
+			duration = 2 * layerTime;
+		int32_t diff = (int32_t)duration - (int32_t)layerTime;
+		layerTime += diff / 8;
+		layerDeviation += ((int32_t)abs(diff) - (int32_t)layerDeviation) / 8;
+	}
+	if (normalLayers < UINT16_MAX)
+		normalLayers++;
+}
+
+void PrintHistory::pause(uint32_t now)
+{
+	if (running && !finishTime && !pauseStart)
+		pauseStart = now;
+}
+
+void PrintHistory::resume(uint32_t now)
+{
+	if (!pauseStart)
+		return;
+	pausedTime += now - pauseStart;
+	pauseStart = 0;
+}
+
+bool PrintHistory::finish(uint32_t now)
+{
+	if (!running || finishTime)
+		return false;
+	resume(now);
+	finishTime = now;
+	return true;
+}
+
+uint32_t PrintHistory::activeTime(uint32_t now) const
+{
+	if (!running)
+		return 0;
+	uint32_t end = finishTime ? finishTime : now;
+	uint32_t time = end - startTime - pausedTime;
+	if (pauseStart)
+		time -= end - pauseStart;
+	return time;
+}
+
+uint32_t PrintHistory::remaining(uint32_t now) const
+{
+	if (!running || finishTime || totalLayers <= currentLayer)
+		return 0;
+
+	// bottom layers take several times longer than the others, no estimate before the first normal layer
+	if (bottom || !normalLayers)
+		return 0;
+
+	// the next layer is in progress since the last report
+	uint32_t perLayer = layerTime;
+	uint32_t time = (totalLayers - currentLayer) * perLayer;
+	uint32_t elapsed = activeTime(now) - layerStart;
+	return time - (elapsed < perLayer ? elapsed : perLayer);
+}
+
+float PrintHistory::confidence() const
+{
+	if (!running || totalLayers <= 0)
+		return 0;
+	if (finishTime)
+		return 1;
+	if (bottom)
+		return 0;
+
+	float samples = normalLayers / (normalLayers + 4.0f);
+	float spread = layerTime ? 1.0f - (float)layerDeviation / layerTime : 0;
+	if (spread < 0)
+		spread = 0;
+	return samples * spread;
+}
+
+void PrintHistory::toJson(JsonDocument &json, uint32_t now) const
+{
+	json["layer"] = currentLayer;
+	json["totalLayers"] = totalLayers;
+	json["activeTime"] = activeTime(now) / 1000;
+	json["pausedTime"] = (pausedTime + (pauseStart ? now - pauseStart : 0)) / 1000;
+	json["remainingTime"] = remaining(now) / 1000;
+	json["confidence"] = (int)(confidence() * 100 + 0.5) / 100.0;
+	json["bottomLayers"] = bottomLayers;
+	json["bottomLayerTime"] = bottomLayers ? bottomTime / bottomLayers : 0;
+	json["layerTime"] = layerTime;
+	json["layerDeviation"] = layerDeviation;
+
+	// compact series: exposure time [ms] of consecutive layers starting at firstLayer
+	json["firstLayer"] = firstLayer;
+	JsonArray series = json.createNestedArray("layerTimes");
+	for (uint8_t i = 0; i < count; i++)
+		series.add(durations[(head + i) % HISTORY_SIZE]);
+}
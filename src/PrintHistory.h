@@ -0,0 +1,98 @@
+/*
+	SparkMaker Print History
+*/
+#ifndef _PRINTHISTORY_h
+#define _PRINTHISTORY_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * layer timing of the current print and the remaining time estimate
+ * the exposure time of each layer is kept in a ring buffer, paused time is not counted
+ * bottom layers are the leading layers with long exposure, they end with the first layer taking less than 2/3 of their average
+ * the remaining time is estimated from the smoothed time of normal layers
+ * plain data, copied as a whole by SparkMaker::getHistory()
+ */
+class PrintHistory
+{
+  public:
+	static const uint8_t HISTORY_SIZE = 128; // layers in the timing series
+	static const uint8_t MAX_BOTTOM_LAYERS = 20; // longer leading runs of equal layers are normal layers
+	static const size_t JSON_SIZE = JSON_OBJECT_SIZE(16) + JSON_ARRAY_SIZE(HISTORY_SIZE);
+
+	/**
+	 * print started
+	 */
+	void start(uint32_t now);
+
+	/**
+	 * layer reported (F/S=), skipped layers share the time since the last report
+	 */
+	void layer(int32_t layer, int32_t total, uint32_t now);
+
+	void pause(uint32_t now);
+	void resume(uint32_t now);
+
+	/**
+	 * print finished or stopped
+	 * @return false if no print was running
+	 */
+	bool finish(uint32_t now);
+
+	/**
+	 * print time without pauses [ms]
+	 */
+	uint32_t activeTime(uint32_t now) const;
+
+	uint32_t getStartTime() const { return startTime; }
+	uint32_t getPausedTime() const { return pausedTime; } // closed pauses [ms]
+	int32_t getLayer() const { return currentLayer; }
+	int32_t getTotalLayers() const { return totalLayers; }
+
+	/**
+	 * estimated remaining print time [ms], 0 if unknown
+	 */
+	uint32_t remaining(uint32_t now) const;
+
+	/**
+	 * reliability of the estimate, 0 (unknown) .. 1
+	 */
+	float confidence() const;
+
+	/**
+	 * add estimate and timing series to JSON document
+	 */
+	void toJson(JsonDocument &json, uint32_t now) const;
+
+  private:
+	void record(uint32_t duration);
+
+	bool running = false;
+	uint32_t startTime = 0;	 // [ms]
+	uint32_t finishTime = 0; // [ms], 0 while running
+	uint32_t pausedTime = 0; // total pause [ms]
+	uint32_t pauseStart = 0; // [ms], 0 if not paused
+
+	int32_t currentLayer = 0;
+	int32_t totalLayers = 0;
+	uint32_t layerStart = 0; // active time of the last layer report [ms]
+
+	// bottom layers
+	bool bottom = true;
+	uint16_t bottomLayers = 0;
+	uint32_t bottomTime = 0; // sum [ms]
+
+	// normal layers, exponential moving average
+	uint16_t normalLayers = 0;
+	uint32_t layerTime = 0;	   // [ms]
+	uint32_t layerDeviation = 0; // mean absolute deviation [ms]
+
+	// timing series, layer firstLayer + i took durations[(head + i) % HISTORY_SIZE]
+	uint32_t durations[HISTORY_SIZE] = {0};
+	uint8_t head = 0;
+	uint8_t count = 0;
+	int32_t firstLayer = 0;
+};
+
+#endif // _PRINTHISTORY_h
@@ -0,0 +1,175 @@
+/*
+	SparkMaker Printer Registry
+*/
+#include "PrinterRegistry.h"
+#include <BLEDevice.h>
+#include <BLEScan.h>
+
+// config
+#include "Settings.h"
+
+static BLEUUID SparkMakerServiceUUID("0000fff0-0000-1000-8000-00805f9b34fb");
+static BLEScan *pBLEScan = NULL;
+
+SparkMaker *PrinterRegistry::printers[MAX_PRINTERS] = {NULL};
+uint8_t PrinterRegistry::printerCount = 0;
+uint32_t PrinterRegistry::scanTime = 0;
+JobLog PrinterRegistry::jobLog;
+
+/**
+ * callback class for BLE advertised devices
+ */
+class PrinterRegistry::AdvertisedDeviceCallbacks : public BLEAdvertisedDeviceCallbacks
+{
+
+	/**
+   * called on advertisement
+   */
+	void onResult(BLEAdvertisedDevice advertisedDevice)
+	{
+		Serial.print("BLE Advertised Device found: ");
+		Serial.print(advertisedDevice.toString().c_str()); Serial.print(", RSSI "); Serial.println( advertisedDevice.getRSSI() );
+
+		// check for SparkMaker services
+		if (advertisedDevice.isAdvertisingService(SparkMakerServiceUUID))
+			assign(advertisedDevice);
+	}
+};
+
+/**
+ * scans run in the background, found devices are handled by AdvertisedDeviceCallbacks
+ */
+static void bleScanComplete(BLEScanResults results)
+{
+}
+
+/**
+ * hand found printer to its slot, called from the BLE task
+ */
+void PrinterRegistry::assign(BLEAdvertisedDevice &device)
+{
+	std::string address = device.getAddress().toString();
+
+	// a printer keeps its slot, a new printer takes the first slot that never had one
+	SparkMaker *slot = NULL;
+	for (uint8_t i = 0; i < printerCount && !slot; i++)
+	{
+		if (printers[i]->getAddress() == address)
+			slot = printers[i];
+	}
+	for (uint8_t i = 0; i < printerCount && !slot; i++)
+	{
+		if (printers[i]->getAddress().empty())
+			slot = printers[i];
+	}
+	if (!slot || !slot->isScanning())
+		return;
+
+	// stop scanning, the connection is set up by the printer loop
+	if ( pBLEScan )
+		pBLEScan->stop();
+	Serial.print("printer ");
+	Serial.print(slot->getId());
+	Serial.print(": ");
+	Serial.println(address.c_str());
+	slot->found(device);
+}
+
+/**
+ * printer owning the characteristic
+ */
+SparkMaker *PrinterRegistry::find(const BLERemoteCharacteristic *characteristic)
+{
+	for (uint8_t i = 0; i < printerCount; i++)
+	{
+		if (printers[i]->getNotifyCharacteristic() == characteristic)
+			return printers[i];
+	}
+	return NULL;
+}
+
+/**
+ * BLE callback
+ * received subscribed data, dispatched to the printer
+ */
+void PrinterRegistry::notifyCallback(BLERemoteCharacteristic *characteristic, uint8_t *data, size_t length, bool isNotify)
+{
+	SparkMaker *spark = find(characteristic);
+	if (!spark)
+	{
+		Serial.println("FAILURE: notification of unknown printer");
+		return;
+	}
+	spark->notify(data, length);
+}
+
+/**
+ * SparkMaker BLE Interface setup
+ */
+void PrinterRegistry::setup()
+{
+	jobLog.begin();
+
+	// start Bluetooth Low Energy
+	BLEDevice::init(settings.hostname.c_str());
+
+	// printers, set to scanning before the scan callback may report a printer
+	printerCount = settings.SparkMaker.maxPrinters < MAX_PRINTERS ? settings.SparkMaker.maxPrinters : MAX_PRINTERS;
+	for (uint8_t i = 0; i < printerCount; i++)
+	{
+		printers[i] = new SparkMaker(i);
+		printers[i]->connect();
+	}
+
+	// get BLE scanner object
+	pBLEScan = BLEDevice::getScan();
+	pBLEScan->setAdvertisedDeviceCallbacks(new AdvertisedDeviceCallbacks);
+	pBLEScan->setWindow(2000);
+	pBLEScan->setInterval(200);
+	pBLEScan->setActiveScan(true);
+	pBLEScan->clearResults();
+
+	scanTime = millis();
+	pBLEScan->start(2, bleScanComplete);
+}
+
+/**
+ * scan for missing printers and run all printers
+ */
+void PrinterRegistry::loop()
+{
+	uint32_t time = millis();
+	bool scanning = false;
+	for (uint8_t i = 0; i < printerCount; i++)
+	{
+		scanning = scanning || printers[i]->isScanning();
+		printers[i]->loop();
+	}
+
+	if ( scanning && (time - scanTime) > SCAN_INTERVAL && pBLEScan )
+	{
+		Serial.println("scan BLE");
+		pBLEScan->start(1, bleScanComplete);
+		scanTime = time;
+	}
+}
+
+SparkMaker &PrinterRegistry::get(uint8_t id)
+{
+	return *printers[id < printerCount ? id : 0];
+}
+
+void PrinterRegistry::toJson(JsonArray list)
+{
+	static PrinterSnapshot snapshot;
+	for (uint8_t i = 0; i < printerCount; i++)
+	{
+		printers[i]->getSnapshot(snapshot);
+		JsonObject entry = list.createNestedObject();
+		entry["id"] = i;
+		std::string address = printers[i]->getAddress();
+		entry["address"] = (char *)address.c_str(); // copied
+		entry["status"] = statusNames[snapshot.status];
+		entry["currentFile"] = (char *)snapshot.currentFile; // copied
+	}
+}
@@ -0,0 +1,71 @@
+/*
+	SparkMaker Printer Registry
+*/
+#ifndef _PRINTERREGISTRY_h
+#define _PRINTERREGISTRY_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "SparkMaker.h"
+#include "JobLog.h"
+
+/**
+ * printers connected at the same time, each with its own BLE connection, state and command queue
+ * one BLE scan serves all printers: a found printer is assigned to the slot that knows its address,
+ * else to the first free slot, so a printer keeps its id after a reconnect
+ * ids are given in order of discovery, 0 is the first printer found
+ */
+class PrinterRegistry
+{
+  public:
+	/**
+	 * BLE client connections of the ESP32 controller (CONFIG_BTDM_CTRL_BLE_MAX_CONN of the Arduino core)
+	 */
+	static const uint8_t MAX_PRINTERS = 3;
+	static const uint32_t SCAN_INTERVAL = 3500; // pause between scans while a slot is free [ms]
+
+	/**
+	 * start BLE, create settings.SparkMaker.maxPrinters printers and scan for them
+	 */
+	static void setup();
+
+	/**
+	 * scan while a printer is missing and run all printers
+	 */
+	static void loop();
+
+	/**
+	 * number of printer slots
+	 */
+	static uint8_t count() { return printerCount; }
+
+	/**
+	 * printer by id, the first printer if the id is out of range
+	 */
+	static SparkMaker &get(uint8_t id = 0);
+
+	/**
+	 * log of finished and stopped prints of all printers
+	 */
+	static JobLog &getJobLog() { return jobLog; }
+
+	/**
+	 * add id, address and state of all printers to JSON array
+	 */
+	static void toJson(JsonArray list);
+
+  private:
+	friend class SparkMaker;
+	class AdvertisedDeviceCallbacks;
+
+	static void assign(BLEAdvertisedDevice &device);
+	static SparkMaker *find(const BLERemoteCharacteristic *characteristic);
+	static void notifyCallback(BLERemoteCharacteristic *characteristic, uint8_t *data, size_t length, bool isNotify);
+
+	static SparkMaker *printers[MAX_PRINTERS];
+	static uint8_t printerCount;
+	static uint32_t scanTime;
+	static JobLog jobLog;
+};
+
+#endif // _PRINTERREGISTRY_h
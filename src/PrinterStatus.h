@@ -0,0 +1,26 @@
+/*
+	SparkMaker Printer Status
+*/
+#ifndef _PRINTERSTATUS_h
+#define _PRINTERSTATUS_h
+
+typedef enum
+{
+	DISCONNECTED,
+	CONNECTING,
+	STANDBY,
+	FILELIST,
+	PRINTING,
+	PAUSE,
+	FINISHED,
+	STOPPING,
+	NO_CARD,
+	UPDATING
+} PRINTERSTATUS;
+
+/**
+ * string names for printer status
+ */
+extern const char *statusNames[];
+
+#endif // _PRINTERSTATUS_h
@@ -0,0 +1,111 @@
+/*
+	Typed Config
+*/
+#include "Settings.h"
+#include <type_traits>
+
+#ifdef ESP8266
+static inline uint32_t ESP_getChipId() { return ESP.getChipId(); }
+#else //ESP32
+static inline uint32_t ESP_getChipId() { return (uint32_t)ESP.getEfuseMac(); }
+#endif
+
+Settings settings;
+std::vector<Settings::Listener> Settings::listeners;
+
+/**
+ * number in range [min, max] or default
+ */
+template <typename T>
+static T readNumber(JsonVariantConst obj, const char *section, const char *name, T def, long min, long max, uint8_t &errors)
+{
+	JsonVariantConst value = obj[name];
+	if (value.isNull())
+		return def;
+	if (std::is_same<T, bool>::value && value.is<bool>())
+		return (T)value.as<bool>();
+	if (value.is<long>() && value.as<long>() >= min && value.as<long>() <= max)
+		return (T)value.as<long>();
+
+	Serial.print("config: invalid value for ");
+	if (section)
+	{
+		Serial.print(section);
+		Serial.print(".");
+	}
+	Serial.println(name);
+	errors++;
+	return def;
+}
+
+static String readString(JsonVariantConst obj, const char *section, const char *name, const char *def, uint8_t &errors)
+{
+	JsonVariantConst value = obj[name];
+	if (value.isNull())
+		return def;
+	if (value.is<const char *>())
+		return value.as<const char *>();
+
+	Serial.print("config: invalid value for ");
+	if (section)
+	{
+		Serial.print(section);
+		Serial.print(".");
+	}
+	Serial.println(name);
+	errors++;
+	return def;
+}
+
+#define CONFIG_INIT_NUM(type, name, def, min, max) s.name = def;
+#define CONFIG_INIT_STR(name, def) s.name = def;
+#define CONFIG_INIT_SECTION(section, schema)     \
+	{                                            \
+		auto &s = this->section;                 \
+		schema(CONFIG_INIT_NUM, CONFIG_INIT_STR) \
+	}
+
+Settings::Settings()
+{
+	{
+		Settings &s = *this;
+		CONFIG_SCHEMA_ROOT(CONFIG_INIT_NUM, CONFIG_INIT_STR)
+	}
+	CONFIG_SCHEMA_SECTIONS(CONFIG_INIT_SECTION)
+}
+
+#define CONFIG_LOAD_NUM(type, name, def, min, max) s.name = readNumber<type>(obj, section, #name, def, min, max, errors);
+#define CONFIG_LOAD_STR(name, def) s.name = readString(obj, section, #name, def, errors);
+#define CONFIG_LOAD_SECTION(section_, schema)    \
+	{                                            \
+		auto &s = this->section_;                \
+		const char *section = #section_;         \
+		JsonVariantConst obj = json[section];    \
+		schema(CONFIG_LOAD_NUM, CONFIG_LOAD_STR) \
+	}
+
+uint8_t Settings::load(JsonObjectConst json)
+{
+	uint8_t errors = 0;
+	{
+		Settings &s = *this;
+		const char *section = NULL;
+		JsonVariantConst obj = json;
+		CONFIG_SCHEMA_ROOT(CONFIG_LOAD_NUM, CONFIG_LOAD_STR)
+	}
+	CONFIG_SCHEMA_SECTIONS(CONFIG_LOAD_SECTION)
+
+	// values depending on the device
+	if (!hostname.length())
+		hostname = "ESP-" + String(ESP_getChipId());
+	return errors;
+}
+
+uint8_t Settings::reload(JsonObjectConst json)
+{
+	Settings previous = *this;
+	uint8_t errors = load(json);
+	for (size_t i = 0; i < listeners.size(); i++)
+		listeners[i](*this, previous);
+	return errors;
+}
@@ -0,0 +1,82 @@
+/*
+	Typed Config
+*/
+#ifndef _SETTINGS_h
+#define _SETTINGS_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <vector>
+#include "ConfigSchema.h"
+
+#define CONFIG_FIELD_NUM(type, name, def, min, max) type name;
+#define CONFIG_FIELD_STR(name, def) String name;
+#define CONFIG_DEFAULT_NUM(type, name, def, min, max) constexpr type name = def;
+#define CONFIG_DEFAULT_STR(name, def) constexpr const char *name = def;
+
+/**
+ * compile time defaults, e.g. ConfigDefaults::CaptivePortal::portalTimeout
+ */
+namespace ConfigDefaults
+{
+CONFIG_SCHEMA_ROOT(CONFIG_DEFAULT_NUM, CONFIG_DEFAULT_STR)
+#define CONFIG_DEFAULT_SECTION(section, schema)   \
+	namespace section                              \
+	{                                              \
+	schema(CONFIG_DEFAULT_NUM, CONFIG_DEFAULT_STR) \
+	}
+CONFIG_SCHEMA_SECTIONS(CONFIG_DEFAULT_SECTION)
+#undef CONFIG_DEFAULT_SECTION
+} // namespace ConfigDefaults
+
+/**
+ * config.json as plain fields, e.g. settings.CaptivePortal.portalTimeout
+ * loaded once after the config files were read, handlers read fields instead of walking the JSON tree
+ * the dynamic parts (Credentials) stay in the JSON document
+ */
+class Settings
+{
+  public:
+	/**
+	 * called after (re)load with new and previous values
+	 */
+	typedef std::function<void(const Settings &settings, const Settings &previous)> Listener;
+
+	CONFIG_SCHEMA_ROOT(CONFIG_FIELD_NUM, CONFIG_FIELD_STR)
+#define CONFIG_FIELD_SECTION(section, schema)   \
+	struct                                       \
+	{                                            \
+		schema(CONFIG_FIELD_NUM, CONFIG_FIELD_STR) \
+	} section;
+	CONFIG_SCHEMA_SECTIONS(CONFIG_FIELD_SECTION)
+#undef CONFIG_FIELD_SECTION
+
+	/**
+	 * defaults of the schema
+	 */
+	Settings();
+
+	/**
+	 * read values from JSON, missing keys get the default
+	 * @return number of invalid values replaced by the default
+	 */
+	uint8_t load(JsonObjectConst json);
+
+	/**
+	 * load and notify listeners
+	 */
+	uint8_t reload(JsonObjectConst json);
+
+	/**
+	 * listeners are notified on every reload, register before the config is loaded to get the initial values
+	 */
+	void onChange(Listener listener) { listeners.push_back(listener); }
+
+  private:
+	static std::vector<Listener> listeners; // not part of the copy passed as previous
+};
+
+extern Settings settings;
+
+#endif // _SETTINGS_h
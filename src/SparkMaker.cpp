@@ -4,46 +4,32 @@
 #include <BLEScan.h>
 #include "BLEUtils.h"
 
-#include "SparkMaker.h"
+#include <atomic>
+#include <stddef.h>
 
-// JSON
-#include <ArduinoJson.h>
-extern DynamicJsonDocument config;
+#include "SparkMaker.h"
+#include "PrinterRegistry.h"
+#include "Metrics.h"
 
-// SparkMaker defaults
-const static struct
-{
-	uint16_t statusRequestInterval = 20;	// periodic status request [s]
-} defaultConfig;
-static unsigned long statusRequestInterval;
+// config
+#include "Settings.h"
+#include "BootProfiler.h"
+#include "LoopProfiler.h"
 
 
 // SparkMaker remote service
-static BLEUUID SparkMakerServiceUUID("0000fff0-0000-1000-8000-00805f9b34fb");
 static BLEUUID SparkMakerServiceRxUUID("0000ffe0-0000-1000-8000-00805f9b34fb");
 static BLEUUID SparkMakerCharRxUUID("0000ffe4-0000-1000-8000-00805f9b34fb");
 static BLEUUID SparkMakerServiceTxUUID("0000ffe5-0000-1000-8000-00805f9b34fb");
 static BLEUUID SparkMakerCharTxUUID("0000ffe9-0000-1000-8000-00805f9b34fb");
 
-static BLEAdvertisedDevice *sparkMakerBLEDevice = NULL;
-static BLEClient *client = NULL;
-static BLERemoteCharacteristic *txCharacteristic = NULL;
-static BLERemoteCharacteristic *rxCharacteristic = NULL;
-typedef enum
-{
-	NA,
-	OFFLINE,
-	SCANNING,
-	FOUND,
-	CONNECT,
-	HANDSHAKE,
-	ONLINE,
-	READ_FILES
-} BLESTATE;
-static BLESTATE bleState = NA;
-static uint32_t bleScantime = 0;
-static BLEScan *pBLEScan = NULL;
-
+// metrics, summed over all printers
+static Counter bleNotifications("sparkmaker_ble_notifications_total", "BLE notifications received from the printer");
+static Counter bleNotificationBytes("sparkmaker_ble_notification_bytes_total", "bytes received in BLE notifications");
+static CounterArray bleMessages("sparkmaker_ble_messages_total", "printer messages by type", "type", messageNames, MSG_COUNT);
+static CounterArray bleMessageBytes("sparkmaker_ble_message_bytes_total", "bytes of printer messages by type", "type", messageNames, MSG_COUNT);
+static Counter bleConnects("sparkmaker_ble_connects_total", "successful BLE connections to the printer");
+static Counter bleDisconnects("sparkmaker_ble_disconnects_total", "BLE connections to the printer closed or lost");
 
 /**
  * string names for WiFi encryption
@@ -61,262 +47,370 @@ const char *statusNames[] = {
 	"UPDATING"
 };
 
+
+SparkMaker::SparkMaker(uint8_t id)
+	: id(id), device(NULL), client(NULL), txCharacteristic(NULL), rxCharacteristic(NULL), bleState(NA),
+	  connecting(false), pendingState(NA),
+	  commands(writeCommand, this), jobEnded(false), jobOutcome(JOB_FINISHED), stopOutcome(JOB_STOPPED),
+	  snapshotSequence(0), filesChanged(false)
+{
+	printerLock = xSemaphoreCreateMutex();
+	files = std::make_shared<const PrinterFileList>();
+	commands.setUrgentBudget(settings.SparkMaker.emergencyBudget * 1000UL);
+}
+
 /**
- * callback class for BLE advertised devices
+ * write command to the printer
+ * the printer answers with OK or status messages, a write response would only add a connection interval per command
  */
-class AdvertisedDeviceCallbacks : public BLEAdvertisedDeviceCallbacks
+bool SparkMaker::writeCommand(void *context, const String &cmd)
 {
+	BLERemoteCharacteristic *tx = ((SparkMaker *)context)->txCharacteristic;
+	if (!tx)
+		return false;
+	tx->writeValue((uint8_t *)cmd.c_str(), cmd.length(), !tx->canWriteNoResponse());
+	return true;
+}
 
-	/**
-   * called on advertisement
-   */
-	void onResult(BLEAdvertisedDevice advertisedDevice)
+/**
+ * publish printer state if it has changed
+ * called with printerLock held
+ */
+void SparkMaker::publishSnapshot()
+{
+	PrinterSnapshot &next = nextSnapshot;
+
+	next.status = printer.status;
+	next.currentLayer = printer.currentLayer;
+	next.totalLayers = printer.totalLayers;
+	next.startTime = printer.startTime;
+	next.finishTime = printer.finishTime;
+	strncpy(next.currentFile, printer.currentFile.c_str(), sizeof(next.currentFile) - 1);
+
+	if (filesChanged)
+	{
+		// new file list, readers keep the previous one as long as they use it
+		std::shared_ptr<PrinterFileList> list = std::make_shared<PrinterFileList>();
+		list->reserve(printer.filenames.size());
+		for (auto const &file : printer.filenames)
+			list->push_back(file.first);
+		std::atomic_store(&files, std::shared_ptr<const PrinterFileList>(list));
+	}
+	else
 	{
-		Serial.print("BLE Advertised Device found: ");
-		Serial.print(advertisedDevice.toString().c_str()); Serial.print(", RSSI "); Serial.println( advertisedDevice.getRSSI() );
-
-		// check for SparkMaker services
-		if (advertisedDevice.isAdvertisingService(SparkMakerServiceUUID))
-		{
-			// stop scanning
-			if ( pBLEScan )
-				pBLEScan->stop();
-
-			// create device
-			if (sparkMakerBLEDevice)
-				delete sparkMakerBLEDevice;
-			sparkMakerBLEDevice = new BLEAdvertisedDevice(advertisedDevice);
-
-			bleState = FOUND;
-		}
+		// compare state fields
+		const size_t begin = offsetof(PrinterSnapshot, status);
+		const size_t end = sizeof(PrinterSnapshot);
+		if (memcmp((const uint8_t *)&next + begin, (const uint8_t *)&publishedSnapshot + begin, end - begin) == 0)
+			return;
 	}
-};
+	filesChanged = false;
+
+	// write snapshot
+	uint32_t sequence = snapshotSequence.load(std::memory_order_relaxed);
+	next.epoch = (sequence >> 1) + 1;
+	snapshotSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&publishedSnapshot, &next, sizeof(publishedSnapshot));
+	snapshotSequence.store(sequence + 2, std::memory_order_release);
+}
 
 /**
- * BLE callback
- * received subscribed data
+ * scoped printer update
+ * serializes writers of SparkMaker::printer and publishes the changes when leaving the scope
  */
-static void notifyCallback(BLERemoteCharacteristic *characteristic, uint8_t *data, size_t length, bool isNotify)
+class SparkMaker::PrinterUpdate
 {
-	const size_t BUFFER_SIZE = 256;
-	static char buffer[BUFFER_SIZE];
-	static uint16_t buffer_pos = 0;
-
-	// sanity check
-	if (!txCharacteristic)
+  public:
+	PrinterUpdate(SparkMaker &spark) : spark(spark)
 	{
-		Serial.println("FAILURE: notification without txCharacteristic");
-		bleState = SCANNING;
-		return;
+		xSemaphoreTake(spark.printerLock, portMAX_DELAY);
 	}
 
-	// append to buffer
-	int16_t len = BUFFER_SIZE - buffer_pos - 2;
-	if ( len < 0 )
+	~PrinterUpdate()
 	{
-		buffer_pos = 0;
-		buffer[buffer_pos] = 0x00;
+		spark.publishSnapshot();
+		xSemaphoreGive(spark.printerLock);
 	}
-	if (length < len)
-		len = length;
-	memcpy(buffer + buffer_pos, data, len);
-	buffer_pos = buffer_pos + len;
-	buffer[buffer_pos] = 0x00;
 
-	// do we have a complete line?
-	char *ptr = strchr(buffer, '\n');
-	if (!ptr)
+  private:
+	SparkMaker &spark;
+};
+
+/**
+ * scoped read access to SparkMaker::printer and the print history from other tasks
+ */
+class SparkMaker::PrinterLock
+{
+  public:
+	PrinterLock(SparkMaker &spark) : spark(spark)
 	{
-		// only partial line received, wait for more data
-		return;
+		xSemaphoreTake(spark.printerLock, portMAX_DELAY);
 	}
-	*ptr = 0x00;	// terminate string
-	buffer_pos = 0; // buffer will be processed, next data will start a new line
 
-	// heartbeat
-	if (strcmp(buffer, "online") == 0)
+	~PrinterLock()
 	{
-		SparkMaker::printer.heartbeat = millis();
-		return;
+		xSemaphoreGive(spark.printerLock);
 	}
 
-	// handshake
-	if (strncmp(buffer, "P-", 2) == 0)
+  private:
+	SparkMaker &spark;
+};
+
+/**
+ * clear file list
+ * called with printerLock held
+ */
+void SparkMaker::clearFiles()
+{
+	if (printer.filenames.empty())
+		return;
+	printer.filenames.clear();
+	filesChanged = true;
+}
+
+/**
+ * apply decoded printer message
+ */
+void SparkMaker::handleMessage(const SparkMakerMessage &msg, const char *line)
+{
+	switch (msg.type)
 	{
+	case MSG_HEARTBEAT:
+		printer.heartbeat = millis();
+		break;
+
+	case MSG_HANDSHAKE:
 		if (bleState < HANDSHAKE)
 		{
 			// send acknowledgement
 			Serial.println("schedule handshake ... ");
 			bleState = HANDSHAKE;
-			SparkMaker::printer.status = CONNECTING;
+			printer.status = CONNECTING;
 		}
-		return;
-	}
+		break;
 
-	// selected file
-	if (strncmp(buffer, "pf_", 3) == 0)
-	{
-		char *filename = buffer + 3;
-		SparkMaker::printer.currentFile = filename;
-		return;
-	}
+	case MSG_SELECTED_FILE:
+		printer.currentFile.assign(msg.text, msg.length);
+		break;
 
-	// file list
-	if (strncmp(buffer, "f-", 2) == 0)
-	{
-		char *filename = buffer + 2;
-		// read file index from message
-		ptr = strrchr(filename, '.');
-		if (ptr)
+	case MSG_FILE_ENTRY:
+		if (msg.value >= 0)
 		{
-			*ptr = 0x00;
-			ptr++;
-			uint16_t id = 0;
-			id = atoi(ptr);
+			std::string filename(msg.text, msg.length);
 			Serial.print("file list: #");
-			Serial.print(id);
+			Serial.print(msg.value);
 			Serial.print(" ");
-			Serial.println(filename);
+			Serial.println(filename.c_str());
 
 			// add filename to file list
-			SparkMaker::printer.filenames.insert(std::pair<std::string, uint16_t>(filename, id));
+			printer.filenames.insert(std::pair<std::string, uint16_t>(filename, msg.value));
+			filesChanged = true;
 		}
-		return;
-	}
+		break;
 
-	// layer
-	if (strncmp(buffer, "F/S=", 4) == 0)
-	{
+	case MSG_LAYER:
 		Serial.print("layer: ");
-		ptr = buffer + 4;
-		SparkMaker::printer.currentLayer = atoi(ptr);
-		ptr = strchr(ptr, '/');
-		if ( ptr )
-			SparkMaker::printer.totalLayers = atoi(++ptr);
-		Serial.print(SparkMaker::printer.currentLayer); Serial.print('/'); Serial.println(SparkMaker::printer.totalLayers);
-		return;
-	}
+		printer.currentLayer = msg.value;
+		if (msg.total >= 0)
+			printer.totalLayers = msg.total;
+		Serial.print(printer.currentLayer); Serial.print('/'); Serial.println(printer.totalLayers);
+		if ( printer.status == PRINTING )
+			history.layer(msg.value, msg.total, millis());
+		break;
 
-	// standby
-	if (strcmp(buffer, "standby_sts") == 0)
-	{
+	case MSG_STANDBY:
 		Serial.println("STANDBY");
-
-		if ( SparkMaker::printer.status == NO_CARD )
+		if ( printer.status == NO_CARD )
 		{
 			// read SD Card
 			bleState = READ_FILES;
 		}
-		SparkMaker::printer.status = STANDBY;
-		return;
-	}
+		printer.status = STANDBY;
+		break;
 
-	// printing
-	if (strcmp(buffer, "printing_sts") == 0)
-	{
+	case MSG_PRINTING:
 		Serial.println("PRINTING");
-		if ( SparkMaker::printer.status != PRINTING )
+		if ( printer.status == PAUSE )
 		{
-			SparkMaker::printer.startTime = millis() / 1000;
-			SparkMaker::printer.finishTime = 0;
-			SparkMaker::printer.currentLayer = 0;
-			SparkMaker::printer.totalLayers = 0;
+			// resume acknowledgement missed
+			history.resume(millis());
 		}
-		SparkMaker::printer.status = PRINTING;
-		return;
-	}
+		else if ( printer.status != PRINTING )
+		{
+			printer.startTime = millis() / 1000;
+			printer.finishTime = 0;
+			printer.currentLayer = 0;
+			printer.totalLayers = 0;
+			history.start(millis());
+			stopOutcome = JOB_STOPPED;
+		}
+		printer.status = PRINTING;
+		break;
 
-	// pause
-	if (strcmp(buffer, "pause_sts") == 0)
-	{
+	case MSG_PAUSE:
 		Serial.println("PAUSE");
-		SparkMaker::printer.status = PAUSE;
-		return;
-	}
+		printer.status = PAUSE;
+		history.pause(millis());
+		break;
 
-	// resume
-	if (strcmp(buffer, "pause-over") == 0)
-	{
+	case MSG_RESUME:
 		Serial.println("PRINTING");
-		SparkMaker::printer.status = PRINTING;
-		return;
-	}
+		printer.status = PRINTING;
+		history.resume(millis());
+		break;
 
-	// STOP
-	if (strcmp(buffer, "stop_sts") == 0)
-	{
+	case MSG_STOP:
 		Serial.println("STOPPING");
-		SparkMaker::printer.status = STOPPING;
-		return;
-	}
+		printer.status = STOPPING;
+		if ( history.finish(millis()) )
+		{
+			jobOutcome = (JOBOUTCOME)stopOutcome.load();
+			jobEnded = true;
+		}
+		break;
 
-	// finished
-	if (strcmp(buffer, "printo_sts") == 0)
-	{
+	case MSG_FINISHED:
 		Serial.println("FINISHED");
-		SparkMaker::printer.status = FINISHED;
-		SparkMaker::printer.finishTime = millis() / 1000;
-		return;
-	}
+		// status requests repeat the message, keep the time of the first one
+		if ( printer.status != FINISHED )
+			printer.finishTime = millis() / 1000;
+		printer.status = FINISHED;
+		if ( history.finish(millis()) )
+		{
+			jobOutcome = JOB_FINISHED;
+			jobEnded = true;
+		}
+		break;
 
-	// no SD card
-	if (strcmp(buffer, "nocard_sts") == 0)
-	{
+	case MSG_NO_CARD:
 		Serial.println("NO_CARD");
-		SparkMaker::printer.status = NO_CARD;
-		SparkMaker::printer.filenames.clear();
-		return;
-	}
+		printer.status = NO_CARD;
+		clearFiles();
+		break;
 
-	// all files sent
-	if (strcmp(buffer, "scan-finish") == 0)
-	{
+	case MSG_SCAN_FINISH:
+		// all files sent, nothing to do
 		Serial.println("scan-finish");
-		// nothing to do
-		return;
-	}
+		break;
 
-	// update
-	if (strcmp(buffer, "update_sts") == 0)
-	{
+	case MSG_UPDATING:
 		Serial.println("UPDATING");
-		SparkMaker::printer.status = UPDATING;
-		return;
+		printer.status = UPDATING;
+		break;
+
+	case MSG_OK:
+		Serial.println("OK");
+		break;
+
+	default:
+		Serial.print("UNKNOWN MESSAGE: ");
+		Serial.println(line);
+		break;
 	}
+}
+
+/**
+ * received subscribed data, called from the BLE task
+ */
+void SparkMaker::notify(uint8_t *data, size_t length)
+{
+	bleNotifications.inc();
+	bleNotificationBytes.inc(length);
 
-	// update
-	if (strcmp(buffer, "OK") == 0)
+	// the line buffer is reset by disconnectBLE() on the loop task, both hold the printer lock
+	uint32_t overflowBytes;
+	uint32_t truncatedLines;
+	SparkMakerMessage msg;
+	const char *line;
+	size_t lineLength;
 	{
-		Serial.println("OK");
-		return;
-	}	
+		PrinterUpdate update(*this);
+
+		// sanity check
+		if (!txCharacteristic)
+		{
+			Serial.println("FAILURE: notification without txCharacteristic");
+			bleState = SCANNING;
+			return;
+		}
+
+		// append to buffer
+		overflowBytes = lineFramer.getOverflowBytes();
+		truncatedLines = lineFramer.getTruncatedLines();
+		lineFramer.write(data, length);
+
+		// process all complete lines, partial lines stay buffered
+		while ((line = lineFramer.readLine(lineLength)) != NULL)
+		{
+			SparkMakerProtocol::decode(line, lineLength, msg);
+			bleMessages.inc(msg.type);
+			bleMessageBytes.inc(msg.type, lineLength);
+			handleMessage(msg, line);
+			commands.received(msg.type);
+			poller.received(msg);
+		}
+	}
 
-	// unknown message
-	Serial.print("UNKNOWN MESSAGE: ");
-	Serial.println(buffer);
+	if (lineFramer.getOverflowBytes() != overflowBytes || lineFramer.getTruncatedLines() != truncatedLines)
+	{
+		Serial.print("FAILURE: notification data lost, overflow bytes ");
+		Serial.print(lineFramer.getOverflowBytes());
+		Serial.print(", truncated lines ");
+		Serial.println(lineFramer.getTruncatedLines());
+	}
 }
 
 /**
  * BLE connection / disconnection callback
  */
-class ConnectionCallback : public BLEClientCallbacks
+class SparkMaker::ConnectionCallback : public BLEClientCallbacks
 {
+  public:
+	ConnectionCallback(SparkMaker &spark) : spark(spark) {}
+
+  private:
 	void onConnect(BLEClient *client)
 	{
 	}
 
 	void onDisconnect(BLEClient *client)
 	{
-		Serial.println("onDisconnect");
-		bleState = OFFLINE;
-		SparkMaker::printer.status = DISCONNECTED;
+		Serial.print("onDisconnect: printer ");
+		Serial.println(spark.id);
+		spark.bleState = OFFLINE;
+		PrinterUpdate update(spark);
+		spark.printer.status = DISCONNECTED;
 	}
+
+	SparkMaker &spark;
 };
 
+/**
+ * printer found by the registry scan, connected by loop()
+ */
+void SparkMaker::found(const BLEAdvertisedDevice &advertisedDevice)
+{
+	if (device)
+		delete device;
+	device = new BLEAdvertisedDevice(advertisedDevice);
+	{
+		PrinterLock lock(*this);
+		address = device->getAddress().toString();
+	}
+	bleState = FOUND;
+}
+
+std::string SparkMaker::getAddress()
+{
+	PrinterLock lock(*this);
+	return address;
+}
+
 /**
  * disconnect from SparkMaker
  */
-bool disconnectBLE()
+bool SparkMaker::disconnectBLE()
 {
 	Serial.println("disconnect BLE");
 
@@ -327,52 +421,69 @@ bool disconnectBLE()
 		client->disconnect();
 	}
 
-	txCharacteristic = NULL;
-	rxCharacteristic = NULL;
+	{
+		// notifications of the old connection may still be processed by the BLE task
+		PrinterLock lock(*this);
+		if (txCharacteristic)
+			bleDisconnects.inc();
+		txCharacteristic = NULL;
+		rxCharacteristic = NULL;
+		lineFramer.clear();
+	}
+	commands.clear();
 
 	bleState = OFFLINE;
 	
 	return true;
 }
 
+/**
+ * connect task
+ * the BLE connection setup blocks for several connection intervals, up to the connect timeout if the printer is gone
+ * it runs beside the loop, so stop requests to other printers and HTTP clients are served meanwhile
+ */
+void SparkMaker::connectTask(void *context)
+{
+	SparkMaker *spark = (SparkMaker *)context;
+	if ( spark->connectBLE() )
+	{
+		Serial.println("Connecting to SparkMaker");
+		// the handshake may already have been received
+		uint8_t state = LINKING;
+		spark->bleState.compare_exchange_strong(state, CONNECT);
+	}
+	else
+	{
+		Serial.println("FAILURE: Cannot connect to SparkMaker");
+		spark->bleState = SCANNING;
+	}
+	spark->connecting = false;
+	vTaskDelete(NULL);
+}
+
 /**
  * connect to SparkMaker and subscribe to status
+ * runs in the connect task, the previous connection was closed by the loop
  */
-bool connectBLE()
+bool SparkMaker::connectBLE()
 {
 	Serial.println("connect BLE");
 
-	// delete old connections
-	disconnectBLE();
-
-	if (!sparkMakerBLEDevice)
+	if (!device)
 		return false;
 
 	// use do-while(false) as poor-mans exception handling
 	do
 	{
 		Serial.print("connecting to ");
-		Serial.print(sparkMakerBLEDevice->getAddress().toString().c_str());
+		Serial.print(getAddress().c_str());
 		Serial.println(" ...");
 
-		// create new BLE client
-		client = BLEDevice::createClient();
-
-		client->setClientCallbacks(new ConnectionCallback());
-		client->connect(sparkMakerBLEDevice);
+		client->connect(device);
 		if (!client->isConnected())
 			break;
 
-		Serial.println("registering to SparkMakerServiceRxUUID ...");
-		auto rxService = client->getService(SparkMakerServiceRxUUID);
-		if (!rxService || !client->isConnected() )
-			break;
-		rxCharacteristic = rxService->getCharacteristic(SparkMakerCharRxUUID);
-		if (!rxCharacteristic || !rxCharacteristic->canNotify())
-			break;
-		rxCharacteristic->registerForNotify(notifyCallback);
-		yield();
-
+		// writes are possible before the first notification arrives
 		Serial.println("connect SparkMakerServiceTxUUID ...");
 		auto txService = client->getService(SparkMakerServiceTxUUID);
 		if (!txService || !client->isConnected() )
@@ -382,43 +493,59 @@ bool connectBLE()
 		if (!txCharacteristic)
 			break;
 
+		Serial.println("registering to SparkMakerServiceRxUUID ...");
+		auto rxService = client->getService(SparkMakerServiceRxUUID);
+		if (!rxService || !client->isConnected() )
+			break;
+		BLERemoteCharacteristic *rx = rxService->getCharacteristic(SparkMakerCharRxUUID);
+		if (!rx || !rx->canNotify())
+			break;
+		rxCharacteristic = rx;
+		rx->registerForNotify(PrinterRegistry::notifyCallback);
+
 		Serial.println("connected to device");
-		bleState = CONNECT;
+		bleConnects.inc();
 		return true;
 
 	} while (false);
 
 	// broke out of connection process
+	txCharacteristic = NULL;
+	rxCharacteristic = NULL;
 	client->disconnect();
 	return false;
 }
 
-Printer SparkMaker::printer;
-
 /**
- * SparkMaker BLE Interface setup
+ * write ended print to the job log
+ * flash writes block, they are kept out of the BLE task
  */
-void SparkMaker::setup()
+void SparkMaker::logJob()
 {
-	// start Bluetooth Low Energy
-	BLEDevice::init(config["hostname"]);
-
-	// parse config
-	statusRequestInterval = ( config["SparkMaker"]["statusRequestInterval"] | defaultConfig.statusRequestInterval ) * 1000;
-
-	// get BLE scanner object
-	pBLEScan = BLEDevice::getScan();
-	pBLEScan->setAdvertisedDeviceCallbacks(new AdvertisedDeviceCallbacks);
-	pBLEScan->setWindow(2000);
-	pBLEScan->setInterval(200);
-	pBLEScan->setActiveScan(true);
-	pBLEScan->clearResults();
-	pBLEScan->start(2);
-
+	if ( !jobEnded )
+		return;
 
-	// SparkMaker state handling
-	bleState = SCANNING;
-	SparkMaker::printer.status = DISCONNECTED;
+	JobLog::Job job;
+	memset(&job, 0, sizeof(job));
+	{
+		PrinterLock lock(*this);
+		jobEnded = false;
+		job.outcome = jobOutcome;
+		job.printer = id;
+		job.start = history.getStartTime() / 1000;
+		job.duration = history.activeTime(millis()) / 1000;
+		job.paused = history.getPausedTime() / 1000;
+		job.layers = history.getLayer();
+		job.totalLayers = history.getTotalLayers();
+		strncpy(job.file, printer.currentFile.c_str(), sizeof(job.file) - 1);
+	}
+	if ( PrinterRegistry::getJobLog().append(job) )
+	{
+		Serial.print("job logged: ");
+		Serial.print(job.file);
+		Serial.print(" ");
+		Serial.println(jobOutcomeNames[job.outcome]);
+	}
 }
 
 /**
@@ -426,7 +553,16 @@ void SparkMaker::setup()
  */
 void SparkMaker::loop()
 {
-	uint32_t time = millis();
+	LoopProfiler::phase("ble");
+	if ( !connecting && pendingState != NA )
+	{
+		// connect or disconnect requested while the connect task was running
+		disconnectBLE();
+		bleState = pendingState.exchange(NA);
+		PrinterUpdate update(*this);
+		printer.status = DISCONNECTED;
+	}
+
 	switch (bleState)
 	{
 	case NA:
@@ -436,31 +572,40 @@ void SparkMaker::loop()
 		
 	case SCANNING:
 	default:
-		// scan for BLE devices
-		printer.status = DISCONNECTED;
-		SparkMaker::printer.filenames.clear();
-		if ( (time - bleScantime) > 3500 && pBLEScan)
+		// the registry scans for BLE devices
 		{
-			Serial.println("scan BLE");
-			pBLEScan->start(1);
-			bleScantime = time;
+			PrinterUpdate update(*this);
+			printer.status = DISCONNECTED;
+			clearFiles();
 		}
 		break;
 
 	case FOUND:
-		// connect to SparkMaker device
-		if ( connectBLE() && pBLEScan)
+		// connect to SparkMaker device in the connect task
+		BootProfiler::event("printer found");
+		disconnectBLE();
+		if (!client)
 		{
-			Serial.println("Connecting to SparkMaker");
+			// BLE client, reused for reconnects
+			client = BLEDevice::createClient();
+			client->setClientCallbacks(new ConnectionCallback(*this));
+		}
+		bleState = LINKING;
+		connecting = true;
+		if ( xTaskCreate(connectTask, "connect", CONNECT_TASK_STACK, this, 1, NULL) == pdPASS )
+		{
+			PrinterUpdate update(*this);
 			printer.status = CONNECTING;
 		}
 		else
 		{
-			Serial.println("FAILURE: Cannot connect to SparkMaker");
+			Serial.println("FAILURE: Cannot start connect task");
+			connecting = false;
 			bleState = SCANNING;
 		}
 		break;
 
+	case LINKING:
 	case CONNECT:
 		break;
 
@@ -469,9 +614,10 @@ void SparkMaker::loop()
 		Serial.print("send handshake ... ");
 		if ( txCharacteristic )
 		{
-			SparkMaker::printer.lastStatusRequest = 0;
-			SparkMaker::requestStatus();
+			poller.reset();
+			requestStatus();
 			bleState = READ_FILES;
+			BootProfiler::event("printer connected");
 		}
 		else
 		{
@@ -488,8 +634,12 @@ void SparkMaker::loop()
 		Serial.print("read files ... ");
 		if ( txCharacteristic )
 		{
-			SparkMaker::printer.filenames.clear();
-			txCharacteristic->writeValue("scan-file\n");
+			{
+				PrinterUpdate update(*this);
+				clearFiles();
+			}
+			// the file list may take a while, one line per connection interval
+			commands.push("scan-file\n", CMD_PRIORITY_BACKGROUND, MSG_SCAN_FINISH, 10000, 1);
 			Serial.println("OK");
 			bleState = ONLINE;
 		}
@@ -504,12 +654,11 @@ void SparkMaker::loop()
 	if (bleState >= CONNECT)
 	{
 		// trigger status messages
-		unsigned long time = millis();
-		if ((time - printer.lastStatusRequest) > statusRequestInterval)
+		if (poller.due(printer.status, millis()))
 		{
 			if ( txCharacteristic )
 			{
-				SparkMaker::requestStatus();
+				requestStatus();
 			}
 			else
 			{
@@ -518,18 +667,31 @@ void SparkMaker::loop()
 			}
 		}
 	}
+
+	// write queued commands
+	LoopProfiler::phase("commands");
+	commands.loop();
+
+	LoopProfiler::phase("job log");
+	logJob();
 }
 
 /**
- * connect printer
+ * connect printer, the registry scan finds it again
  */
 void SparkMaker::connect()
 {
+	if ( connecting )
+	{
+		pendingState = SCANNING;
+		return;
+	}
 	disconnectBLE();
 	
 	// start BLE scanning
 	bleState = SCANNING;
-	SparkMaker::printer.status = DISCONNECTED;	
+	PrinterUpdate update(*this);
+	printer.status = DISCONNECTED;
 }
 
 /**
@@ -537,7 +699,13 @@ void SparkMaker::connect()
  */
 void SparkMaker::disconnect()
 {
+	if ( connecting )
+	{
+		pendingState = OFFLINE;
+		return;
+	}
 	disconnectBLE();
+	PrinterUpdate update(*this);
 	printer.status = DISCONNECTED;
 }
 
@@ -549,7 +717,8 @@ void SparkMaker::send(const String &cmd)
 	Serial.println("send command: "); Serial.println(cmd);
 	if ( txCharacteristic )
 	{
-		txCharacteristic->writeValue(cmd.c_str());
+		commands.push(cmd, CMD_PRIORITY_NORMAL);
+		poller.kick();
 	}
 }
 
@@ -561,8 +730,9 @@ void SparkMaker::requestStatus()
 	Serial.println(" send status request");
 	if ( txCharacteristic )
 	{
-		SparkMaker::printer.lastStatusRequest = millis();
-		txCharacteristic->writeValue("PWD-OK\n");
+		printer.lastStatusRequest = millis();
+		poller.polled(printer.lastStatusRequest);
+		commands.push("PWD-OK\n", CMD_PRIORITY_BACKGROUND);
 	}
 }
 
@@ -579,7 +749,10 @@ void SparkMaker::move(int16_t pos)
 		Serial.println("move Z position");
 		String cmd = "G1 Z" + String(pos) + ";";
 		if ( txCharacteristic )
-			txCharacteristic->writeValue(cmd.c_str());
+		{
+			commands.push(cmd, CMD_PRIORITY_NORMAL, MSG_OK, CommandQueue::ACK_TIMEOUT, 0); // relative move, never sent twice
+			poller.kick();
+		}
 	}
 }
 
@@ -592,7 +765,10 @@ void SparkMaker::home()
 	{
 		Serial.println("home Z");
 		if ( txCharacteristic )
-			txCharacteristic->writeValue("G28 Z0;");
+		{
+			commands.push("G28 Z0;", CMD_PRIORITY_NORMAL, MSG_OK, HOME_TIMEOUT, 0); // not sent again while the plate moves
+			poller.kick();
+		}
 	}
 }
 
@@ -610,35 +786,45 @@ void SparkMaker::print(const String &filename)
 		if ( !filename.isEmpty() )
 		{
 			// search for filename
-			auto it = SparkMaker::printer.filenames.find(filename.c_str());
-			if ( it == SparkMaker::printer.filenames.end() )
-				return;
-			uint16_t id = it->second;
+			uint16_t id;
+			{
+				PrinterUpdate update(*this);
+				auto it = printer.filenames.find(filename.c_str());
+				if ( it == printer.filenames.end() )
+					return;
+				id = it->second;
+			}
 			
-			// select file to print
+			// select file to print, start is sent after the selection was acknowledged and dropped if it fails
 			String cmd = "file-" + String(id);
-			txCharacteristic->writeValue(cmd.c_str());
-			delay(100);
+			commands.push(cmd, CMD_PRIORITY_CONTROL, MSG_OK, CommandQueue::ACK_TIMEOUT, CommandQueue::MAX_RETRIES, true);
 
 		}
-		SparkMaker::printer.startTime = 0;
-		SparkMaker::printer.finishTime = 0;
-		SparkMaker::printer.currentLayer = 0;
-		SparkMaker::printer.totalLayers = 0;
+		{
+			PrinterUpdate update(*this);
+			printer.startTime = 0;
+			printer.finishTime = 0;
+			printer.currentLayer = 0;
+			printer.totalLayers = 0;
+		}
 
 		Serial.println("start printing");
-		txCharacteristic->writeValue("Start Printing;");
+		commands.push("Start Printing;", CMD_PRIORITY_CONTROL, MSG_OK);
+		poller.kick();
 	}
 }
 
 /**
  * stop print
  */
-void SparkMaker::stopPrint()
+void SparkMaker::stopPrint(unsigned long requestTime)
 {
-	Serial.println("stop printing");
 	if ( txCharacteristic )
-		txCharacteristic->writeValue("Stop Printing;");
+	{
+		commands.urgent("Stop Printing;", MSG_STOP, requestTime);
+		poller.kick();
+	}
+	Serial.println("stop printing");
 }
 
 /**
@@ -650,7 +836,10 @@ void SparkMaker::pausePrint()
 	{
 		Serial.println("pause printing");
 		if ( txCharacteristic )
-			txCharacteristic->writeValue("Pause Printing;");
+		{
+			commands.push("Pause Printing;", CMD_PRIORITY_CONTROL, MSG_PAUSE);
+			poller.kick();
+		}
 	}
 }
 
@@ -663,16 +852,80 @@ void SparkMaker::resumePrint()
 	{
 		Serial.println("resume printing");
 		if ( txCharacteristic )
-			txCharacteristic->writeValue("Keep Printing;");
+		{
+			commands.push("Keep Printing;", CMD_PRIORITY_CONTROL, MSG_RESUME);
+			poller.kick();
+		}
 	}
 }
 
 /**
  * emergency stop
  */
-void SparkMaker::emergencyStop()
+void SparkMaker::emergencyStop(unsigned long requestTime)
 {
-	Serial.println("emergency stop");
+	// write first, serial output may block
+	stopOutcome = JOB_EMERGENCY;
 	if ( txCharacteristic )
-		txCharacteristic->writeValue("Emergency;");
+	{
+		commands.urgent("Emergency;", MSG_STOP, requestTime);
+		poller.kick();
+	}
+	Serial.println("emergency stop");
+}
+
+/**
+ * command queue metrics
+ */
+void SparkMaker::getCommandStats(JsonObject obj)
+{
+	commands.stats(obj);
+	poller.stats(obj.createNestedObject("poll"));
+}
+
+/**
+ * copy layer timing and estimate
+ */
+void SparkMaker::getHistory(PrintHistory &copy)
+{
+	PrinterLock lock(*this);
+	copy = history;
+}
+
+/**
+ * copy consistent printer state without locking (seqlock reader)
+ */
+void SparkMaker::getSnapshot(PrinterSnapshot &snapshot)
+{
+	while (true)
+	{
+		uint32_t sequence = snapshotSequence.load(std::memory_order_acquire);
+		if (sequence & 1)
+		{
+			// writer active
+			yield();
+			continue;
+		}
+		memcpy(&snapshot, &publishedSnapshot, sizeof(snapshot));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (snapshotSequence.load(std::memory_order_relaxed) == sequence)
+			return;
+	}
+}
+
+/**
+ * published file list
+ * not taken under printerLock, the BLE task holds it for a whole notification batch
+ */
+std::shared_ptr<const PrinterFileList> SparkMaker::getFiles()
+{
+	return std::atomic_load(&files);
+}
+
+/**
+ * epoch of the published snapshot
+ */
+uint32_t SparkMaker::getEpoch()
+{
+	return snapshotSequence.load(std::memory_order_acquire) >> 1;
 }
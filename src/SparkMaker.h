@@ -9,26 +9,17 @@
 #include <ESPmDNS.h>
 #include <DNSServer.h>
 #include <ArduinoJson.h>
+#include <atomic>
 #include <map>
-
-typedef enum
-{
-	DISCONNECTED,
-	CONNECTING,
-	STANDBY,
-	FILELIST,
-	PRINTING,
-	PAUSE,
-	FINISHED,
-	STOPPING,
-	NO_CARD,
-	UPDATING
-} PRINTERSTATUS;
-
-/**
- * string names for WiFi encryption
- */
-extern const char *statusNames[];
+#include <memory>
+#include <vector>
+#include "PrinterStatus.h"
+#include "SparkMakerProtocol.h"
+#include "LineFramer.h"
+#include "CommandQueue.h"
+#include "StatusPoller.h"
+#include "PrintHistory.h"
+#include "JobLog.h"
 
 typedef struct
 {
@@ -43,29 +34,171 @@ typedef struct
 	std::map<std::string, uint16_t> filenames;
 } Printer;
 
+/**
+ * published printer state for readers on other tasks
+ * plain data with fixed size buffers, copied as a whole by SparkMaker::getSnapshot()
+ * the file list changes rarely and is published on its own, see SparkMaker::getFiles()
+ */
+#define SNAPSHOT_FILE_NAME_SIZE 64 // max length of currentFile including terminator
+
+typedef struct
+{
+	uint32_t epoch = 0; // incremented on every published change, including the file list
+	PRINTERSTATUS status = DISCONNECTED;
+	int32_t currentLayer = 0;
+	int32_t totalLayers = 0;
+	uint32_t startTime = 0;
+	uint32_t finishTime = 0;
+	char currentFile[SNAPSHOT_FILE_NAME_SIZE] = {0};
+} PrinterSnapshot;
+
+/**
+ * published file list, sorted by name, never modified once published
+ */
+typedef std::vector<std::string> PrinterFileList;
+
+class BLEAdvertisedDevice;
+class BLEClient;
+class BLERemoteCharacteristic;
+
+/**
+ * connection to one SparkMaker printer
+ * instances are created and found by PrinterRegistry, which also runs the shared BLE scan
+ */
 class SparkMaker
 {
   public:
-	static void setup();
-	static void loop();
+	static const uint32_t CONNECT_TASK_STACK = 4096; // [bytes]
+	static const uint32_t HOME_TIMEOUT = 60000;		 // reply to G28 after the plate has reached home, full travel from the top [ms]
+
+	SparkMaker(uint8_t id);
+
+	uint8_t getId() const { return id; }
+
+	/**
+	 * BLE address of the assigned printer, empty until a printer was found
+	 * copied under the printer lock, the registry assigns the address from the BLE task
+	 */
+	std::string getAddress();
+
+	void loop();
+
+	void connect();
+	void disconnect();
+	void send(const String &cmd);
+
+	void print(const String &filename);
+	/**
+	 * stop and emergency stop are written immediately, before queued commands
+	 * @param requestTime arrival of the request [us], for the latency statistics
+	 */
+	void stopPrint(unsigned long requestTime = micros());
+	void pausePrint();
+	void resumePrint();
+	void emergencyStop(unsigned long requestTime = micros());
+
+	void requestStatus();
+
+	void move(int16_t pos);
+	void home();
+
+	/**
+	 * add command queue and status polling metrics (depth, latency, retries, poll interval) to JSON object
+	 */
+	void getCommandStats(JsonObject obj);
+
+	/**
+	 * copy layer timing and remaining time estimate of the current print
+	 */
+	void getHistory(PrintHistory &history);
+
+	/**
+	 * copy consistent printer state without locking (seqlock reader)
+	 * the reader retries with yield() while a write is in progress, a write is a copy of a few bytes:
+	 * the BLE task writes on the other core (0) at the same time as the loop task (core 1) and finishes meanwhile,
+	 * the connect task runs at the priority of the loop task, yield() lets it finish on the same core
+	 * call it from the loop task or a task of the same priority
+	 */
+	void getSnapshot(PrinterSnapshot &snapshot);
+
+	/**
+	 * published file list, shared with the printer until the next change, without locking
+	 */
+	std::shared_ptr<const PrinterFileList> getFiles();
+
+	/**
+	 * epoch of the published snapshot, changes whenever the printer state changes
+	 */
+	uint32_t getEpoch();
+
+	/**
+	 * printer state, only modified by the BLE and loop tasks while holding the update lock
+	 */
+	Printer printer;
+
+  private:
+	friend class PrinterRegistry;
+	class PrinterUpdate;
+	class PrinterLock;
+	class ConnectionCallback;
+
+	typedef enum
+	{
+		NA,
+		OFFLINE,
+		SCANNING,
+		FOUND,
+		LINKING, // connect task running
+		CONNECT,
+		HANDSHAKE,
+		ONLINE,
+		READ_FILES
+	} BLESTATE;
+
+	// called by PrinterRegistry
+	bool isScanning() const { return bleState == SCANNING; }
+	void found(const BLEAdvertisedDevice &device);
+	void notify(uint8_t *data, size_t length);
+	BLERemoteCharacteristic *getNotifyCharacteristic() const { return rxCharacteristic.load(); }
 
-	static void connect();
-	static void disconnect();
-	static void send(const String &cmd);
+	static bool writeCommand(void *context, const String &cmd);
+	void handleMessage(const SparkMakerMessage &msg, const char *line);
+	void publishSnapshot();
+	void clearFiles();
+	static void connectTask(void *context);
+	bool connectBLE();
+	bool disconnectBLE();
+	void logJob();
 
-	static void print(const String &filename);
-	static void stopPrint();
-	static void pausePrint();
-	static void resumePrint();
-	static void emergencyStop();
+	uint8_t id;
+	std::string address; // written by the BLE task with printerLock held
+	BLEAdvertisedDevice *device;
+	BLEClient *client;
+	std::atomic<BLERemoteCharacteristic *> txCharacteristic; // set by the connect task
+	std::atomic<BLERemoteCharacteristic *> rxCharacteristic;
+	std::atomic<uint8_t> bleState;
+	std::atomic<bool> connecting;	  // connect task running, it owns client and characteristics
+	std::atomic<uint8_t> pendingState; // OFFLINE or SCANNING requested while the connect task runs, NA if none
 
-	static void requestStatus();
+	LineFramer lineFramer;
+	CommandQueue commands;
+	StatusPoller poller;
+	PrintHistory history; // written by the BLE task with printerLock held
 
-	static void move(int16_t pos);
-	static void home();
+	// end of print for the job log, written by the loop
+	std::atomic<bool> jobEnded; // print ended, set by the BLE task with printerLock held
+	JOBOUTCOME jobOutcome;
+	std::atomic<uint8_t> stopOutcome; // outcome of the next stop_sts
 
-	static Printer printer;
+	// published printer snapshot (seqlock)
+	std::atomic<uint32_t> snapshotSequence;
+	PrinterSnapshot publishedSnapshot;
+	PrinterSnapshot nextSnapshot; // writer side copy, only accessed while holding printerLock
+	bool filesChanged;			  // printer.filenames modified since last publish
+	std::shared_ptr<const PrinterFileList> files; // replaced with atomic_store() while holding printerLock, read with atomic_load()
 
+	// FreeRTOS mutex of the writers (BLE, connect and loop task), it lends the priority of a waiting task to the holder
+	SemaphoreHandle_t printerLock;
 };
 
-#endif // _SPARKMAKER_h
\ No newline at end of file
+#endif // _SPARKMAKER_h
@@ -0,0 +1,197 @@
+/*
+	SparkMaker BLE protocol decoder
+*/
+#include "SparkMakerProtocol.h"
+
+#include <string.h>
+
+/**
+ * exact message tokens
+ */
+typedef struct
+{
+	const char *text;
+	uint8_t length;
+	MESSAGETYPE type;
+} Token;
+
+#define TOKEN(text, type) { text, sizeof(text) - 1, type }
+static constexpr Token tokens[] = {
+	TOKEN("online", MSG_HEARTBEAT),
+	TOKEN("standby_sts", MSG_STANDBY),
+	TOKEN("printing_sts", MSG_PRINTING),
+	TOKEN("pause_sts", MSG_PAUSE),
+	TOKEN("pause-over", MSG_RESUME),
+	TOKEN("stop_sts", MSG_STOP),
+	TOKEN("printo_sts", MSG_FINISHED),
+	TOKEN("nocard_sts", MSG_NO_CARD),
+	TOKEN("scan-finish", MSG_SCAN_FINISH),
+	TOKEN("update_sts", MSG_UPDATING),
+	TOKEN("OK", MSG_OK)
+};
+#undef TOKEN
+static constexpr size_t TOKEN_COUNT = sizeof(tokens) / sizeof(tokens[0]);
+
+/**
+ * perfect hash over the exact tokens (length and first two characters)
+ */
+static constexpr size_t HASH_SIZE = 16;
+static constexpr uint8_t NO_TOKEN = 0xFF;
+static constexpr size_t hash(const char *text, size_t length)
+{
+	return (length * 3 + (uint8_t)text[0] + (uint8_t)text[1] * 3) % HASH_SIZE;
+}
+
+/**
+ * token index for a hash slot (compile time)
+ */
+static constexpr uint8_t slotFor(size_t slot, size_t i = 0)
+{
+	return i >= TOKEN_COUNT ? NO_TOKEN : hash(tokens[i].text, tokens[i].length) == slot ? (uint8_t)i : slotFor(slot, i + 1);
+}
+
+/**
+ * check that every token owns its hash slot (compile time)
+ */
+static constexpr bool isPerfect(size_t i = 0)
+{
+	return i >= TOKEN_COUNT || (slotFor(hash(tokens[i].text, tokens[i].length)) == i && isPerfect(i + 1));
+}
+static_assert(isPerfect(), "SparkMaker protocol token hash has collisions, adjust hash()");
+
+static constexpr uint8_t hashTable[HASH_SIZE] = {
+	slotFor(0), slotFor(1), slotFor(2), slotFor(3),
+	slotFor(4), slotFor(5), slotFor(6), slotFor(7),
+	slotFor(8), slotFor(9), slotFor(10), slotFor(11),
+	slotFor(12), slotFor(13), slotFor(14), slotFor(15)
+};
+
+/**
+ * message names for logging and metrics
+ */
+const char *messageNames[MSG_COUNT] = {
+	"UNKNOWN",
+	"HEARTBEAT",
+	"HANDSHAKE",
+	"SELECTED_FILE",
+	"FILE_ENTRY",
+	"LAYER",
+	"STANDBY",
+	"PRINTING",
+	"PAUSE",
+	"RESUME",
+	"STOP",
+	"FINISHED",
+	"NO_CARD",
+	"SCAN_FINISH",
+	"UPDATING",
+	"OK"
+};
+
+/**
+ * parse unsigned decimal number in place
+ * @return pointer to first character after the number
+ */
+static const char *parseNumber(const char *ptr, const char *end, int32_t &value)
+{
+	int32_t v = 0;
+	while (ptr < end && *ptr >= '0' && *ptr <= '9')
+	{
+		v = v * 10 + (*ptr - '0');
+		ptr++;
+	}
+	value = v;
+	return ptr;
+}
+
+/**
+ * check if line starts with prefix
+ */
+static inline bool startsWith(const char *line, size_t length, const char *prefix, size_t prefixLength)
+{
+	return length >= prefixLength && memcmp(line, prefix, prefixLength) == 0;
+}
+
+MESSAGETYPE SparkMakerProtocol::decode(const char *line, size_t length, SparkMakerMessage &msg)
+{
+	// ignore trailing carriage return
+	if (length && line[length - 1] == '\r')
+		length--;
+
+	msg.type = MSG_UNKNOWN;
+	msg.text = line;
+	msg.length = length;
+	msg.value = 0;
+	msg.total = 0;
+	if (length < 2)
+		return msg.type;
+
+	// messages with payload
+	const char *end = line + length;
+	switch (line[0])
+	{
+	case 'P': // P-<printer>
+		if (line[1] == '-')
+		{
+			msg.type = MSG_HANDSHAKE;
+			msg.text = line + 2;
+			msg.length = length - 2;
+			return msg.type;
+		}
+		break;
+
+	case 'p': // pf_<file>
+		if (startsWith(line, length, "pf_", 3))
+		{
+			msg.type = MSG_SELECTED_FILE;
+			msg.text = line + 3;
+			msg.length = length - 3;
+			return msg.type;
+		}
+		break;
+
+	case 'f': // f-<file>.<id>
+		if (line[1] == '-')
+		{
+			msg.type = MSG_FILE_ENTRY;
+			msg.text = line + 2;
+			msg.length = length - 2;
+			msg.value = -1;
+			// file index follows the last '.'
+			for (const char *ptr = end - 1; ptr >= msg.text; ptr--)
+			{
+				if (*ptr == '.')
+				{
+					msg.length = ptr - msg.text;
+					parseNumber(ptr + 1, end, msg.value);
+					break;
+				}
+			}
+			return msg.type;
+		}
+		break;
+
+	case 'F': // F/S=<layer>/<total>
+		if (startsWith(line, length, "F/S=", 4))
+		{
+			msg.type = MSG_LAYER;
+			msg.total = -1;
+			const char *ptr = parseNumber(line + 4, end, msg.value);
+			if (ptr < end && *ptr == '/')
+				parseNumber(ptr + 1, end, msg.total);
+			return msg.type;
+		}
+		break;
+	}
+
+	// exact tokens
+	uint8_t index = hashTable[hash(line, length)];
+	if (index != NO_TOKEN && tokens[index].length == length && memcmp(tokens[index].text, line, length) == 0)
+		msg.type = tokens[index].type;
+	return msg.type;
+}
+
+const char *SparkMakerProtocol::messageName(MESSAGETYPE type)
+{
+	return type < MSG_COUNT ? messageNames[type] : messageNames[MSG_UNKNOWN];
+}
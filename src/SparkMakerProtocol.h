@@ -0,0 +1,63 @@
+/*
+	SparkMaker BLE protocol decoder
+*/
+#ifndef _SPARKMAKERPROTOCOL_h
+#define _SPARKMAKERPROTOCOL_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * messages sent by the printer, one per line
+ */
+typedef enum
+{
+	MSG_UNKNOWN,
+	MSG_HEARTBEAT,	   // online
+	MSG_HANDSHAKE,	   // P-...
+	MSG_SELECTED_FILE, // pf_<file>
+	MSG_FILE_ENTRY,	   // f-<file>.<id>
+	MSG_LAYER,		   // F/S=<layer>/<total>
+	MSG_STANDBY,	   // standby_sts
+	MSG_PRINTING,	   // printing_sts
+	MSG_PAUSE,		   // pause_sts
+	MSG_RESUME,		   // pause-over
+	MSG_STOP,		   // stop_sts
+	MSG_FINISHED,	   // printo_sts
+	MSG_NO_CARD,	   // nocard_sts
+	MSG_SCAN_FINISH,   // scan-finish
+	MSG_UPDATING,	   // update_sts
+	MSG_OK,			   // OK
+	MSG_COUNT
+} MESSAGETYPE;
+extern const char *messageNames[];
+
+/**
+ * decoded message
+ * text points into the decoded line (not terminated), it is only valid as long as the line buffer
+ */
+typedef struct
+{
+	MESSAGETYPE type;
+	const char *text; // file name or unknown line
+	uint16_t length;  // length of text
+	int32_t value;	  // file id or current layer, -1 if missing
+	int32_t total;	  // total layers, -1 if missing
+} SparkMakerMessage;
+
+class SparkMakerProtocol
+{
+  public:
+	/**
+	 * decode one line without line terminator
+	 * @return message type, MSG_UNKNOWN for unknown lines
+	 */
+	static MESSAGETYPE decode(const char *line, size_t length, SparkMakerMessage &msg);
+
+	/**
+	 * message name for logging
+	 */
+	static const char *messageName(MESSAGETYPE type);
+};
+
+#endif // _SPARKMAKERPROTOCOL_h
@@ -0,0 +1,171 @@
+/*
+	SparkMaker Status Polling
+*/
+#include "StatusPoller.h"
+#include "Settings.h"
+
+StatusPoller::StatusPoller()
+	: kicked(false), lastFresh(0), lastLayer(0), layer(0), layerCadence(0)
+{
+	reset();
+}
+
+void StatusPoller::reset()
+{
+	kicked.store(false, std::memory_order_relaxed);
+	lastFresh.store(0, std::memory_order_relaxed);
+	lastLayer.store(0, std::memory_order_relaxed);
+	layer.store(0, std::memory_order_relaxed);
+	layerCadence.store(0, std::memory_order_relaxed);
+	state = DISCONNECTED;
+	lastPoll = 0;
+	interval = POLL_BURST;
+	burst = 0;
+	backoff = 0;
+	bursting = true;
+	skippedFresh = 0;
+	polls = 0;
+	skipped = 0;
+}
+
+void StatusPoller::received(const SparkMakerMessage &msg)
+{
+	uint32_t now = millis();
+	switch (msg.type)
+	{
+	case MSG_LAYER:
+	{
+		// smoothed layer cadence, F/S= answering a status request repeats the current layer
+		if (msg.value == layer.load(std::memory_order_relaxed))
+			break;
+		layer.store(msg.value, std::memory_order_relaxed);
+		uint32_t last = lastLayer.load(std::memory_order_relaxed);
+		if (last)
+		{
+			uint32_t gap = now - last;
+			uint32_t cadence = layerCadence.load(std::memory_order_relaxed);
+			layerCadence.store(cadence ? (cadence * 3 + gap) / 4 : gap, std::memory_order_relaxed);
+		}
+		lastLayer.store(now, std::memory_order_relaxed);
+		break;
+	}
+	case MSG_STANDBY:
+	case MSG_PRINTING:
+	case MSG_PAUSE:
+	case MSG_RESUME:
+	case MSG_STOP:
+	case MSG_FINISHED:
+	case MSG_NO_CARD:
+	case MSG_UPDATING:
+		break;
+	default:
+		return; // no status information
+	}
+	lastFresh.store(now, std::memory_order_relaxed);
+}
+
+bool StatusPoller::due(PRINTERSTATUS status, unsigned long now)
+{
+	bool changed = kicked.exchange(false, std::memory_order_relaxed);
+	if (status != state)
+	{
+		// a new print has its own cadence, the gap across a pause is not measured
+		if (status == PRINTING && state != PAUSE)
+			layerCadence.store(0, std::memory_order_relaxed);
+		lastLayer.store(0, std::memory_order_relaxed);
+		state = status;
+		changed = true;
+	}
+	if (changed)
+	{
+		bursting = true;
+		burst = 0;
+		backoff = 0;
+	}
+
+	uint32_t base = stateInterval(status);
+	if (bursting)
+	{
+		interval = POLL_BURST << burst;
+		if (interval >= base)
+		{
+			interval = base;
+			bursting = false;
+		}
+	}
+	else if (isIdle(status))
+	{
+		uint32_t max = settings.SparkMaker.idleMaxRequestInterval * 1000UL;
+		interval = base << backoff;
+		if (interval > max)
+			interval = max > base ? max : base;
+	}
+	else
+	{
+		interval = base;
+	}
+
+	if (now - lastPoll < interval)
+		return false;
+
+	// status arrived recently, no need to ask
+	uint32_t fresh = lastFresh.load(std::memory_order_relaxed);
+	if (fresh && now - fresh < interval)
+	{
+		if (fresh != skippedFresh)
+		{
+			skippedFresh = fresh;
+			skipped++;
+		}
+		return false;
+	}
+	return true;
+}
+
+void StatusPoller::polled(unsigned long now)
+{
+	lastPoll = now;
+	polls++;
+	if (bursting)
+		burst++;
+	else if (isIdle(state) && interval < settings.SparkMaker.idleMaxRequestInterval * 1000UL)
+		backoff++;
+}
+
+uint32_t StatusPoller::stateInterval(PRINTERSTATUS status) const
+{
+	switch (status)
+	{
+	case PRINTING:
+	{
+		// ask when a layer is overdue
+		uint32_t time = settings.SparkMaker.statusRequestInterval * 1000UL;
+		uint32_t cadence = layerCadence.load(std::memory_order_relaxed);
+		if (cadence && 2 * cadence < time)
+			time = 2 * cadence;
+		return time;
+	}
+	case PAUSE:
+		return settings.SparkMaker.pauseRequestInterval * 1000UL;
+	case STANDBY:
+	case FILELIST:
+	case FINISHED:
+	case NO_CARD:
+		return settings.SparkMaker.idleRequestInterval * 1000UL;
+	default:
+		return settings.SparkMaker.transitionRequestInterval * 1000UL;
+	}
+}
+
+bool StatusPoller::isIdle(PRINTERSTATUS status)
+{
+	return status == STANDBY || status == FILELIST || status == FINISHED || status == NO_CARD;
+}
+
+void StatusPoller::stats(JsonObject obj) const
+{
+	obj["polls"] = polls;
+	obj["skipped"] = skipped;
+	obj["interval"] = interval;
+	obj["layerCadence"] = layerCadence.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,88 @@
+/*
+	SparkMaker Status Polling
+*/
+#ifndef _STATUSPOLLER_h
+#define _STATUSPOLLER_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include "PrinterStatus.h"
+#include "SparkMakerProtocol.h"
+
+/**
+ * decides when to send the next status request (PWD-OK)
+ * each printer state has its own interval, see SparkMaker.*RequestInterval in config.json
+ * after a command or state change the status is polled after POLL_BURST, then at doubled intervals up to the state interval
+ * idle states back off further up to SparkMaker.idleMaxRequestInterval while nothing happens
+ * status messages from the printer (e.g. F/S= during a print) count as fresh data and postpone the next request
+ * while printing, a layer overdue by twice the observed layer cadence is polled for
+ */
+class StatusPoller
+{
+  public:
+	static const uint32_t POLL_BURST = 500; // first request after a command or state change [ms]
+
+	StatusPoller();
+
+	/**
+	 * printer message received, called from the BLE task
+	 */
+	void received(const SparkMakerMessage &msg);
+
+	/**
+	 * command queued, the printer state is about to change
+	 */
+	void kick() { kicked.store(true, std::memory_order_relaxed); }
+
+	/**
+	 * @return true if a status request is due
+	 */
+	bool due(PRINTERSTATUS status, unsigned long now);
+
+	/**
+	 * status request sent
+	 */
+	void polled(unsigned long now);
+
+	/**
+	 * forget timing, e.g. on a new connection
+	 */
+	void reset();
+
+	/**
+	 * current interval [ms]
+	 */
+	uint32_t getInterval() const { return interval; }
+
+	/**
+	 * add metrics to JSON object
+	 */
+	void stats(JsonObject obj) const;
+
+  private:
+	uint32_t stateInterval(PRINTERSTATUS status) const;
+	static bool isIdle(PRINTERSTATUS status);
+
+	std::atomic<bool> kicked;
+
+	// written by the BLE task
+	std::atomic<uint32_t> lastFresh;	// last status message [ms]
+	std::atomic<uint32_t> lastLayer;	// last layer change [ms]
+	std::atomic<int32_t> layer;			// layer number of lastLayer
+	std::atomic<uint32_t> layerCadence; // smoothed time between layers [ms], 0 if unknown
+
+	PRINTERSTATUS state;
+	unsigned long lastPoll;
+	uint32_t interval;
+	uint8_t burst;	 // doublings since the last command or state change
+	uint8_t backoff; // doublings of the idle interval
+	bool bursting;
+	uint32_t skippedFresh; // lastFresh of the last skipped request
+
+	// statistics
+	uint32_t polls;
+	uint32_t skipped;
+};
+
+#endif // _STATUSPOLLER_h
@@ -0,0 +1,465 @@
+/*
+	WebSocket Server (RFC 6455)
+*/
+#include "WebSocketServer.h"
+
+// frame opcodes
+static const uint8_t WS_CONTINUATION = 0x0;
+static const uint8_t WS_TEXT = 0x1;
+static const uint8_t WS_BINARY = 0x2;
+static const uint8_t WS_CLOSE = 0x8;
+static const uint8_t WS_PING = 0x9;
+static const uint8_t WS_PONG = 0xA;
+
+// close status codes
+static const uint16_t WS_CLOSE_NORMAL = 1000;
+static const uint16_t WS_CLOSE_PROTOCOL_ERROR = 1002;
+static const uint16_t WS_CLOSE_UNSUPPORTED = 1003;
+static const uint16_t WS_CLOSE_TOO_BIG = 1009;
+
+static const char *WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+/**
+ * SHA-1 digest, only used for the handshake
+ */
+static void sha1(const uint8_t *data, size_t length, uint8_t digest[20])
+{
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	uint8_t block[64];
+	uint64_t bits = (uint64_t)length * 8;
+	size_t blocks = (length + 8) / 64 + 1;
+
+	for (size_t b = 0; b < blocks; b++)
+	{
+		// message, 0x80 padding and bit length
+		for (size_t i = 0; i < 64; i++)
+		{
+			size_t pos = b * 64 + i;
+			if (pos < length)
+				block[i] = data[pos];
+			else if (pos == length)
+				block[i] = 0x80;
+			else
+				block[i] = 0x00;
+		}
+		if (b == blocks - 1)
+		{
+			for (uint8_t i = 0; i < 8; i++)
+				block[63 - i] = (uint8_t)(bits >> (8 * i));
+		}
+
+		uint32_t w[80];
+		for (uint8_t i = 0; i < 16; i++)
+			w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+		for (uint8_t i = 16; i < 80; i++)
+		{
+			uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+			w[i] = (x << 1) | (x >> 31);
+		}
+
+		uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+		for (uint8_t i = 0; i < 80; i++)
+		{
+			uint32_t f, k;
+			if (i < 20)
+			{
+				f = (bb & c) | (~bb & d);
+				k = 0x5A827999;
+			}
+			else if (i < 40)
+			{
+				f = bb ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (i < 60)
+			{
+				f = (bb & c) | (bb & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else
+			{
+				f = bb ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			uint32_t temp = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = (bb << 30) | (bb >> 2);
+			bb = a;
+			a = temp;
+		}
+		h[0] += a;
+		h[1] += bb;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	for (uint8_t i = 0; i < 5; i++)
+	{
+		digest[i * 4] = h[i] >> 24;
+		digest[i * 4 + 1] = h[i] >> 16;
+		digest[i * 4 + 2] = h[i] >> 8;
+		digest[i * 4 + 3] = h[i];
+	}
+}
+
+/**
+ * base64 encoding
+ */
+static String base64(const uint8_t *data, size_t length)
+{
+	static const char *chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	String str;
+	for (size_t i = 0; i < length; i += 3)
+	{
+		uint32_t n = (uint32_t)data[i] << 16;
+		if (i + 1 < length)
+			n |= (uint32_t)data[i + 1] << 8;
+		if (i + 2 < length)
+			n |= data[i + 2];
+		str += chars[(n >> 18) & 0x3F];
+		str += chars[(n >> 12) & 0x3F];
+		str += i + 1 < length ? chars[(n >> 6) & 0x3F] : '=';
+		str += i + 2 < length ? chars[n & 0x3F] : '=';
+	}
+	return str;
+}
+
+WebSocketServer::WebSocketServer(uint16_t port) : server(port)
+{
+}
+
+void WebSocketServer::begin()
+{
+	server.begin();
+	server.setNoDelay(true);
+	pollTime = micros();
+}
+
+void WebSocketServer::loop()
+{
+	accept();
+
+	unsigned long time = millis();
+	for (uint8_t id = 0; id < MAX_CLIENTS; id++)
+	{
+		Connection &connection = connections[id];
+		if (connection.state == WS_CLOSED)
+			continue;
+
+		if (!connection.client.connected())
+		{
+			connection.client.stop();
+			connection.state = WS_CLOSED;
+			continue;
+		}
+
+		if (connection.state == WS_HANDSHAKE)
+		{
+			if (time - connection.timestamp > HANDSHAKE_TIMEOUT)
+			{
+				connection.client.stop();
+				connection.state = WS_CLOSED;
+			}
+			else
+			{
+				handshake(connection);
+				if (connection.state == WS_OPEN && openHandler)
+					openHandler(id);
+			}
+			continue;
+		}
+
+		receive(id);
+
+		// measure round-trip time, the payload is echoed by the pong
+		if (connection.state == WS_OPEN && time - connection.timestamp > PING_INTERVAL)
+		{
+			connection.timestamp = time;
+			connection.pingPayload = micros();
+			sendFrame(connection, WS_PING, (const uint8_t *)&connection.pingPayload, sizeof(connection.pingPayload));
+		}
+	}
+	pollTime = micros();
+}
+
+/**
+ * accept new TCP connections
+ */
+void WebSocketServer::accept()
+{
+	WiFiClient client = server.available();
+	if (!client)
+		return;
+
+	for (uint8_t id = 0; id < MAX_CLIENTS; id++)
+	{
+		Connection &connection = connections[id];
+		if (connection.state != WS_CLOSED)
+			continue;
+
+		client.setNoDelay(true);
+		connection.client = client;
+		connection.state = WS_HANDSHAKE;
+		connection.timestamp = millis();
+		connection.roundTripTime = 0;
+		connection.key = "";
+		connection.upgrade = false;
+		connection.received = 0;
+		return;
+	}
+
+	// no free connection
+	Serial.println("FAILURE: too many WebSocket clients");
+	client.print("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	client.stop();
+}
+
+/**
+ * read HTTP upgrade request line by line and answer it
+ */
+void WebSocketServer::handshake(Connection &connection)
+{
+	while (connection.client.available())
+	{
+		int c = connection.client.read();
+		if (c < 0)
+			break;
+		if (c != '\n')
+		{
+			// overlong header lines are cut, only short headers are of interest
+			if (c != '\r' && connection.received < sizeof(connection.buffer) - 1)
+				connection.buffer[connection.received++] = c;
+			continue;
+		}
+
+		connection.buffer[connection.received] = 0x00;
+		String line((const char *)connection.buffer);
+		connection.received = 0;
+
+		if (line.length())
+		{
+			// header line
+			int pos = line.indexOf(':');
+			if (pos < 0)
+				continue;
+			String name = line.substring(0, pos);
+			String value = line.substring(pos + 1);
+			value.trim();
+			if (name.equalsIgnoreCase("Sec-WebSocket-Key"))
+				connection.key = value;
+			else if (name.equalsIgnoreCase("Upgrade") && value.equalsIgnoreCase("websocket"))
+				connection.upgrade = true;
+			continue;
+		}
+
+		// end of request
+		if (!connection.upgrade || !connection.key.length())
+		{
+			connection.client.print("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+			connection.client.stop();
+			connection.state = WS_CLOSED;
+			return;
+		}
+
+		uint8_t digest[20];
+		String accept = connection.key + WS_GUID;
+		sha1((const uint8_t *)accept.c_str(), accept.length(), digest);
+		String response =
+			"HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: " + base64(digest, sizeof(digest)) + "\r\n\r\n";
+		connection.client.print(response);
+		connection.state = WS_OPEN;
+		connection.timestamp = millis() - PING_INTERVAL; // measure round-trip time right away
+		connection.key = "";
+		return;
+	}
+}
+
+/**
+ * read and process frames
+ */
+void WebSocketServer::receive(uint8_t id)
+{
+	Connection &connection = connections[id];
+	while (connection.state == WS_OPEN)
+	{
+		// fill buffer
+		int available = connection.client.available();
+		size_t space = sizeof(connection.buffer) - 1 - connection.received;
+		if (available > 0 && space > 0)
+		{
+			int len = connection.client.read(connection.buffer + connection.received, (size_t)available < space ? available : space);
+			if (len > 0)
+				connection.received += len;
+		}
+
+		// frame header
+		uint8_t *buffer = connection.buffer;
+		if (connection.received < 2)
+			return;
+		bool fin = buffer[0] & 0x80;
+		uint8_t opcode = buffer[0] & 0x0F;
+		bool masked = buffer[1] & 0x80;
+		size_t length = buffer[1] & 0x7F;
+		size_t header = 2;
+		if (length == 126)
+		{
+			if (connection.received < 4)
+				return;
+			length = (size_t)buffer[2] << 8 | buffer[3];
+			header = 4;
+		}
+		else if (length == 127)
+		{
+			close(connection, WS_CLOSE_TOO_BIG);
+			return;
+		}
+		if (!masked)
+		{
+			// client frames must be masked
+			close(connection, WS_CLOSE_PROTOCOL_ERROR);
+			return;
+		}
+		if (length > MAX_MESSAGE_SIZE)
+		{
+			close(connection, WS_CLOSE_TOO_BIG);
+			return;
+		}
+		size_t frameLength = header + 4 + length;
+		if (connection.received < frameLength)
+			return;
+
+		// unmask payload
+		const uint8_t *mask = buffer + header;
+		uint8_t *payload = buffer + header + 4;
+		for (size_t i = 0; i < length; i++)
+			payload[i] ^= mask[i & 3];
+
+		switch (opcode)
+		{
+		case WS_TEXT:
+			if (!fin)
+			{
+				// fragmented messages are not supported
+				close(connection, WS_CLOSE_UNSUPPORTED);
+				return;
+			}
+			{
+				// terminate message, the following frame is moved down afterwards anyway
+				uint8_t next = payload[length];
+				payload[length] = 0x00;
+				if (messageHandler)
+					messageHandler(id, (const char *)payload, length);
+				payload[length] = next;
+			}
+			break;
+
+		case WS_PING:
+			sendFrame(connection, WS_PONG, payload, length);
+			break;
+
+		case WS_PONG:
+			if (length == sizeof(connection.pingPayload) && memcmp(payload, &connection.pingPayload, length) == 0)
+				connection.roundTripTime = micros() - connection.pingPayload;
+			break;
+
+		case WS_CLOSE:
+			close(connection, WS_CLOSE_NORMAL);
+			return;
+
+		case WS_CONTINUATION:
+		case WS_BINARY:
+		default:
+			close(connection, WS_CLOSE_UNSUPPORTED);
+			return;
+		}
+
+		// remove frame from buffer
+		connection.received -= frameLength;
+		memmove(buffer, buffer + frameLength, connection.received);
+	}
+}
+
+bool WebSocketServer::sendFrame(Connection &connection, uint8_t opcode, const uint8_t *payload, size_t length)
+{
+	if (connection.state != WS_OPEN)
+		return false;
+
+	uint8_t header[4];
+	size_t headerLength = 2;
+	header[0] = 0x80 | opcode;
+	if (length < 126)
+	{
+		header[1] = length;
+	}
+	else if (length <= 0xFFFF)
+	{
+		header[1] = 126;
+		header[2] = length >> 8;
+		header[3] = length;
+		headerLength = 4;
+	}
+	else
+	{
+		return false;
+	}
+
+	// small frames are sent in one segment
+	uint8_t frame[256];
+	if (headerLength + length <= sizeof(frame))
+	{
+		memcpy(frame, header, headerLength);
+		memcpy(frame + headerLength, payload, length);
+		length += headerLength;
+		if (connection.client.write(frame, length) == length)
+			return true;
+	}
+	else if (connection.client.write(header, headerLength) == headerLength && connection.client.write(payload, length) == length)
+	{
+		return true;
+	}
+
+	// connection broken
+	connection.client.stop();
+	connection.state = WS_CLOSED;
+	return false;
+}
+
+void WebSocketServer::close(Connection &connection, uint16_t code)
+{
+	uint8_t payload[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+	sendFrame(connection, WS_CLOSE, payload, sizeof(payload));
+	connection.client.stop();
+	connection.state = WS_CLOSED;
+}
+
+bool WebSocketServer::sendText(uint8_t client, const char *message, size_t length)
+{
+	if (client >= MAX_CLIENTS)
+		return false;
+	return sendFrame(connections[client], WS_TEXT, (const uint8_t *)message, length);
+}
+
+void WebSocketServer::broadcastText(const String &message)
+{
+	for (uint8_t id = 0; id < MAX_CLIENTS; id++)
+	{
+		if (connections[id].state == WS_OPEN)
+			sendFrame(connections[id], WS_TEXT, (const uint8_t *)message.c_str(), message.length());
+	}
+}
+
+uint8_t WebSocketServer::count() const
+{
+	uint8_t n = 0;
+	for (uint8_t id = 0; id < MAX_CLIENTS; id++)
+	{
+		if (connections[id].state == WS_OPEN)
+			n++;
+	}
+	return n;
+}
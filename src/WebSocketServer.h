@@ -0,0 +1,94 @@
+/*
+	WebSocket Server (RFC 6455)
+*/
+#ifndef _WEBSOCKETSERVER_h
+#define _WEBSOCKETSERVER_h
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+
+/**
+ * minimal WebSocket server for short text messages
+ * runs next to the HTTP server on its own port, connections stay open for commands and state updates
+ */
+class WebSocketServer
+{
+  public:
+	static const uint8_t MAX_CLIENTS = 4;
+	static const uint16_t MAX_MESSAGE_SIZE = 512;  // max payload of received messages
+	static const uint32_t PING_INTERVAL = 5000;	   // round-trip time measurement [ms]
+	static const uint32_t HANDSHAKE_TIMEOUT = 5000; // [ms]
+
+	typedef std::function<void(uint8_t client, const char *message, size_t length)> MessageHandler;
+	typedef std::function<void(uint8_t client)> OpenHandler;
+
+	WebSocketServer(uint16_t port);
+
+	void begin();
+	void loop();
+
+	/**
+	 * set handler for received text messages (message is terminated)
+	 */
+	void onMessage(MessageHandler handler) { messageHandler = handler; }
+
+	/**
+	 * set handler for new connections, called after the handshake, e.g. to reset per client state of a reused slot
+	 */
+	void onOpen(OpenHandler handler) { openHandler = handler; }
+
+	bool sendText(uint8_t client, const char *message, size_t length);
+	bool sendText(uint8_t client, const String &message) { return sendText(client, message.c_str(), message.length()); }
+	void broadcastText(const String &message);
+
+	/**
+	 * number of open connections
+	 */
+	uint8_t count() const;
+
+	/**
+	 * round-trip time of the last ping [us], 0 if not measured yet
+	 */
+	uint32_t getRoundTripTime(uint8_t client) const { return client < MAX_CLIENTS ? connections[client].roundTripTime : 0; }
+
+	/**
+	 * earliest arrival of the message being handled [us], the end of the previous poll
+	 */
+	unsigned long getRequestTime() const { return pollTime; }
+
+  private:
+	typedef enum
+	{
+		WS_CLOSED,
+		WS_HANDSHAKE,
+		WS_OPEN
+	} WSSTATE;
+
+	typedef struct
+	{
+		WiFiClient client;
+		WSSTATE state = WS_CLOSED;
+		unsigned long timestamp = 0; // connect time, last ping sent
+		uint32_t pingPayload = 0;
+		uint32_t roundTripTime = 0;
+		String key; // Sec-WebSocket-Key
+		bool upgrade = false;
+		uint16_t received = 0;
+		uint8_t buffer[MAX_MESSAGE_SIZE + 16]; // frame header, payload and terminator
+	} Connection;
+
+	void accept();
+	void handshake(Connection &connection);
+	void receive(uint8_t id);
+	bool sendFrame(Connection &connection, uint8_t opcode, const uint8_t *payload, size_t length);
+	void close(Connection &connection, uint16_t code);
+
+	WiFiServer server;
+	Connection connections[MAX_CLIENTS];
+	MessageHandler messageHandler;
+	OpenHandler openHandler;
+	unsigned long pollTime = 0;
+};
+
+#endif // _WEBSOCKETSERVER_h
@@ -0,0 +1,450 @@
+/*
+	WiFi Client Connection
+*/
+#include "WifiConnector.h"
+#include "BootProfiler.h"
+#include <ArduinoJson.h>
+#include "config.h"
+
+extern DynamicJsonDocument config;
+
+static const char *CACHE_FILE = "/wifi.json";
+
+const char *wifiConnectStateNames[] = {
+	"IDLE",
+	"PENDING",
+	"SCANNING",
+	"CONNECTING",
+	"CONNECTED",
+	"FAILED"};
+
+/**
+ * format BSSID as "01:23:45:67:89:AB"
+ */
+static String bssidToString(const uint8_t *bssid)
+{
+	char buffer[18];
+	snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X", bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+	return String(buffer);
+}
+
+static bool bssidFromString(const char *text, uint8_t *bssid)
+{
+	if (!text || strlen(text) != 17)
+		return false;
+	for (int i = 0; i < 6; i++)
+		bssid[i] = strtoul(text + i * 3, NULL, 16);
+	return true;
+}
+
+WifiConnector::WifiConnector(WifiScanner &scanner) : scanner(scanner), scanGeneration(0), state(WIFI_CLIENT_IDLE), current(0), scanAfterCandidates(false), timestamp(0), connectStarted(0), lastScan(0), connectTimeout(5000), failures(0),
+													 roamThreshold(0), rssiChecked(0), roamScan(0), roamGeneration(0), connectTime(0), reconnects(0), roams(0)
+{
+}
+
+void WifiConnector::begin()
+{
+	DynamicJsonDocument cache(CACHE_JSON_SIZE);
+	if (!loadConfig(cache, CACHE_FILE))
+		return;
+
+	lastSSID = cache["last"] | "";
+	for (JsonPair kv : cache["networks"].as<JsonObject>())
+	{
+		AccessPoint accessPoint;
+		accessPoint.ssid = kv.key().c_str();
+		accessPoint.channel = kv.value()["channel"] | 0;
+		if (accessPoint.channel && bssidFromString(kv.value()["bssid"], accessPoint.bssid) && accessPoints.size() < MAX_CACHED_NETWORKS)
+			accessPoints.push_back(accessPoint);
+	}
+	Serial.print("WiFi: cached access points: ");
+	Serial.println(accessPoints.size());
+}
+
+void WifiConnector::connect(const String &ssid, const String &pwd)
+{
+	candidates.clear();
+	Candidate candidate = {ssid, pwd, 0, {0}, 0, false};
+	const AccessPoint *accessPoint = findCached(ssid);
+	if (accessPoint)
+	{
+		memcpy(candidate.bssid, accessPoint->bssid, sizeof(candidate.bssid));
+		candidate.channel = accessPoint->channel;
+	}
+	candidates.push_back(candidate);
+	current = 0;
+	scanAfterCandidates = true;
+	failures = 0;
+	state = WIFI_CLIENT_PENDING;
+	timestamp = millis();
+	connectStarted = timestamp;
+}
+
+void WifiConnector::connectKnown()
+{
+	candidates.clear();
+	scanAfterCandidates = true;
+	failures = 0;
+	state = WIFI_CLIENT_PENDING;
+	timestamp = millis();
+	connectStarted = timestamp;
+}
+
+void WifiConnector::loop()
+{
+	switch (state)
+	{
+	case WIFI_CLIENT_PENDING:
+		if (millis() - timestamp < START_DELAY)
+			break;
+		start();
+		break;
+
+	case WIFI_CLIENT_SCANNING:
+	{
+		if (scanner.getGeneration() == scanGeneration)
+		{
+			// wait for new result, retry later if the scan could not be started
+			if (!scanner.isRunning())
+			{
+				Serial.println("WiFi: scan failed");
+				fail();
+			}
+			break;
+		}
+		addKnownNetworks();
+		if (candidates.empty())
+		{
+			Serial.println("WiFi: no known network found");
+			fail();
+			break;
+		}
+		current = 0;
+		tryCandidate();
+		break;
+	}
+
+	case WIFI_CLIENT_CONNECTING:
+	{
+		wl_status_t status = WiFi.status();
+		uint32_t timeout = candidates[current].direct ? DIRECT_TIMEOUT : connectTimeout;
+		if (status == WL_CONNECTED)
+		{
+			connected();
+		}
+		else if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL || millis() - timestamp > timeout)
+		{
+			Serial.print("WiFi: connecting to ");
+			Serial.print(candidates[current].ssid);
+			Serial.println(" failed");
+			nextCandidate();
+		}
+		break;
+	}
+
+	case WIFI_CLIENT_CONNECTED:
+		if (WiFi.status() != WL_CONNECTED)
+		{
+			Serial.println("WiFi: connection lost");
+			reconnects++;
+			candidates.clear();
+			scanAfterCandidates = true;
+			connectStarted = millis();
+			start();
+			break;
+		}
+		checkRoaming();
+		break;
+
+	case WIFI_CLIENT_FAILED:
+		// every attempt takes the radio off the channel of the access point, portal clients notice
+		if (millis() - lastScan > retryInterval(RETRY_INTERVAL))
+		{
+			scanKnown();
+		}
+		else if (millis() - timestamp > retryInterval(DIRECT_RETRY_INTERVAL))
+		{
+			// cached access point may be back, e.g. after a router reboot
+			candidates.clear();
+			scanAfterCandidates = false;
+			if (addCachedNetwork())
+			{
+				current = 0;
+				tryCandidate();
+			}
+			else
+				timestamp = millis();
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ * start with given or cached network, scan if there is none
+ */
+void WifiConnector::start()
+{
+	if (candidates.empty() && !addCachedNetwork())
+	{
+		scanKnown();
+		return;
+	}
+	current = 0;
+	tryCandidate();
+}
+
+void WifiConnector::scanKnown()
+{
+	Serial.println("WiFi: scan for known networks");
+	candidates.clear();
+	current = 0;
+	scanAfterCandidates = false;
+	WiFi.disconnect();
+	scanGeneration = scanner.getGeneration();
+	scanner.start();
+	state = WIFI_CLIENT_SCANNING;
+	timestamp = millis();
+	lastScan = timestamp;
+}
+
+/**
+ * add networks from scan result we have credentials for, strongest access point first
+ */
+void WifiConnector::addKnownNetworks()
+{
+	auto credentials = config["Credentials"].as<JsonObject>();
+	for (const auto &network : scanner.getNetworks())
+	{
+		Serial.print("Found Network: "); Serial.print(network.ssid);
+		Serial.print(" ("); Serial.print(network.rssi); Serial.print(")");
+		if (!credentials.containsKey(network.ssid))
+		{
+			Serial.println(" unknown");
+			continue;
+		}
+		Serial.println(" known");
+
+		// the same network can be seen from several access points
+		bool found = false;
+		for (size_t j = 0; j < candidates.size() && !found; j++)
+			found = candidates[j].ssid == network.ssid;
+		if (!found)
+		{
+			Candidate candidate = {network.ssid, credentials[network.ssid].as<String>(), network.rssi, {0}, network.channel, false};
+			memcpy(candidate.bssid, network.bssid, sizeof(candidate.bssid));
+			candidates.push_back(candidate);
+		}
+	}
+}
+
+/**
+ * add access point of last connection
+ * @return false if there is none or the credentials were removed
+ */
+bool WifiConnector::addCachedNetwork()
+{
+	const AccessPoint *accessPoint = findCached(lastSSID);
+	auto credentials = config["Credentials"].as<JsonObject>();
+	if (!accessPoint || !credentials.containsKey(lastSSID))
+		return false;
+
+	Candidate candidate = {lastSSID, credentials[lastSSID].as<String>(), 0, {0}, accessPoint->channel, true};
+	memcpy(candidate.bssid, accessPoint->bssid, sizeof(candidate.bssid));
+	candidates.push_back(candidate);
+	return true;
+}
+
+void WifiConnector::tryCandidate()
+{
+	const Candidate &candidate = candidates[current];
+	Serial.print("WiFi: connecting to ");
+	Serial.print(candidate.ssid);
+	if (candidate.channel)
+	{
+		Serial.print(" (");
+		Serial.print(bssidToString(candidate.bssid));
+		Serial.print(", channel ");
+		Serial.print(candidate.channel);
+		Serial.print(")");
+	}
+	Serial.println(" ... ");
+
+	// known access point and channel skip the scan of the WiFi driver
+	WiFi.disconnect();
+	if (candidate.channel)
+		WiFi.begin(candidate.ssid.c_str(), candidate.pwd.c_str(), candidate.channel, candidate.bssid);
+	else
+		WiFi.begin(candidate.ssid.c_str(), candidate.pwd.c_str());
+	state = WIFI_CLIENT_CONNECTING;
+	timestamp = millis();
+}
+
+void WifiConnector::nextCandidate()
+{
+	current++;
+	if (current < candidates.size())
+	{
+		tryCandidate();
+		return;
+	}
+
+	if (scanAfterCandidates)
+	{
+		// given or cached network failed, fallback to known networks
+		scanKnown();
+		return;
+	}
+
+	Serial.println("WiFi: no connection");
+	WiFi.disconnect();
+	fail();
+}
+
+void WifiConnector::connected()
+{
+	state = WIFI_CLIENT_CONNECTED;
+	failures = 0;
+	connectTime = millis() - connectStarted;
+	rssiChecked = millis();
+	roamGeneration = scanner.getGeneration();
+
+	String ssid = candidates[current].ssid;
+	BootProfiler::event("wifi connected");
+	Serial.print("WiFi: connected to ");
+	Serial.print(ssid);
+	Serial.print(" in ");
+	Serial.print(connectTime);
+	Serial.print(" ms, IP Address: ");
+	Serial.println(WiFi.localIP());
+
+	// update cache
+	uint8_t *bssid = WiFi.BSSID();
+	int32_t channel = WiFi.channel();
+	if (!bssid || !channel)
+		return;
+	const AccessPoint *cached = findCached(ssid);
+	if (cached && ssid == lastSSID && cached->channel == channel && !memcmp(cached->bssid, bssid, sizeof(cached->bssid)))
+		return;
+
+	AccessPoint accessPoint;
+	accessPoint.ssid = ssid;
+	memcpy(accessPoint.bssid, bssid, sizeof(accessPoint.bssid));
+	accessPoint.channel = channel;
+	for (size_t i = 0; i < accessPoints.size(); i++)
+	{
+		if (accessPoints[i].ssid == ssid)
+		{
+			accessPoints.erase(accessPoints.begin() + i);
+			break;
+		}
+	}
+	if (accessPoints.size() >= MAX_CACHED_NETWORKS)
+		accessPoints.pop_back();
+	accessPoints.insert(accessPoints.begin(), accessPoint);
+	lastSSID = ssid;
+	saveCache();
+}
+
+/**
+ * look for a stronger access point of the current network if the signal is weak
+ * every new scan result is checked, a scan is started if the signal stays below the threshold
+ */
+void WifiConnector::checkRoaming()
+{
+	if (!roamThreshold)
+		return;
+
+	if (millis() - rssiChecked > RSSI_CHECK_INTERVAL)
+	{
+		rssiChecked = millis();
+		if (WiFi.RSSI() < roamThreshold && !scanner.isRunning() && (!roamScan || millis() - roamScan > ROAM_SCAN_INTERVAL))
+		{
+			Serial.print("WiFi: weak signal ");
+			Serial.print(WiFi.RSSI());
+			Serial.println(" dBm, scan for access points");
+			roamScan = millis();
+			scanner.start();
+		}
+	}
+
+	if (scanner.getGeneration() == roamGeneration)
+		return;
+	roamGeneration = scanner.getGeneration();
+
+	int32_t rssi = WiFi.RSSI();
+	if (rssi >= roamThreshold)
+		return;
+	String ssid = WiFi.SSID();
+	uint8_t *bssid = WiFi.BSSID();
+	for (const auto &network : scanner.getNetworks())
+	{
+		// strongest access point comes first
+		if (network.ssid != ssid)
+			continue;
+		if (network.rssi < rssi + ROAM_HYSTERESIS || (bssid && !memcmp(network.bssid, bssid, sizeof(network.bssid))))
+			return;
+
+		Serial.print("WiFi: roaming from ");
+		Serial.print(rssi);
+		Serial.print(" dBm to ");
+		Serial.print(network.rssi);
+		Serial.println(" dBm");
+		roams++;
+		Candidate candidate = {ssid, config["Credentials"][ssid] | "", network.rssi, {0}, network.channel, true};
+		memcpy(candidate.bssid, network.bssid, sizeof(candidate.bssid));
+		candidates.clear();
+		candidates.push_back(candidate);
+		current = 0;
+		scanAfterCandidates = true;
+		connectStarted = millis();
+		tryCandidate();
+		return;
+	}
+}
+
+void WifiConnector::fail()
+{
+	state = WIFI_CLIENT_FAILED;
+	timestamp = millis();
+	if (failures < UINT8_MAX)
+		failures++;
+}
+
+/**
+ * retry interval after the current number of failures
+ */
+uint32_t WifiConnector::retryInterval(uint32_t interval) const
+{
+	uint8_t shift = failures > 10 ? 9 : failures > 1 ? failures - 1 : 0;
+	interval <<= shift;
+	if (interval > MAX_RETRY_INTERVAL)
+		interval = MAX_RETRY_INTERVAL;
+	return interval;
+}
+
+const WifiConnector::AccessPoint *WifiConnector::findCached(const String &ssid) const
+{
+	for (size_t i = 0; i < accessPoints.size(); i++)
+	{
+		if (accessPoints[i].ssid == ssid)
+			return &accessPoints[i];
+	}
+	return NULL;
+}
+
+void WifiConnector::saveCache()
+{
+	DynamicJsonDocument cache(CACHE_JSON_SIZE);
+	cache["last"] = lastSSID;
+	JsonObject networks = cache.createNestedObject("networks");
+	for (size_t i = 0; i < accessPoints.size(); i++)
+	{
+		JsonObject network = networks.createNestedObject(accessPoints[i].ssid);
+		network["bssid"] = bssidToString(accessPoints[i].bssid);
+		network["channel"] = accessPoints[i].channel;
+	}
+	saveConfig(cache, CACHE_FILE);
+}
@@ -0,0 +1,157 @@
+/*
+	WiFi Client Connection
+*/
+#ifndef _WIFICONNECTOR_h
+#define _WIFICONNECTOR_h
+
+#include <Arduino.h>
+#if defined(ESP32) || defined(NATIVE)
+	#include <WiFi.h>
+#endif
+#ifdef ESP8266
+	#include <ESP8266WiFi.h>
+#endif
+#include <ArduinoJson.h>
+#include <vector>
+#include "WifiScanner.h"
+
+typedef enum
+{
+	WIFI_CLIENT_IDLE,
+	WIFI_CLIENT_PENDING,
+	WIFI_CLIENT_SCANNING,
+	WIFI_CLIENT_CONNECTING,
+	WIFI_CLIENT_CONNECTED,
+	WIFI_CLIENT_FAILED
+} WIFICONNECTSTATE;
+
+extern const char *wifiConnectStateNames[];
+
+/**
+ * connects as WiFi client without blocking
+ * loop() advances scan and association, every candidate network gets its own timeout
+ * BSSID and channel of the last connection are cached, reconnects try this access point directly before scanning
+ * a weak connection is moved to a stronger access point of the same network
+ */
+class WifiConnector
+{
+  public:
+	static const uint32_t START_DELAY = 100;			// requests from HTTP handlers start after the response was sent [ms]
+	static const uint32_t RETRY_INTERVAL = 30000;		// scan again after all networks failed [ms]
+	static const uint32_t DIRECT_TIMEOUT = 2000;		// connect to cached access point [ms]
+	static const uint32_t DIRECT_RETRY_INTERVAL = 1000; // retry cached access point while there is no connection [ms]
+	static const uint32_t MAX_RETRY_INTERVAL = 300000;	// retry intervals double with every failure up to this limit [ms]
+	static const uint32_t RSSI_CHECK_INTERVAL = 5000;	// [ms]
+	static const uint32_t ROAM_SCAN_INTERVAL = 60000;	// min. time between scans for a stronger access point [ms]
+	static const int32_t ROAM_HYSTERESIS = 8;			// min. RSSI gain for roaming [dB]
+	static const uint8_t MAX_CACHED_NETWORKS = 8;
+	// per network: SSID, BSSID and the key names copied from the file, one more entry covers "last"
+	static const size_t CACHE_JSON_SIZE = JSON_OBJECT_SIZE(2) + JSON_OBJECT_SIZE(MAX_CACHED_NETWORKS) + (MAX_CACHED_NETWORKS + 1) * (JSON_OBJECT_SIZE(2) + 33 + 18 + 14);
+
+	WifiConnector(WifiScanner &scanner);
+
+	/**
+	 * load cached access points
+	 */
+	void begin();
+
+	/**
+	 * timeout for each candidate network [s]
+	 */
+	void setTimeout(uint16_t timeout) { connectTimeout = timeout * 1000UL; }
+
+	/**
+	 * look for a stronger access point below this RSSI [dBm], 0 disables roaming
+	 */
+	void setRoamThreshold(int32_t rssi) { roamThreshold = rssi; }
+
+	/**
+	 * try given network first, known networks are the fallback
+	 */
+	void connect(const String &ssid, const String &pwd);
+
+	/**
+	 * connect to cached access point or scan and connect to the strongest known network
+	 */
+	void connectKnown();
+
+	void loop();
+
+	WIFICONNECTSTATE getState() const { return state; }
+	const char *getStateName() const { return wifiConnectStateNames[state]; }
+
+	/**
+	 * network currently tried
+	 */
+	String getCandidate() const { return current < candidates.size() ? candidates[current].ssid : String(); }
+	uint8_t getAttempt() const { return current < candidates.size() ? current + 1 : candidates.size(); }
+	uint8_t getCandidateCount() const { return candidates.size(); }
+
+	/**
+	 * duration of the last connect, from start or loss of connection until connected [ms]
+	 */
+	uint32_t getConnectTime() const { return connectTime; }
+	uint16_t getReconnects() const { return reconnects; }
+	uint16_t getRoams() const { return roams; }
+
+  private:
+	typedef struct
+	{
+		String ssid;
+		String pwd;
+		int32_t rssi;
+		uint8_t bssid[6];
+		int32_t channel; // 0: access point not known
+		bool direct;	 // cached access point, short timeout
+	} Candidate;
+
+	typedef struct
+	{
+		String ssid;
+		uint8_t bssid[6];
+		int32_t channel;
+	} AccessPoint;
+
+	void start();
+	void scanKnown();
+	void addKnownNetworks();
+	bool addCachedNetwork();
+	void tryCandidate();
+	void nextCandidate();
+	void connected();
+	void checkRoaming();
+	void fail();
+	uint32_t retryInterval(uint32_t interval) const;
+
+	const AccessPoint *findCached(const String &ssid) const;
+	void saveCache();
+
+	WifiScanner &scanner;
+	uint32_t scanGeneration; // result of previous scan
+	WIFICONNECTSTATE state;
+	std::vector<Candidate> candidates;
+	size_t current;
+	bool scanAfterCandidates; // scan for known networks if the given network fails
+	unsigned long timestamp;  // start of current state
+	unsigned long connectStarted;
+	unsigned long lastScan;
+	uint32_t connectTimeout;
+	uint8_t failures; // since the last connection or request
+
+	// access point cache
+	std::vector<AccessPoint> accessPoints;
+	String lastSSID;
+
+	// roaming
+	int32_t roamThreshold;
+	unsigned long rssiChecked;
+	unsigned long roamScan;
+	uint32_t roamGeneration;
+
+	// statistics
+	uint32_t connectTime;
+	uint16_t reconnects;
+	uint16_t roams;
+};
+
+#endif // _WIFICONNECTOR_h
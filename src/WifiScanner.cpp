@@ -0,0 +1,87 @@
+/*
+	WiFi Network Scanner
+*/
+#include "WifiScanner.h"
+#include <algorithm>
+
+WifiScanner::WifiScanner() : running(false), retry(false), failTime(0), generation(0), timestamp(0)
+{
+}
+
+void WifiScanner::start()
+{
+	if (running)
+		return;
+	WiFi.scanDelete();
+	int16_t n = WiFi.scanNetworks(true, false); //WiFi.scanNetworks(async, show_hidden)
+	if (n == WIFI_SCAN_FAILED)
+	{
+		Serial.println("WiFi scan: start failed");
+		failed();
+		return;
+	}
+	running = true;
+	retry = false;
+	Serial.println("WiFi scan: started");
+}
+
+void WifiScanner::refresh(uint32_t maxAge)
+{
+	if (getAge() > maxAge)
+		start();
+}
+
+void WifiScanner::loop(bool retryAllowed)
+{
+	if (!running)
+	{
+		if (retry && retryAllowed && millis() - failTime >= RETRY_DELAY)
+			start();
+		return;
+	}
+
+	int16_t n = WiFi.scanComplete();
+	if (n == WIFI_SCAN_RUNNING)
+		return;
+	running = false;
+	if (n < 0)
+	{
+		// keep the previous result and its age, an empty list would look like a fresh result
+		Serial.println("WiFi scan: failed");
+		failed();
+	}
+	else
+		collect(n);
+	WiFi.scanDelete();
+}
+
+void WifiScanner::failed()
+{
+	retry = true;
+	failTime = millis();
+}
+
+/**
+ * copy scan result
+ */
+void WifiScanner::collect(int16_t count)
+{
+	networks.clear();
+	for (int16_t i = 0; i < count; i++)
+	{
+		Network network;
+		network.ssid = WiFi.SSID(i);
+		network.rssi = WiFi.RSSI(i);
+		network.encrypted = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+		memcpy(network.bssid, WiFi.BSSID(i), sizeof(network.bssid));
+		network.channel = WiFi.channel(i);
+		networks.push_back(network);
+	}
+	std::sort(networks.begin(), networks.end(), [](const Network &a, const Network &b) { return a.rssi > b.rssi; });
+
+	generation++;
+	timestamp = millis();
+	Serial.print("WiFi scan: ");
+	Serial.print(networks.size());
+	Serial.println(" networks");
+}
@@ -0,0 +1,81 @@
+/*
+	WiFi Network Scanner
+*/
+#ifndef _WIFISCANNER_h
+#define _WIFISCANNER_h
+
+#include <Arduino.h>
+#if defined(ESP32) || defined(NATIVE)
+	#include <WiFi.h>
+#endif
+#ifdef ESP8266
+	#include <ESP8266WiFi.h>
+#endif
+#include <vector>
+
+/**
+ * runs WiFi scans in the background and caches the result
+ * shared by the network list of the portal and the client connection
+ */
+class WifiScanner
+{
+  public:
+	static const uint32_t RETRY_DELAY = 2000; // retry a failed scan [ms]
+
+	typedef struct
+	{
+		String ssid;
+		int32_t rssi;
+		bool encrypted;
+		uint8_t bssid[6];
+		int32_t channel;
+	} Network;
+
+	WifiScanner();
+
+	/**
+	 * start scan, ignored while a scan is running
+	 * a failed scan keeps the previous result and is retried after RETRY_DELAY
+	 */
+	void start();
+
+	/**
+	 * start scan if the result is older than maxAge [ms]
+	 */
+	void refresh(uint32_t maxAge);
+
+	/**
+	 * @param retryAllowed a failed scan is only retried if true, otherwise the retry waits
+	 */
+	void loop(bool retryAllowed = true);
+
+	bool isRunning() const { return running; }
+
+	/**
+	 * number of completed scans, changes with every new result
+	 */
+	uint32_t getGeneration() const { return generation; }
+
+	/**
+	 * age of the result [ms], UINT32_MAX if there is none
+	 */
+	uint32_t getAge() const { return generation ? millis() - timestamp : UINT32_MAX; }
+
+	/**
+	 * access points of the last scan, strongest first
+	 */
+	const std::vector<Network> &getNetworks() const { return networks; }
+
+  private:
+	void collect(int16_t count);
+	void failed();
+
+	std::vector<Network> networks;
+	bool running;
+	bool retry;
+	unsigned long failTime;
+	uint32_t generation;
+	unsigned long timestamp;
+};
+
+#endif // _WIFISCANNER_h
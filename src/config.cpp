@@ -1,13 +1,14 @@
 // file system
 // http://www.instructables.com/id/Using-ESP8266-SPIFFS/
 #include <Arduino.h>
-#ifdef ESP32
+#if defined(ESP32) || defined(NATIVE)
 	#include <SPIFFS.h>	
 #endif
 #ifdef ESP8266
 	#include <FS.h> 	
 	#define FILE_READ "r"
 	#define FILE_WRITE "w"
+	#define FILE_APPEND "a"
 #endif
 
 #include "config.h"
@@ -33,6 +34,16 @@ bool loadConfig(DynamicJsonDocument &configJson, const String &filename, JsonObj
 {
 	Serial.print("loadConfig:");	Serial.println(filename);
 
+	// finish or discard an interrupted saveConfig()
+	String tmpFilename = filename + ".tmp";
+	if (SPIFFS.exists(tmpFilename))
+	{
+		if (SPIFFS.exists(filename))
+			SPIFFS.remove(tmpFilename);
+		else
+			SPIFFS.rename(tmpFilename, filename);
+	}
+
 	// handle config file
 	File configFile = SPIFFS.open(filename, FILE_READ);
 	if (!configFile)
@@ -74,24 +85,38 @@ bool loadConfig(DynamicJsonDocument &configJson, const String &filename, JsonObj
 	return true;
 }
 
+/**
+ * write to a temporary file first and replace the config afterwards
+ * a power loss leaves either the old or the new file, loadConfig() cleans up
+ */
 bool saveConfig(const DynamicJsonDocument &config, const String &filename)
 {
-	Serial.println("saveConfig:");
+	Serial.print("saveConfig:");	Serial.println(filename);
 
 	// file handling
-	File configFile = SPIFFS.open(filename, FILE_WRITE);
+	String tmpFilename = filename + ".tmp";
+	File configFile = SPIFFS.open(tmpFilename, FILE_WRITE);
 	if (!configFile)
 	{
 		Serial.println("Failed to open config file for writing");
 		return false;
 	}
 
-	// Serialize JSON to file
-	size_t size = serializeJsonPretty(config, configFile);
+	// Serialize JSON to file, a short write (file system full) keeps the old file
+	size_t size = serializeJson(config, configFile);
 	configFile.close();
-	if (size == 0)
+	if (size == 0 || size != measureJson(config))
 	{
 		Serial.println(F("Failed to write to file"));
+		SPIFFS.remove(tmpFilename);
+		return false;
+	}
+
+	// SPIFFS does not rename onto existing files
+	SPIFFS.remove(filename);
+	if (!SPIFFS.rename(tmpFilename, filename))
+	{
+		Serial.println(F("Failed to replace config file"));
 		return false;
 	}
 
@@ -7,73 +7,402 @@
 #include "CaptivePortal.h"
 CaptivePortal captivePortal;
 
-// SparkMaker
-#include "SparkMaker.h"
-SparkMaker spark;
+// SparkMaker printers
+#include "PrinterRegistry.h"
 
-void handleStatus()
+// Server-Sent Events, per printer
+#include "EventSource.h"
+EventSource events[PrinterRegistry::MAX_PRINTERS];
+
+// WebSocket control channel
+#include "WebSocketServer.h"
+static const uint16_t WEBSOCKET_PORT = 81;
+WebSocketServer webSocket(WEBSOCKET_PORT);
+
+/**
+ * cached /status response and last status event per printer
+ */
+typedef struct
 {
-	uint32_t time = millis() / 1000;
+	String content;
+	String etag;
+	uint32_t epoch = 0;
+	uint32_t time = 0;
+	String eventETag;
+	unsigned long eventTime = 0;
+} StatusCache;
+static StatusCache statusCache[PrinterRegistry::MAX_PRINTERS];
+
+// layer timing and remaining time estimate
+static PrintHistory printHistory;
+
+// system metrics, read at scrape time
+static int32_t readFreeHeap() { return ESP.getFreeHeap(); }
+#ifdef ESP8266
+static int32_t readMaxBlock() { return ESP.getMaxFreeBlockSize(); }
+#else
+static int32_t readMaxBlock() { return ESP.getMaxAllocHeap(); }
+#endif
+static int32_t readUptime() { return millis() / 1000; }
+static Gauge heapFree("sparkmaker_heap_free_bytes", "free heap", readFreeHeap);
+static Gauge heapMaxBlock("sparkmaker_heap_max_block_bytes", "largest free heap block", readMaxBlock);
+static Gauge uptime("sparkmaker_uptime_seconds", "time since boot", readUptime);
+
+/**
+ * fill tempJson with printer status
+ * @return printer state epoch
+ */
+uint32_t statusJson(uint8_t id, uint32_t time)
+{
+	static PrinterSnapshot printer;
+	SparkMaker &spark = PrinterRegistry::get(id);
+	spark.getSnapshot(printer);
+
 	tempJson.clear();
-	tempJson["status"] = statusNames[spark.printer.status];
+	tempJson["status"] = statusNames[printer.status];
 	tempJson["uptime"] = time;
-	tempJson["currentLayer"] = spark.printer.currentLayer;
-	tempJson["totalLayers"] = spark.printer.totalLayers;
-	tempJson["currentFile"] = spark.printer.currentFile;
+	tempJson["currentLayer"] = printer.currentLayer;
+	tempJson["totalLayers"] = printer.totalLayers;
+	tempJson["currentFile"] = (const char *)printer.currentFile;
 	uint32_t printTime = 0;
-	if ( !spark.printer.finishTime )
+	if ( !printer.finishTime )
 	{
-		printTime = time - spark.printer.startTime;
+		if ( time > printer.startTime )
+			printTime = time - printer.startTime;
 	}
 	else
 	{
-		printTime = spark.printer.finishTime - spark.printer.startTime;
+		printTime = printer.finishTime - printer.startTime;
 	}
 	
+	spark.getHistory(printHistory);
+	float confidence = printHistory.confidence();
 	uint32_t estimatedTotalTime = 0;
-	if ( spark.printer.currentLayer > 3 ) 
-		estimatedTotalTime = (printTime * spark.printer.totalLayers) / spark.printer.currentLayer;
+	if ( printer.finishTime )
+		estimatedTotalTime = printTime;
+	else if ( confidence > 0 )
+		estimatedTotalTime = printTime + printHistory.remaining(millis()) / 1000;
 	tempJson["printTime"] = printTime;
 	tempJson["estimatedTotalTime"] = estimatedTotalTime;
+	tempJson["estimateConfidence"] = (int)(confidence * 100 + 0.5) / 100.0;
 	auto files = tempJson.createNestedArray("fileList");
-	for (auto const &file: spark.printer.filenames)
+	std::shared_ptr<const PrinterFileList> fileList = spark.getFiles();
+	for (auto const &file : *fileList)
 	{
-		files.add(file.first);
+		files.add((char *)file.c_str()); // copied
 	}
+	return printer.epoch;
+}
+
+/**
+ * serialize status into cache
+ */
+void updateStatus(uint8_t id, uint32_t time)
+{
+	StatusCache &status = statusCache[id];
+	status.epoch = statusJson(id, time);
+	status.content = "";
+	serializeJson(tempJson, status.content);
+	status.time = time;
+	// the time values are not part of the ETag: clients extrapolate them from uptime, a 304 only means the state is unchanged,
+	// so the ETag is weak; the epoch restarts at boot, the boot counter keeps tags of earlier boots from matching
+	status.etag = "W/\"" + String(PrinterRegistry::getJobLog().getBoot(), HEX) + "-" + String(id) + "-" + String(status.epoch, HEX) + "\"";
+}
+
+/**
+ * rebuild status cache only if printer state changed or time values moved on, at most once per second
+ */
+StatusCache &refreshStatus(uint8_t id)
+{
+	StatusCache &status = statusCache[id];
+	uint32_t time = millis() / 1000;
+	if ( status.content.isEmpty() || PrinterRegistry::get(id).getEpoch() != status.epoch || time != status.time )
+		updateStatus(id, time);
+	return status;
+}
+
+void handleStatus(uint8_t id)
+{
+	StatusCache &status = refreshStatus(id);
 
 	// send json data
+	if ( captivePortal.notModified(status.etag) )
+		return;
+	if ( captivePortal.getHttpServer().hasArg("pretty") )
+	{
+		// readable version is not cached
+		statusJson(id, status.time);
+		captivePortal.sendJson(200, tempJson);
+		return;
+	}
+	captivePortal.sendFinal(200, "application/json", status.content, status.etag);
+}
+
+/**
+ * subscribe to status events
+ */
+void handleEvents(uint8_t id)
+{
+	StatusCache &status = refreshStatus(id);
+	events[id].subscribe("status", status.content, status.etag);
+}
+
+/**
+ * printer whose status a WebSocket client receives, set by its "status" command
+ */
+static uint8_t webSocketPrinter[WebSocketServer::MAX_CLIENTS];
+
+/**
+ * status message for WebSocket clients
+ */
+String webSocketStatus(uint8_t id)
+{
+	const StatusCache &status = statusCache[id];
+	String etag = status.etag;
+	etag.replace("\"", "\\\"");
+	return "{\"event\":\"status\",\"printer\":" + String(id) + ",\"etag\":\"" + etag + "\",\"data\":" + status.content + "}";
+}
+
+/**
+ * WebSocket command: {"id":1,"cmd":"move","pos":10,"t":123.4}, "printer" selects the printer (default 0)
+ * answered with {"ack":1,"cmd":"move","t":123.4,"rtt":12}, t is echoed for round-trip measurement by the client
+ * and rtt is the round-trip time measured by the server [ms]
+ * "status" sends the current status and subscribes the client to the status of this printer, printer 0 until then
+ */
+void handleWebSocketCommand(uint8_t client, const char *message, size_t length)
+{
+	DynamicJsonDocument request(256);
+	DynamicJsonDocument reply(256);
+	if ( deserializeJson(request, message, length) )
+	{
+		webSocket.sendText(client, "{\"error\":\"invalid message\"}");
+		return;
+	}
+
+	String cmd = request["cmd"] | "";
+	uint8_t id = request["printer"] | 0;
+	reply["ack"] = request["id"];
+	reply["cmd"] = cmd;
+	reply["t"] = request["t"];
+	reply["rtt"] = webSocket.getRoundTripTime(client) / 1000.0;
+
+	SparkMaker *spark = id < PrinterRegistry::count() ? &PrinterRegistry::get(id) : NULL;
+	if ( !spark )
+		reply["error"] = "unknown printer";
+	else if ( cmd == "move" )
+	{
+		int16_t pos = request["pos"] | 0;
+		if ( pos )
+			spark->move(pos);
+	}
+	else if ( cmd == "home" )
+		spark->home();
+	else if ( cmd == "pause" )
+		spark->pausePrint();
+	else if ( cmd == "resume" )
+		spark->resumePrint();
+	else if ( cmd == "stop" )
+		spark->stopPrint(webSocket.getRequestTime());
+	else if ( cmd == "emergency" )
+		spark->emergencyStop(webSocket.getRequestTime());
+	else if ( cmd == "requestStatus" )
+		spark->requestStatus();
+	else if ( cmd == "ping" || cmd == "status" )
+		; // nothing to do, ack only
+	else
+		reply["error"] = "unknown command";
+
 	String content;
-	serializeJsonPretty(tempJson, content);
-	captivePortal.sendFinal(200, "application/json", content);
+	serializeJson(reply, content);
+	webSocket.sendText(client, content);
+
+	if ( cmd == "status" && spark )
+	{
+		if ( client < WebSocketServer::MAX_CLIENTS )
+			webSocketPrinter[client] = id;
+		refreshStatus(id);
+		webSocket.sendText(client, webSocketStatus(id));
+	}
 }
 
-void handleCmdDisconnect()
+/**
+ * new WebSocket client, follows printer 0 until it asks for another
+ */
+void handleWebSocketOpen(uint8_t client)
 {
-	spark.disconnect();
-	handleStatus();
+	if ( client < WebSocketServer::MAX_CLIENTS )
+		webSocketPrinter[client] = 0;
 }
 
-void handleCmdConnect()
+/**
+ * push status changes to event and WebSocket subscribers
+ */
+void pushStatusEvents()
 {
-	spark.connect();
-	handleStatus();
+	unsigned long time = millis();
+	for (uint8_t id = 0; id < PrinterRegistry::count(); id++)
+	{
+		if ( !events[id].count() && !webSocket.count() )
+			continue;
+
+		StatusCache &status = statusCache[id];
+		if ( time - status.eventTime < settings.SparkMaker.statusEventInterval )
+			continue;
+
+		refreshStatus(id);
+		if ( status.etag != status.eventETag )
+		{
+			events[id].send("status", status.content, status.etag);
+			if ( webSocket.count() )
+			{
+				String message = webSocketStatus(id);
+				for (uint8_t client = 0; client < WebSocketServer::MAX_CLIENTS; client++)
+				{
+					if ( webSocketPrinter[client] == id )
+						webSocket.sendText(client, message); // skipped if not connected
+				}
+			}
+			status.eventETag = status.etag;
+			status.eventTime = time;
+		}
+	}
+}
+
+void handleCmdDisconnect(uint8_t id)
+{
+	PrinterRegistry::get(id).disconnect();
+	handleStatus(id);
 }
 
-void handleCmdPrint()
+void handleCmdConnect(uint8_t id)
+{
+	PrinterRegistry::get(id).connect();
+	handleStatus(id);
+}
+
+void handleCmdPrint(uint8_t id)
 {
 	String file = captivePortal.getHttpServer().arg("file");
-	spark.print(file);
+	PrinterRegistry::get(id).print(file);
 	captivePortal.sendFinal(200, "text/plain", "OK");
 }
 
-void handleCmdMove()
+/**
+ * printer command queue metrics
+ */
+void handleCommands(uint8_t id)
+{
+	PrinterRegistry::get(id).getCommandStats(tempJson.to<JsonObject>());
+	captivePortal.sendJson(200, tempJson);
+}
+
+/**
+ * layer timing of the current print
+ */
+void handleHistory(uint8_t id)
+{
+	PrinterRegistry::get(id).getHistory(printHistory);
+	DynamicJsonDocument json(PrintHistory::JSON_SIZE);
+	printHistory.toJson(json, millis());
+	captivePortal.sendJson(200, json);
+}
+
+/**
+ * finished and stopped prints, newest first
+ * @param offset jobs to skip
+ * @param limit page size
+ */
+void handleJobs()
+{
+	HttpServerBackend &server = captivePortal.getHttpServer();
+	uint16_t offset = server.arg("offset").toInt();
+	long limit = server.hasArg("limit") ? server.arg("limit").toInt() : JobLog::PAGE_SIZE;
+	if ( limit < 1 || limit > JobLog::MAX_PAGE )
+		limit = JobLog::MAX_PAGE;
+	DynamicJsonDocument json(JobLog::JSON_SIZE);
+	PrinterRegistry::getJobLog().toJson(json, offset, limit);
+	captivePortal.sendJson(200, json);
+}
+
+/**
+ * print statistics per file
+ */
+void handleJobFiles()
+{
+	DynamicJsonDocument json(JobLog::JSON_SIZE);
+	PrinterRegistry::getJobLog().filesToJson(json);
+	captivePortal.sendJson(200, json);
+}
+
+/**
+ * counters and histograms in Prometheus text format
+ */
+void handleMetrics()
+{
+	captivePortal.sendChunked(200, "text/plain; version=0.0.4", Metric::writeAll);
+}
+
+/**
+ * main loop timing per phase, "reset" clears the worst case records
+ */
+void handleLoop()
+{
+	DynamicJsonDocument json(LoopProfiler::JSON_SIZE);
+	json["budget"] = settings.Loop.budget;
+	LoopProfiler::toJson(json);
+	if ( captivePortal.getHttpServer().hasArg("reset") )
+		LoopProfiler::reset();
+	captivePortal.sendJson(200, json);
+}
+
+/**
+ * boot timeline
+ */
+void handleBoot()
+{
+	tempJson.clear();
+	BootProfiler::toJson(tempJson);
+	captivePortal.sendJson(200, tempJson);
+}
+
+/**
+ * printers with id, address and state
+ */
+void handlePrinters()
+{
+	tempJson.clear();
+	PrinterRegistry::toJson(tempJson.createNestedArray("printers"));
+	captivePortal.sendJson(200, tempJson);
+}
+
+void handleCmdMove(uint8_t id)
 {
 	int16_t pos = captivePortal.getHttpServer().arg("pos").toInt();
 	if ( pos )
-		spark.move(pos);
+		PrinterRegistry::get(id).move(pos);
 	captivePortal.sendFinal(200, "text/plain", "OK");
 }
 
+/**
+ * register printer route as /printers/<id><uri>, printer 0 is also served at <uri>
+ * printers beyond the registry (maxPrinters changed since boot) are answered with 404
+ * all of them are measured as route /printers/{id}<uri>
+ */
+void onPrinter(const String &uri, void (*handler)(uint8_t id))
+{
+	String route = "/printers/{id}" + uri;
+	captivePortal.on(uri, route, [handler]() { handler(0); });
+	for (uint8_t id = 0; id < settings.SparkMaker.maxPrinters; id++)
+	{
+		captivePortal.on("/printers/" + String(id) + uri, route, [handler, id]() {
+			if ( id < PrinterRegistry::count() )
+				handler(id);
+			else
+				captivePortal.sendFinal(404, "text/plain", "unknown printer");
+		});
+	}
+}
+
 
 void setup()
 {
@@ -84,32 +413,61 @@ void setup()
 	}
 	Serial.println("\nSparkMaker BLE to WiFi interface");
 
-	spark.setup();
-
+	// file system, config, WiFi AP and client connection (continued in loop)
 	captivePortal.setup();
 
 	// custom pages
-	captivePortal.on("/status", handleStatus);
-	captivePortal.on("/print", handleCmdPrint);
-
-	captivePortal.on("/stop", [](){ spark.stopPrint(); captivePortal.sendFinal(200, "text/plain", "OK"); });
-	captivePortal.on("/pause", [](){ spark.pausePrint(); captivePortal.sendFinal(200, "text/plain", "OK"); });
-	captivePortal.on("/resume", [](){ spark.resumePrint(); captivePortal.sendFinal(200, "text/plain", "OK"); });
-	captivePortal.on("/emergencyStop", [](){ spark.emergencyStop(); captivePortal.sendFinal(200, "text/plain", "OK"); });
-	captivePortal.on("/requestStatus", [](){ spark.requestStatus(); captivePortal.sendFinal(200, "text/plain", "OK"); });
-	captivePortal.on("/home", [](){ spark.home(); captivePortal.sendFinal(200, "text/plain", "OK"); });
-	captivePortal.on("/move", handleCmdMove);
-	captivePortal.on("/connect", handleCmdConnect);
-	captivePortal.on("/disconnect", handleCmdDisconnect);
+	BootProfiler::phase("pages");
+	onPrinter("/status", handleStatus);
+	onPrinter("/events", handleEvents);
+	onPrinter("/print", handleCmdPrint);
+
+	onPrinter("/stop", [](uint8_t id){ PrinterRegistry::get(id).stopPrint(captivePortal.getRequestTime()); captivePortal.sendFinal(200, "text/plain", "OK"); });
+	onPrinter("/pause", [](uint8_t id){ PrinterRegistry::get(id).pausePrint(); captivePortal.sendFinal(200, "text/plain", "OK"); });
+	onPrinter("/resume", [](uint8_t id){ PrinterRegistry::get(id).resumePrint(); captivePortal.sendFinal(200, "text/plain", "OK"); });
+	onPrinter("/emergencyStop", [](uint8_t id){ PrinterRegistry::get(id).emergencyStop(captivePortal.getRequestTime()); captivePortal.sendFinal(200, "text/plain", "OK"); });
+	onPrinter("/requestStatus", [](uint8_t id){ PrinterRegistry::get(id).requestStatus(); captivePortal.sendFinal(200, "text/plain", "OK"); });
+	onPrinter("/home", [](uint8_t id){ PrinterRegistry::get(id).home(); captivePortal.sendFinal(200, "text/plain", "OK"); });
+	onPrinter("/move", handleCmdMove);
+	onPrinter("/connect", handleCmdConnect);
+	onPrinter("/disconnect", handleCmdDisconnect);
+	onPrinter("/commands", handleCommands);
+	onPrinter("/history", handleHistory);
+	captivePortal.on("/printers", handlePrinters);
+	captivePortal.on("/boot", handleBoot);
+	captivePortal.on("/jobs", handleJobs);
+	captivePortal.on("/jobs/files", handleJobFiles);
+	captivePortal.on("/metrics", handleMetrics);
+	captivePortal.on("/loop", handleLoop);
 
+	// answer requests while WiFi and BLE links come up
+	BootProfiler::phase("http");
 	captivePortal.begin();
 
+	BootProfiler::phase("websocket");
+	webSocket.onMessage(handleWebSocketCommand);
+	webSocket.onOpen(handleWebSocketOpen);
+	webSocket.begin();
+
+	// BLE scan runs in the background
+	BootProfiler::phase("ble");
+	PrinterRegistry::setup();
+
+	BootProfiler::done();
 	Serial.println("Sparkmaker WiFi started!");
-	spark.setup();
 }
 
 void loop()
 {
+	LoopProfiler::begin();
 	captivePortal.loop();
-	spark.loop();
+	PrinterRegistry::loop();
+	LoopProfiler::phase("events");
+	for (uint8_t id = 0; id < PrinterRegistry::count(); id++)
+		events[id].loop();
+	LoopProfiler::phase("websocket");
+	webSocket.loop();
+	LoopProfiler::phase("status events");
+	pushStatusEvents();
+	LoopProfiler::end(settings.Loop.budget);
 }
@@ -0,0 +1,207 @@
+/*
+	Asynchronous HTTP server: responses larger than the socket send buffer
+
+	pio test -e native_async_embedded
+	the firmware runs on a copy of the data folder, the NativeHAL limits the socket send buffer to the one of the ESP32
+*/
+#include <Arduino.h>
+#include <WiFiServer.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "Metrics.h"
+#include "WebAssets.h"
+
+// firmware, src/main.cpp
+void setup();
+void loop();
+
+static const uint32_t FETCH_TIMEOUT = 10000; // [ms]
+static const size_t READ_SIZE = 512;		   // bytes per read of the slow client
+
+typedef struct
+{
+	int status = 0;
+	std::string headers; // lower case
+	std::string body;	 // without transfer encoding
+	bool complete = false;
+} Response;
+
+/**
+ * collects output of a writer function
+ */
+class StringPrint : public Print
+{
+  public:
+	size_t write(uint8_t c)
+	{
+		text += (char)c;
+		return 1;
+	}
+	std::string text;
+};
+
+/**
+ * decode chunked transfer encoding
+ * @return false if the terminating chunk is missing
+ */
+static bool dechunk(const std::string &data, std::string &body)
+{
+	size_t pos = 0;
+	for (;;)
+	{
+		size_t lineEnd = data.find("\r\n", pos);
+		if (lineEnd == std::string::npos)
+			return false;
+		size_t size = strtoul(data.c_str() + pos, NULL, 16);
+		pos = lineEnd + 2;
+		if (!size)
+			return data.compare(pos, 2, "\r\n") == 0;
+		if (pos + size + 2 > data.size())
+			return false;
+		body.append(data, pos, size);
+		pos += size + 2;
+	}
+}
+
+/**
+ * read response as a slow client with a small receive window, the server has to queue the rest
+ */
+static void request(const char *uri, Response &response)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int window = 2048;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &window, sizeof(window));
+	timeval timeout = {FETCH_TIMEOUT / 1000, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(WiFiServer::hostPort(80));
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return;
+	}
+	std::string text = std::string("GET ") + uri + " HTTP/1.1\r\nHost: SparkMaker.local\r\nConnection: close\r\n\r\n";
+	send(fd, text.c_str(), text.size(), 0);
+
+	std::string data;
+	char buffer[READ_SIZE];
+	ssize_t len;
+	while ((len = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+	{
+		data.append(buffer, len);
+		usleep(1000);
+	}
+	close(fd);
+
+	size_t headerEnd = data.find("\r\n\r\n");
+	if (headerEnd == std::string::npos)
+		return;
+	response.status = atoi(data.c_str() + data.find(' ') + 1);
+	response.headers = data.substr(0, headerEnd + 2);
+	for (size_t i = 0; i < response.headers.size(); i++)
+		response.headers[i] = tolower(response.headers[i]);
+	std::string content = data.substr(headerEnd + 4);
+
+	if (response.headers.find("\r\ntransfer-encoding: chunked\r\n") != std::string::npos)
+	{
+		response.complete = dechunk(content, response.body);
+		return;
+	}
+	size_t pos = response.headers.find("\r\ncontent-length:");
+	response.body = content;
+	response.complete = pos != std::string::npos && strtoul(response.headers.c_str() + pos + 17, NULL, 10) == content.size();
+}
+
+/**
+ * fetch URI while the firmware loop serves it
+ */
+static Response fetch(const char *uri)
+{
+	Response response;
+	std::atomic<bool> done(false);
+	std::thread client([&]() {
+		request(uri, response);
+		done = true;
+	});
+	unsigned long start = millis();
+	while (!done && millis() - start < FETCH_TIMEOUT)
+		loop();
+	client.join(); // the client gives up after FETCH_TIMEOUT without data
+	return response;
+}
+
+static size_t countLines(const std::string &text)
+{
+	size_t lines = 0;
+	for (size_t i = 0; i < text.size(); i++)
+		lines += text[i] == '\n';
+	return lines;
+}
+
+void setUp() {}
+void tearDown() {}
+
+/**
+ * metrics are written while the response is built, far more than the socket takes at once
+ */
+void test_metrics_complete()
+{
+	fetch("/metrics"); // the series of /metrics itself start with its first request
+	Response response = fetch("/metrics");
+	TEST_ASSERT_EQUAL(200, response.status);
+	TEST_ASSERT_TRUE_MESSAGE(response.complete, "terminating chunk missing");
+
+	// values change between the requests, the lines do not
+	StringPrint expected;
+	Metric::writeAll(expected);
+	TEST_ASSERT_EQUAL(countLines(expected.text), countLines(response.body));
+	TEST_ASSERT_EQUAL('\n', response.body.back());
+}
+
+/**
+ * largest asset compiled into the firmware, sent from flash
+ */
+void test_embedded_asset_complete()
+{
+	const AssetIndex::EmbeddedAsset *asset = &webAssets[0];
+	for (size_t i = 1; i < sizeof(webAssets) / sizeof(webAssets[0]); i++)
+		if (webAssets[i].size > asset->size)
+			asset = &webAssets[i];
+	TEST_ASSERT_GREATER_THAN(16384, asset->size);
+
+	Response response = fetch(asset->uri);
+	TEST_ASSERT_EQUAL(200, response.status);
+	TEST_ASSERT_TRUE_MESSAGE(response.complete, "content shorter than Content-Length");
+	TEST_ASSERT_EQUAL(asset->size, response.body.size());
+	TEST_ASSERT_EQUAL_MEMORY(asset->data, response.body.data(), asset->size);
+}
+
+int main()
+{
+	// the firmware writes to its file system
+	char root[] = "/tmp/sparkmaker-test-XXXXXX";
+	if (!mkdtemp(root))
+		return 1;
+	system((std::string("cp -r data/. ") + root).c_str());
+	setenv("SPARKMAKER_FS", root, 1);
+	setenv("SPARKMAKER_QUIET", "1", 1);
+	setup();
+
+	UNITY_BEGIN();
+	RUN_TEST(test_metrics_complete);
+	RUN_TEST(test_embedded_asset_complete);
+	int failures = UNITY_END();
+
+	system((std::string("rm -rf ") + root).c_str());
+	return failures;
+}
@@ -0,0 +1,254 @@
+"""
+	Web Asset Pipeline
+
+	minifies, gzips and content-hashes the files in data/public
+	output: .pio/webassets/data (file system image) and optionally .pio/webassets/include/WebAssets.h (PROGMEM)
+
+	PlatformIO: extra_scripts = pre:tools/web_assets.py
+		custom_web_assets_embed = yes	compile public files into the firmware
+	standalone: python tools/web_assets.py [--embed]
+"""
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import sys
+
+SOURCE_DIR = "data"
+PUBLIC_DIR = "public"
+OUTPUT_DIR = os.path.join(".pio", "webassets")
+
+# requested by name, never renamed
+ENTRY_POINTS = ("index.html", "portal.html", "favicon.ico")
+# development files, not needed on the device
+EXCLUDE = ("js/vue.js", "status")
+# content hash digits in file names, short enough for the SPIFFS name limit
+HASH_LENGTH = 6
+SPIFFS_NAME_LENGTH = 31
+# text formats worth compressing
+COMPRESS = (".html", ".htm", ".css", ".js", ".json", ".svg", ".xml", ".txt", ".ico")
+
+# same mapping as AssetIndex::getContentType
+MIME_TYPES = {
+	".htm": "text/html",
+	".html": "text/html",
+	".css": "text/css",
+	".js": "application/javascript",
+	".png": "image/png",
+	".gif": "image/gif",
+	".jpg": "image/jpeg",
+	".ico": "image/x-icon",
+	".xml": "text/xml",
+	".pdf": "application/x-pdf",
+	".zip": "application/x-zip",
+	".gz": "application/x-gzip",
+}
+
+REFERENCE_PATTERN = re.compile(r"""((?:src|href)\s*=\s*["']|url\(\s*["']?)([^"')#?:]+)""")
+
+
+def minify_html(text):
+	""" remove comments and indentation, line breaks are kept for inline scripts """
+	text = re.sub(r"<!--(?!\[).*?-->", "", text, flags=re.S)
+	lines = (line.strip() for line in text.splitlines())
+	return "\n".join(line for line in lines if line)
+
+
+def minify_css(text):
+	text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+	text = re.sub(r"\s+", " ", text)
+	text = re.sub(r"\s*([{};,])\s*", r"\1", text)
+	text = re.sub(r":\s+", ":", text)
+	return text.replace(";}", "}").strip()
+
+
+def minify(name, content):
+	""" JavaScript is only shipped pre-minified (*.min.js), there is no safe minifier without external tools """
+	if name.endswith((".html", ".htm")):
+		return minify_html(content.decode("utf-8")).encode("utf-8")
+	if name.endswith(".css"):
+		return minify_css(content.decode("utf-8")).encode("utf-8")
+	return content
+
+
+def hashed_name(name, content_hash):
+	""" style.css -> style.0123ab.css """
+	base, ext = os.path.splitext(name)
+	return "%s.%s%s" % (base, content_hash, ext)
+
+
+def rewrite_references(name, content, renamed):
+	""" replace references to renamed files, paths are relative to the referencing file """
+	folder = os.path.dirname(name)
+
+	def replace(match):
+		reference = match.group(2)
+		target = os.path.normpath(os.path.join(folder, reference)).replace(os.sep, "/")
+		if target not in renamed:
+			return match.group(0)
+		return match.group(1) + reference[:len(reference) - len(os.path.basename(reference))] + os.path.basename(renamed[target])
+
+	return REFERENCE_PATTERN.sub(replace, content.decode("utf-8")).encode("utf-8")
+
+
+def collect(source):
+	""" read public files, pre-compressed files are unpacked and their original kept """
+	files = {}
+	precompressed = {}
+	for root, _, names in os.walk(source):
+		for filename in names:
+			path = os.path.join(root, filename)
+			name = os.path.relpath(path, source).replace(os.sep, "/")
+			with open(path, "rb") as f:
+				content = f.read()
+			if name.endswith(".gz"):
+				name = name[:-3]
+				precompressed[name] = content
+				content = gzip.decompress(content)
+			if name in EXCLUDE:
+				continue
+			files[name] = content
+	return files, precompressed
+
+
+def process(files, precompressed={}):
+	""" minify and hash, files referencing others are processed after them """
+	def order(name):
+		if name.endswith((".html", ".htm")):
+			return 2
+		if name.endswith(".css"):
+			return 1
+		return 0
+
+	renamed = {}
+	assets = []
+	for name in sorted(files, key=lambda n: (order(n), n)):
+		content = minify(name, files[name])
+		if order(name):
+			content = rewrite_references(name, content, renamed)
+		content_hash = hashlib.sha1(content).hexdigest()[:HASH_LENGTH]
+		if os.path.basename(name) not in ENTRY_POINTS:
+			renamed[name] = hashed_name(name, content_hash)
+		output_name = renamed.get(name, name)
+
+		compressed = False
+		packed = None
+		if output_name.endswith(COMPRESS):
+			packed = gzip.compress(content, 9, mtime=0)
+		# unchanged pre-compressed files keep their original if it is smaller, e.g. packed with zopfli
+		original = precompressed.get(name)
+		if original and content == files[name] and (packed is None or len(original) < len(packed)):
+			packed = original
+		if packed and len(packed) < len(content):
+			content = packed
+			compressed = True
+		assets.append({
+			"name": output_name,
+			"source": name,
+			"content": content,
+			"compressed": compressed,
+			"etag": '"%s"' % content_hash,
+			"immutable": name in renamed,
+			"contentType": MIME_TYPES.get(os.path.splitext(output_name)[1], "text/plain"),
+		})
+	return assets
+
+
+def write_data(assets, output, embed):
+	""" file system image: everything except public files is copied, public files are skipped if embedded """
+	data = os.path.join(output, "data")
+	if os.path.exists(data):
+		shutil.rmtree(data)
+	shutil.copytree(SOURCE_DIR, data, ignore=lambda folder, names: [PUBLIC_DIR] if os.path.samefile(folder, SOURCE_DIR) else [])
+	if embed:
+		return data
+	for asset in assets:
+		name = "/%s/%s%s" % (PUBLIC_DIR, asset["name"], ".gz" if asset["compressed"] else "")
+		if len(name) > SPIFFS_NAME_LENGTH:
+			print("WARNING: %s exceeds the SPIFFS name limit of %d characters" % (name, SPIFFS_NAME_LENGTH))
+		path = os.path.join(data, name[1:])
+		os.makedirs(os.path.dirname(path), exist_ok=True)
+		with open(path, "wb") as f:
+			f.write(asset["content"])
+	return data
+
+
+def write_header(assets, output):
+	""" PROGMEM arrays and AssetIndex::EmbeddedAsset table """
+	include = os.path.join(output, "include")
+	os.makedirs(include, exist_ok=True)
+	lines = [
+		"/*",
+		"\tEmbedded Web Assets",
+		"\tgenerated by tools/web_assets.py, do not edit",
+		"*/",
+		"#ifndef _WEBASSETS_h",
+		"#define _WEBASSETS_h",
+		"",
+		"#include \"AssetIndex.h\"",
+		"",
+	]
+	for i, asset in enumerate(assets):
+		content = asset["content"]
+		lines.append("// %s" % asset["name"])
+		lines.append("static const uint8_t webAsset%d[] PROGMEM = {" % i)
+		for offset in range(0, len(content), 24):
+			lines.append("\t" + ",".join("0x%02x" % b for b in content[offset:offset + 24]) + ",")
+		lines.append("};")
+	lines.append("")
+	lines.append("static const AssetIndex::EmbeddedAsset webAssets[] = {")
+	for i, asset in enumerate(assets):
+		lines.append('\t{"/%s", "%s", "%s", %s, %s, webAsset%d, %d},' % (
+			asset["name"], asset["contentType"], asset["etag"].replace('"', '\\"'),
+			"true" if asset["compressed"] else "false", "true" if asset["immutable"] else "false",
+			i, len(asset["content"])))
+	lines.append("};")
+	lines.append("")
+	lines.append("#endif // _WEBASSETS_h")
+	lines.append("")
+
+	path = os.path.join(include, "WebAssets.h")
+	text = "\n".join(lines)
+	# keep time stamp if unchanged, avoids rebuilding the firmware
+	if os.path.exists(path):
+		with open(path) as f:
+			if f.read() == text:
+				return include
+	with open(path, "w") as f:
+		f.write(text)
+	return include
+
+
+def build(project_dir, embed):
+	cwd = os.getcwd()
+	os.chdir(project_dir)
+	try:
+		files, precompressed = collect(os.path.join(SOURCE_DIR, PUBLIC_DIR))
+		source_size = sum(len(content) for content in files.values())
+		assets = process(files, precompressed)
+		data = write_data(assets, OUTPUT_DIR, embed)
+		include = write_header(assets, OUTPUT_DIR) if embed else None
+
+		print("web assets: %d files, %d -> %d bytes%s" % (
+			len(assets), source_size, sum(len(asset["content"]) for asset in assets), " (embedded)" if embed else ""))
+		for asset in assets:
+			print("  %-32s %7d%s" % (asset["name"], len(asset["content"]), " gzip" if asset["compressed"] else ""))
+		return os.path.abspath(data), include and os.path.abspath(include)
+	finally:
+		os.chdir(cwd)
+
+
+try:
+	Import("env")  # noqa: F821, defined in PlatformIO (SCons) builds
+except NameError:
+	env = None
+
+if env is not None:
+	embed = env.GetProjectOption("custom_web_assets_embed", "no").lower() in ("yes", "true", "1")
+	data, include = build(env.subst("$PROJECT_DIR"), embed)
+	env.Replace(PROJECT_DATA_DIR=data)  # used by buildfs and uploadfs
+	if include:
+		env.Append(CPPPATH=[include], CPPDEFINES=["EMBED_WEB_ASSETS"])
+elif __name__ == "__main__":
+	build(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."), "--embed" in sys.argv)